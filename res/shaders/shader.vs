@@ -3,21 +3,34 @@
 layout(location = 0) in vec3 aPos;			// the position variable has attribute position 0
 layout(location = 1) in vec3 aColor;		// the color variable has attribute position 1
 layout (location = 2) in vec2 aTexCoord;	// the tex coord variable has attribute position 2
+layout (location = 3) in uint aObject;		// per-instance index of the object to draw
+
+uniform samplerBuffer modelMatrices;	// model to world of every object, 4 texels (columns) each
 
-uniform float greenValue;
 uniform mat4 transform;	//  for transformation
+uniform bool flipTexCoords;	// the mesh has its texture origin at the top left (glTF)
 
-uniform mat4 model;			// model to world
-uniform mat4 view;			// world to camera
-uniform mat4 projection;	// camera to screen
+// per-frame data shared by all programs, see FrameUniforms.h
+layout (std140) uniform FrameUniforms
+{
+	mat4 view;				// world to camera
+	mat4 projection;		// camera to screen
+	mat4 viewProj;			// projection * view
+	vec3 cameraPosition;
+	float time;				// seconds since startup
+};
 
 out vec2 TexCoord;	// texture coordinate
 out vec3 ourColor;	// output a color to the fragment shader
 
 void main()
 {
-   gl_Position = projection * view * model * vec4(aPos, 1.0);
+   float greenValue = (sin(time) / 2.0) + 0.5;   // changing green value over time
+   int base = int(aObject) * 4;
+   mat4 model = mat4(texelFetch(modelMatrices, base), texelFetch(modelMatrices, base + 1),
+                     texelFetch(modelMatrices, base + 2), texelFetch(modelMatrices, base + 3));
+   gl_Position = viewProj * model * vec4(aPos, 1.0);
    ourColor = vec3(aColor.x, greenValue, aColor.z);   // set ourColor to the input color we got from the vertex data
-   TexCoord = aTexCoord;
+   TexCoord = flipTexCoords ? vec2(aTexCoord.x, 1.0 - aTexCoord.y) : aTexCoord;
 };
 
@@ -1,27 +1,98 @@
 #include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <random>
 
 #include <glad/glad.h> // include glad before glfw
+#ifndef LEARNOPENGL_NO_GLFW
 #include <GLFW/glfw3.h>
-#include "stb_image/stb_image.h"
+#endif
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Shader.h"
+#include "FileWatcher.h"
 #include "Camera.h"
+#include "Profiler.h"
+#include "InstancedRenderer.h"
+#include "TransformStore.h"
+#include "FrameUniforms.h"
+#include "GLStateCache.h"
+#include "StreamBuffer.h"
+#include "TextureLoader.h"
+#include "JobSystem.h"
+#include "MeshLoader.h"
+#include "MeshOptimizer.h"
+#include "LodSelector.h"
+#include "GpuDrivenRenderer.h"
+#include "PerfHud.h"
+#include "FramePacer.h"
+#include "Logger.h"
+#include "FixedTimestep.h"
+#include "RenderThread.h"
+#include "VertexLayout.h"
+#include "BVH.h"
+#include "Benchmarks.h"
+#ifdef LEARNOPENGL_HAS_EGL
+#include "HeadlessContext.h"
+#endif
 
 // settings
 const unsigned int SCR_WIDTH = 1600;
 const unsigned int SCR_HEIGHT = 900;
+const unsigned int BENCHMARK_FRAMES = 600; // default number of frames rendered in headless mode
+const unsigned int CUBE_COUNT = 10;         // default number of cubes, --cubes N to stress test
+const float CUBE_BOUNDING_RADIUS = 0.8660254f; // half the diagonal of a unit cube, whatever its rotation
+
+double getTime()
+// seconds since startup, same as glfwGetTime() but also available without a window
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// decides which windowed frames are drawn, the callbacks tell it when something changed
+FramePacer framePacer;
+
+// the viewport follows the framebuffer size with the next frame, set by whichever thread owns the context
+int viewportWidth = SCR_WIDTH;
+int viewportHeight = SCR_HEIGHT;
+bool viewportChanged = false;
 
+#ifndef LEARNOPENGL_NO_GLFW
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 // function for when the window is resized, so the viewport is resized as well
 {
-    std::cout << "Window resized: " << width << " x " << height << std::endl;
-    // the size of the rendering window
-    glViewport(0, 0, width, height);
+    LOG_INFO("Window resized: {} x {}", width, height);
+    viewportWidth = width;
+    viewportHeight = height;
+    viewportChanged = true;
+    framePacer.invalidate();
+}
+
+void window_refresh_callback(GLFWwindow* window)
+// function for when the window content was damaged (uncovered, restored...) and needs to be drawn again
+{
+    framePacer.invalidate();
+}
+
+void window_iconify_callback(GLFWwindow* window, int iconified)
+// function for when the window is minimized or restored
+{
+    framePacer.setMinimized(iconified == GLFW_TRUE);
+}
+
+void window_focus_callback(GLFWwindow* window, int focused)
+// function for when the window gains or loses the input focus
+{
+    framePacer.setFocused(focused == GLFW_TRUE);
 }
+#endif
 
 // camera
 glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
@@ -29,34 +100,45 @@ Camera camera(cameraPos);
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
+bool pickRequested = false; // pick the cube under the crosshair on the next frame
+bool hudToggleRequested = false; // show/hide the performance HUD on the next frame
+bool movementKeys[4] = { false, false, false, false }; // held movement keys by Camera_Movement, applied by the simulation ticks
 
 float deltaTime = 0.0f;	// Time between current frame and last frame
 float lastFrame = 0.0f; // Time of last frame
 
+#ifndef LEARNOPENGL_NO_GLFW
 void processInput(GLFWwindow* window)
 // function for processing input
 {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) // key escape is pressed
     {
-        std::cout << "ESC" << std::endl;
+        LOG_INFO("ESC");
         glfwSetWindowShouldClose(window, true);
     }
 
+    for (unsigned int direction = 0; direction < 4; direction++)
+        movementKeys[direction] = false;
+
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-        camera.ProcessKeyboard(FORWARD, deltaTime); 
-        std::cout << "W - Camera speed: " << camera.getMovementSpeed() << std::endl;
+        movementKeys[FORWARD] = true;
+        framePacer.invalidate();  // keeps drawing while the key is held
+        LOG_TRACE("W - Camera speed: {}", camera.getMovementSpeed());
     }
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-        camera.ProcessKeyboard(BACKWARD, deltaTime); 
-        std::cout << "S - Camera speed: " << camera.getMovementSpeed() << std::endl;
+        movementKeys[BACKWARD] = true;
+        framePacer.invalidate();  // keeps drawing while the key is held
+        LOG_TRACE("S - Camera speed: {}", camera.getMovementSpeed());
     }
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-        camera.ProcessKeyboard(LEFT, deltaTime); 
-        std::cout << "A - Camera speed: " << camera.getMovementSpeed() << std::endl;
+        movementKeys[LEFT] = true;
+        framePacer.invalidate();  // keeps drawing while the key is held
+        LOG_TRACE("A - Camera speed: {}", camera.getMovementSpeed());
     }
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-        camera.ProcessKeyboard(RIGHT, deltaTime); 
-        std::cout << "D - Camera speed: " << camera.getMovementSpeed() << std::endl;
+        movementKeys[RIGHT] = true;
+        framePacer.invalidate();  // keeps drawing while the key is held
+        LOG_TRACE("D - Camera speed: {}", camera.getMovementSpeed());
     }
 }
 
@@ -77,6 +159,7 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
     lastY = ypos;
 
     camera.ProcessMouseMovement(xoffset, yoffset);
+    framePacer.invalidate();
     /* for debug only
     std::cout << "Camera front: (" 
         << camera.getFront().x << ", " 
@@ -90,55 +173,223 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
     camera.ProcessMouseScroll(yoffset);
-    std::cout << "Camera fov: " << camera.getZoom() << std::endl;
+    framePacer.invalidate();
+    LOG_INFO("Camera fov: {}", camera.getZoom());
 }
 
-// main -----------------------------------------------------------------------------------------------------------------------------------------------------------
+// glfw: whenever a key is pressed or released, this callback is called
+// ---------------------------------------------------------------------
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (key == GLFW_KEY_F1 && action == GLFW_PRESS)
+        hudToggleRequested = true;
+    framePacer.invalidate();    // movement keys are read by processInput() in the next frame
+}
 
-int main()
+// glfw: whenever a mouse button is pressed or released, this callback is called
+// -----------------------------------------------------------------------------
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 {
-    std::cout << "initializing... " << std::endl;
-    glfwInit();
-    // configure GLFW using glfwWindowHint()
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    //glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+    {
+        pickRequested = true;
+        framePacer.invalidate();
+    }
+}
+#endif
 
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+// one instanced draw call of the CPU culling path
+struct LevelDraw
+{
+    unsigned int indexCount;
+    unsigned int firstIndex;
+    unsigned int firstInstance;
+    unsigned int instanceCount;
+};
+
+// what the scene commands of a frame read, copied into its frame packet so the main thread can go on with the next one
+struct SceneFrame
+{
+    FrameUniformsData frameData;
+    glm::vec3 cameraPosition;           // camera as drawn, for the GPU culling's level of detail
+    float zoom;
+    unsigned int viewportHeight;        // pixels, for the level of detail's error budget
+    const unsigned int* changedObjects; // objects whose model matrix changed, NULL: all of them
+    const glm::mat4* changedMatrices;   // their new model matrices
+    unsigned int changedCount;
+    const unsigned int* instances;      // visible objects grouped by level (CPU culling)
+    unsigned int instanceCount;
+    const LevelDraw* draws;             // one per non-empty level (CPU culling)
+    unsigned int drawCount;
+};
+
+// main -----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    // command line: --headless renders offscreen without a window, --frames N sets how many frames it renders,
+    // --profile PATH writes the frame times to PATH.csv and PATH.json on exit, --cubes N sets the number of cubes,
+    // --static stops the cubes from rotating, --mesh PATH draws an OBJ/glTF mesh instead of the cube, --bench-culling N runs the frustum culling benchmark on N objects and exits,
+    // --bench-mesh N runs the index optimizations on an N x N grid with degenerate triangles and checks the result,
+    // --gpu-driven culls and draws on the GPU with multi draw indirect (OpenGL 4.3), --hud shows the performance HUD (F1 toggles it),
+    // --on-demand only redraws the window when something changed (input, resize, animation, reloads),
+    // --tick-rate HZ sets how many times per second the simulation (animation, camera movement) is updated,
+    // --render-thread submits the GL calls from a render thread, one frame behind input, simulation and culling
+#ifdef LEARNOPENGL_NO_GLFW
+    bool headless = true;
+#else
+    bool headless = false;
 #endif
-    
-    // create a window
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
+    unsigned int benchmarkFrames = BENCHMARK_FRAMES;
+    std::string profileOutput;
+    unsigned int cubeCount = CUBE_COUNT;
+    bool animateCubes = true;
+    std::string meshPath;
+    bool gpuDriven = false;
+    bool showHud = false;
+    double tickRate = SIMULATION_HZ;
+    bool threadedRendering = false;
+    for (int i = 1; i < argc; i++)
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            benchmarkFrames = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+            profileOutput = argv[++i];
+        else if (strcmp(argv[i], "--cubes") == 0 && i + 1 < argc)
+            cubeCount = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--static") == 0)
+            animateCubes = false;
+        else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc)
+            meshPath = argv[++i];
+        else if (strcmp(argv[i], "--gpu-driven") == 0)
+            gpuDriven = true;
+        else if (strcmp(argv[i], "--hud") == 0)
+            showHud = true;
+        else if (strcmp(argv[i], "--on-demand") == 0)
+            framePacer.setOnDemand(true);
+        else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc)
+            tickRate = strtod(argv[++i], NULL);
+        else if (strcmp(argv[i], "--render-thread") == 0)
+            threadedRendering = true;
+        else if (strcmp(argv[i], "--bench-culling") == 0 && i + 1 < argc)
+            return runCullingBenchmark((unsigned int)strtoul(argv[++i], NULL, 10));
+        else if (strcmp(argv[i], "--bench-bvh") == 0 && i + 1 < argc)
+            return runBVHBenchmark((unsigned int)strtoul(argv[++i], NULL, 10));
+        else if (strcmp(argv[i], "--bench-mesh") == 0 && i + 1 < argc)
+            return runMeshOptimizerBenchmark((unsigned int)strtoul(argv[++i], NULL, 10));
+        else
+            std::cout << "Unknown argument: " << argv[i] << std::endl;
     }
-    glfwMakeContextCurrent(window); // make window the current context
 
-    // GLAD manages function pointers for OpenGL so initialize GLAD before calling any OpenGL function
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    // messages from the frame loop and the callbacks are printed by a background thread, so they never stall a frame
+    Logger& logger = Logger::Get();
+    logger.init();
+
+    std::cout << "initializing... " << std::endl;
+#ifdef LEARNOPENGL_HAS_EGL
+    HeadlessContext* headlessContext = NULL;
+#endif
+#ifndef LEARNOPENGL_NO_GLFW
+    GLFWwindow* window = NULL;
+#endif
+
+    if (headless)
     {
-        std::cout << "Failed to initialize GLAD" << std::endl;
+#ifdef LEARNOPENGL_HAS_EGL
+        // create an offscreen context instead of a window
+        headlessContext = new HeadlessContext(SCR_WIDTH, SCR_HEIGHT);
+        if (!headlessContext->isValid())
+        {
+            std::cout << "Failed to create headless context" << std::endl;
+            delete headlessContext;
+            return -1;
+        }
+        if (!gladLoadGLLoader((GLADloadproc)HeadlessContext::getProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            delete headlessContext;
+            return -1;
+        }
+        if (!headlessContext->createFramebuffer())
+        {
+            delete headlessContext;
+            return -1;
+        }
+        std::cout << "Headless: " << glGetString(GL_RENDERER) << ", OpenGL " << glGetString(GL_VERSION) << std::endl;
+#else
+        std::cout << "Headless mode is not available in this build" << std::endl;
         return -1;
+#endif
     }
+#ifndef LEARNOPENGL_NO_GLFW
+    else
+    {
+        glfwInit();
+        // configure GLFW using glfwWindowHint()
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        //glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    
+        // create a window
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window); // make window the current context
 
-    // tell GLFW to call framebuffer_size_callback() function on every window resize
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
+        // GLAD manages function pointers for OpenGL so initialize GLAD before calling any OpenGL function
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
 
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        // tell GLFW to call framebuffer_size_callback() function on every window resize
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetMouseButtonCallback(window, mouse_button_callback);
+        glfwSetKeyCallback(window, key_callback);
+        glfwSetWindowRefreshCallback(window, window_refresh_callback);
+        glfwSetWindowIconifyCallback(window, window_iconify_callback);
+        glfwSetWindowFocusCallback(window, window_focus_callback);
+        // the framebuffer may be larger than the window (HiDPI), the callback only reports later changes
+        glfwGetFramebufferSize(window, &viewportWidth, &viewportHeight);
+        viewportChanged = true;
+
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
+#endif
 
     glEnable(GL_DEPTH_TEST);
 
+    Profiler& profiler = Profiler::Get();
+    profiler.init();
+
+    // per-frame data (instance indices, frame uniforms) is suballocated from one ring buffer, fenced per frame
+    StreamBuffer& streamBuffer = StreamBuffer::Get();
+    streamBuffer.init();
+
     //Create shader program -------------------------------------------------------------------------------------------
     Shader ourShader("res/shaders/shader.vs", "res/shaders/shader.fs");
 
+    // hot-reload: edits to the shader files are picked up while running
+    FileWatcher shaderWatcher;
+    shaderWatcher.watch("res/shaders/shader.vs");
+    shaderWatcher.watch("res/shaders/shader.fs");
+    std::vector<std::string> changedFiles;
+
     // Create object to draw ------------------------------------------------------------------------------------------
     
     // set of vertices
@@ -174,74 +425,65 @@ int main()
 
     // 1. bind Vertex Array Object
     glBindVertexArray(VAO);
-    // 2. copy our vertices array in a vertex buffer for OpenGL to use
+    // reorder the triangles for the vertex cache and overdraw, then the vertices in the order they are first used (see MeshOptimizer.h)
+    const unsigned int cubeVertexCount = sizeof(vertices) / (8 * sizeof(float));
+    const std::size_t cubeIndexCount = sizeof(indices) / sizeof(indices[0]);
+    VertexCacheStats cubeCacheBefore = analyzeVertexCache(indices, cubeIndexCount, cubeVertexCount);
+    optimizeVertexCache(indices, cubeIndexCount, cubeVertexCount);
+    optimizeOverdraw(indices, cubeIndexCount, vertices, 8 * sizeof(float), cubeVertexCount);
+    std::vector<unsigned int> cubeRemap;
+    optimizeVertexFetch(indices, cubeIndexCount, cubeVertexCount, cubeRemap);
+    float fetchOrder[sizeof(vertices) / sizeof(float)];
+    for (unsigned int i = 0; i < cubeVertexCount; i++)
+        memcpy(&fetchOrder[8 * cubeRemap[i]], &vertices[8 * i], 8 * sizeof(float));
+    memcpy(vertices, fetchOrder, sizeof(vertices));
+    VertexCacheStats cubeCacheAfter = analyzeVertexCache(indices, cubeIndexCount, cubeVertexCount);
+    std::cout << "cube: ACMR " << cubeCacheBefore.acmr << " -> " << cubeCacheAfter.acmr << ", ATVR " << cubeCacheBefore.atvr << " -> " << cubeCacheAfter.atvr << std::endl;
+
+    // 2. copy our vertices array in a vertex buffer for OpenGL to use, packed into 16 bytes per vertex instead of 32:
+    // half positions, 8-bit colors and half tex coords
+    VertexLayout cubeLayout;
+    cubeLayout.add(MESH_ATTRIB_POSITION, VERTEX_HALF4).add(MESH_ATTRIB_COLOR, VERTEX_UNORM8X4).add(MESH_ATTRIB_TEXCOORD, VERTEX_HALF2);
+    std::vector<unsigned char> packedVertices(cubeVertexCount * cubeLayout.getStride());
+    for (unsigned int i = 0; i < cubeVertexCount; i++)
+    {
+        unsigned char* vertex = &packedVertices[i * cubeLayout.getStride()];
+        cubeLayout.write(vertex, 0, &vertices[8 * i], 3);
+        cubeLayout.write(vertex, 1, &vertices[8 * i + 3], 3);
+        cubeLayout.write(vertex, 2, &vertices[8 * i + 6], 2);
+    }
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    // 3. copy our index array in a element buffer for OpenGL to use
+    glBufferData(GL_ARRAY_BUFFER, packedVertices.size(), packedVertices.data(), GL_STATIC_DRAW);
+    // 3. copy our index array in a element buffer for OpenGL to use, 16-bit since the cube has few vertices
+    const GLenum cubeIndexType = chooseIndexType(cubeVertexCount);
+    std::vector<unsigned char> packedIndices(cubeIndexCount * getIndexSize(cubeIndexType));
+    writeIndices(indices, cubeIndexCount, cubeIndexType, packedIndices.data());
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-    // 4. then set the vertex attributes pointers:
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    // tex-coord attribute
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, packedIndices.size(), packedIndices.data(), GL_STATIC_DRAW);
+    // 4. then set the vertex attributes pointers: position, color and tex-coord attribute
+    cubeLayout.apply();
 
     // Texture --------------------------------------------------------------------------------------------------------
-    unsigned int texture1, texture2; // ID for texture
-    // texture 1
-    glGenTextures(1, &texture1);
-    glBindTexture(GL_TEXTURE_2D, texture1);
-    // set the texture wrapping/filtering options (on the currently bound texture object)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // load image for texture 1
-    int texWidth, texHeight, texChannels;
-    stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
-    unsigned char* texData = stbi_load("res/textures/noHair.png", &texWidth, &texHeight, &texChannels, 0);
-    if (texData) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, texWidth, texHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, texData); // generate texture
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    // free texture after used
-    stbi_image_free(texData);
-
-    // texture 2
-    glGenTextures(1, &texture2);
-    glBindTexture(GL_TEXTURE_2D, texture2);
-    // set the texture wrapping/filtering options (on the currently bound texture object)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // load image for texture 2
-    // stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
-    texData = stbi_load("res/textures/pop_cat.png", &texWidth, &texHeight, &texChannels, 0);
-    if (texData) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, texWidth, texHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, texData); // generate texture
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    // free texture after used
-    stbi_image_free(texData);
+    // culling, transform updates and texture decoding run as jobs on the worker threads
+    JobSystem jobSystem;
+    std::cout << "job system: " << jobSystem.getWorkerCount() << " workers" << std::endl;
+
+    // decoded by background jobs and streamed in over the first frames, a placeholder is shown until they are ready
+    TextureLoader textureLoader(jobSystem);
+    const StreamedTexture* texture1 = textureLoader.load("res/textures/noHair.png", true); // flip loaded texture's on the y-axis
+    const StreamedTexture* texture2 = textureLoader.load("res/textures/pop_cat.png", true);
 
     // -------------------------------------------------------------------------------------------
     ourShader.use(); // don't forget to activate/use the shader before setting uniforms!
 
-    ourShader.setInt("texture1", 0);
-    ourShader.setInt("texture2", 1);
+    // uniform handles are resolved once, setting them afterwards needs no string lookups
+    UniformHandle<int> texture1Uniform = ourShader.uniform<int>("texture1");
+    UniformHandle<int> texture2Uniform = ourShader.uniform<int>("texture2");
+    UniformHandle<int> modelMatricesUniform = ourShader.uniform<int>("modelMatrices");
+    UniformHandle<int> flipTexCoordsUniform = ourShader.uniform<int>("flipTexCoords");
+    texture1Uniform.set(0);
+    texture2Uniform.set(1);
+    modelMatricesUniform.set(INSTANCE_TRANSFORM_UNIT);
 
     // This is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object
     // so afterwards we can safely unbind
@@ -254,11 +496,29 @@ int main()
     // VAOs requires a call to glBindVertexArray anyways so we generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
     glBindVertexArray(0);
 
+    // a mesh loaded from a file replaces the cube, its bounds give the culling radius
+    Mesh mesh;
+    MeshLoader meshLoader(jobSystem);
+    unsigned int drawVAO = VAO;
+    MeshLod cubeLod = { 0, (unsigned int)cubeIndexCount, 0.0f };
+    std::vector<MeshLod> drawLods(1, cubeLod);   // the cube has nothing to simplify
+    GLenum drawIndexType = cubeIndexType;
+    float boundingRadius = CUBE_BOUNDING_RADIUS;
+    if (!meshPath.empty() && meshLoader.load(meshPath, mesh))
+    {
+        drawVAO = mesh.getVAO();
+        drawLods = mesh.getLods();
+        drawIndexType = mesh.getIndexType();
+        boundingRadius = mesh.getBoundingRadius();
+    }
+    ourShader.use();
+    flipTexCoordsUniform.set(mesh.hasTopLeftTexCoords());
+
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); // wireframe mode
 
     // ----------------------------------------------------------------------------------------------------------------------
 
-    glm::vec3 cubePositions[] = {
+    std::vector<glm::vec3> cubePositions = {
         // different positions to render object at
         glm::vec3(0.0f,  0.0f,  0.0f),
         glm::vec3(2.0f,  5.0f, -15.0f),
@@ -271,62 +531,445 @@ int main()
         glm::vec3(1.5f,  0.2f, -1.5f),
         glm::vec3(-1.3f,  1.0f, -1.5f)
     };
+    // more cubes for stress testing: scattered in a box in front of the camera, growing with the cube count
+    std::mt19937 rng(1234);
+    float extent = 2.0f * std::cbrt((float)cubeCount);
+    std::uniform_real_distribution<float> scatter(-extent, extent);
+    cubePositions.resize(std::min<size_t>(cubePositions.size(), cubeCount));
+    while (cubePositions.size() < cubeCount)
+        cubePositions.push_back(glm::vec3(scatter(rng), scatter(rng), scatter(rng) - extent));
+
+    // spatial index for frustum culling and picking. The cubes only rotate in place, so the box around
+    // their bounding sphere never changes and the tree never needs a refit
+    std::vector<glm::vec3> cubeMins(cubeCount), cubeMaxs(cubeCount);
+    for (unsigned int i = 0; i < cubeCount; i++)
+    {
+        cubeMins[i] = cubePositions[i] - glm::vec3(boundingRadius);
+        cubeMaxs[i] = cubePositions[i] + glm::vec3(boundingRadius);
+    }
+    BVH cubeIndex;
+    cubeIndex.build(cubeMins.data(), cubeMaxs.data(), cubeCount);
+    std::vector<unsigned int> visibleCubes;
+    int visibleCounter = profiler.registerCounter("cubes_visible");
+
+    // transforms of every cube, only the ones that change get their model matrix rebuilt and uploaded
+    const glm::vec3 cubeAxis = glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f));
+    TransformStore cubeTransforms;
+    cubeTransforms.reserve(cubeCount);
+    for (unsigned int i = 0; i < cubeCount; i++)
+        cubeTransforms.add(cubePositions[i]);
+    int transformsCounter = profiler.registerCounter("transforms_updated");
+
+    // all visible cubes are drawn with one instanced draw call per level of detail, the per-instance buffer only holds their indices
+    InstancedRenderer cubeRenderer(drawVAO, 3);
+    LodSelector lodSelector;
+    int trianglesCounter = profiler.registerCounter("triangles_drawn");
+    int drawCallsCounter = profiler.registerCounter("draw_calls");
+
+    // the animation and the camera movement advance in fixed ticks, frames show them blended between the last two ticks
+    FixedTimestep simulation(tickRate);
+    glm::vec3 previousCameraPosition = camera.getPosition();    // at the tick before the current one
+    Camera renderCamera = camera;
+    int ticksCounter = profiler.registerCounter("simulation_ticks");
+
+    // or culled, sorted by level of detail and drawn by the GPU, one glMultiDrawElementsIndirect for everything
+    GpuDrivenRenderer* gpuRenderer = NULL;
+    if (gpuDriven && !GpuDrivenRenderer::isSupported())
+        std::cout << "Warning! --gpu-driven needs OpenGL 4.3, culling on the CPU" << std::endl;
+    else if (gpuDriven)
+    {
+        gpuRenderer = new GpuDrivenRenderer(drawVAO, 3);
+        if (gpuRenderer->isValid())
+        {
+            gpuRenderer->setObjects(cubePositions.data(), cubeCount, boundingRadius);
+            gpuRenderer->setMesh(drawLods, drawIndexType);
+        }
+        else
+        {
+            std::cout << "Warning! the culling shader failed to build, culling on the CPU" << std::endl;
+            delete gpuRenderer;
+            gpuRenderer = NULL;
+        }
+    }
 
-    glm::mat4 model = glm::mat4(1.0f);  // model to world, make sure to initialize matrix to identity matrix first
     glm::mat4 view;                     // world to camera
     glm::mat4 projection;               // camera to screen
 
-    // render loop, until GLFW is told to stop ------------------------------------------------------------------------------
-    while (!glfwWindowShouldClose(window))
+    // view/projection are shared by all programs through a uniform buffer, updated once per frame
+    FrameUniforms frameUniforms;
+    FrameUniformsData frameData;
+
+    // setup above binds directly, from here on bindings go through the state cache which skips redundant ones
+    GLStateCache& stateCache = GLStateCache::Get();
+    stateCache.invalidate();
+
+    // frame times, zones, counters and memory drawn over the scene with Dear ImGui
+#ifndef LEARNOPENGL_NO_GLFW
+    // the GLFW backend queries the window, which only the main thread may do, so a render thread gets a fixed size HUD
+    PerfHud* perfHud = new PerfHud(headless || threadedRendering ? NULL : window, SCR_WIDTH, SCR_HEIGHT);
+#else
+    PerfHud* perfHud = new PerfHud(NULL, SCR_WIDTH, SCR_HEIGHT);
+#endif
+    perfHud->setVisible(showHud);
+
+    // GL submission is recorded into frame packets, executed by the render thread one frame behind (--render-thread)
+    // or right after recording. The render thread owns the context from here on, setup is done
+    RenderThread renderThread;
+    if (threadedRendering)
     {
-        // per-frame time logic
-        float currentFrame = glfwGetTime();
+#ifdef LEARNOPENGL_HAS_EGL
+        if (headless)
+            renderThread.start([headlessContext](bool current) { headlessContext->makeCurrent(current); });
+#endif
+#ifndef LEARNOPENGL_NO_GLFW
+        if (!headless)
+            renderThread.start([window](bool current) { glfwMakeContextCurrent(current ? window : NULL); });
+#endif
+    }
+    std::atomic<bool> renderBusy(false);    // set by the render thread while shaders or textures are still loading
+    int renderWaitCounter = profiler.registerCounter("render_wait_ms");
+
+    // render loop, until GLFW is told to stop (or the benchmark frames are done) -------------------------------------------
+    unsigned int frameCount = 0;
+    double benchmarkStart = getTime();
+    bool running = true;
+    while (running)
+    {
+#ifndef LEARNOPENGL_NO_GLFW
+        double waitStart = getTime();
+        if (!headless)
+        {
+            // sleep until the next frame is due or an event arrives, only poll them while frames are drawn back to back
+            double timeout = framePacer.getWaitTimeout(waitStart);
+            if (timeout > 0.0)
+                glfwWaitEventsTimeout(timeout);
+            else
+                glfwPollEvents();
+            running = !glfwWindowShouldClose(window);
+            if (!running)
+                break;
+        }
+#endif
+
+        // edited shader files are noticed here, and rebuilt by the render thread
+        bool shadersChanged = shaderWatcher.poll(changedFiles);
+        if (shadersChanged)
+            framePacer.invalidate();
+
+#ifndef LEARNOPENGL_NO_GLFW
+        if (!headless)
+        {
+            // idle: skip the frame entirely, nothing on screen would change
+            framePacer.setAnimating(animateCubes || renderBusy.load(std::memory_order_relaxed));
+            double now = getTime();
+            bool draw = framePacer.shouldDraw(now);
+            framePacer.waited(now - waitStart, draw);
+            if (!draw)
+                continue;
+        }
+#endif
+
+        // the CPU frame time starts here on the main thread, so it covers input, simulation and culling as well as
+        // executing the packet, even though the GL side of beginFrame() runs with the recorded commands
+        std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+
+        // waits while the render thread is still executing the packet recorded two frames ago
+        FramePacket& packet = renderThread.begin();
+        CommandBuffer& commands = packet.commands;
+        double renderWaitMs = renderThread.getWaitMs();
+        commands.record([renderWaitCounter, renderWaitMs, frameStart]
+        {
+            Profiler& profiler = Profiler::Get();
+            profiler.beginFrame(frameStart);
+            profiler.setCounter(renderWaitCounter, renderWaitMs);
+        });
+
+        // per-frame time logic, a frame after a pause must not move the camera by the whole pause
+        float currentFrame = getTime();
         deltaTime = currentFrame - lastFrame;
+        if (deltaTime > PACER_MAX_FRAME_DELTA)
+            deltaTime = PACER_MAX_FRAME_DELTA;
         lastFrame = currentFrame;
 
-        processInput(window);   // processing input
-
-        // Rendering ------------------------------------------
-        // clear the colorbuffer
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // gradually changing color over time
-        float timeValue = glfwGetTime(); // retrieve time
-        float greenValue = (sin(timeValue) / 2.0f) + 0.5f; // changing green value over time
-        
-        // Draw the Triangle    
-        glActiveTexture(GL_TEXTURE0);   // bind textures on corresponding texture units
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2);
-
-        ourShader.use();
-        ourShader.setFloat("greenValue", greenValue);
+#ifndef LEARNOPENGL_NO_GLFW
+        if (!headless)
+        {
+            PROFILE_CPU_ZONE("Input");
+            processInput(window);   // processing input
+        }
+#endif
+        if (viewportChanged)
+        {
+            viewportChanged = false;
+            int width = viewportWidth, height = viewportHeight;
+            commands.record([width, height] { glViewport(0, 0, width, height); });     // the size of the rendering window
+        }
+
+        // run the ticks due for the real time elapsed, their cost does not depend on the frame rate
+        unsigned int ticks;
+        {
+            PROFILE_CPU_ZONE("Simulation");
+            ticks = simulation.advance(deltaTime);
+            for (unsigned int tick = 0; tick < ticks; tick++)
+            {
+                previousCameraPosition = camera.getPosition();
+                for (unsigned int direction = 0; direction < 4; direction++)
+                    if (movementKeys[direction])
+                        camera.ProcessKeyboard((Camera_Movement)direction, (float)simulation.getStep());
+            }
+        }
+        // the camera is drawn between its last two positions, the view direction follows the mouse right away
+        renderCamera = camera;
+        renderCamera.setPosition(glm::mix(previousCameraPosition, camera.getPosition(), simulation.getAlpha()));
+        if (previousCameraPosition != camera.getPosition())
+            framePacer.invalidate();    // not at rest yet
+
+        // the cursor is captured, so picking shoots a ray from the center of the screen
+        if (pickRequested)
+        {
+            pickRequested = false;
+            BVHHit hit = cubeIndex.raycast(renderCamera.getPosition(), renderCamera.getFront(), FAR_PLANE);
+            if (hit.object != -1)
+                LOG_INFO("Picked cube {} at distance {}", hit.object, hit.distance);
+            else
+                LOG_INFO("Picked nothing");
+        }
+
+        // rebuild edited shaders without stalling, the old program stays in use until the new one has linked
+        if (shadersChanged)
+        {
+            commands.record([&ourShader, changed = changedFiles]
+            {
+                for (const std::string& path : changed)
+                    if (ourShader.dependsOn(path))
+                        ourShader.reload();
+            });
+        }
+        commands.record([&]
+        {
+            if (ourShader.updateReload())
+            {
+                // a new program starts with default uniform values and may have moved its uniforms
+                ourShader.use();
+                texture1Uniform = ourShader.uniform<int>("texture1");
+                texture2Uniform = ourShader.uniform<int>("texture2");
+                modelMatricesUniform = ourShader.uniform<int>("modelMatrices");
+                flipTexCoordsUniform = ourShader.uniform<int>("flipTexCoords");
+                texture1Uniform.set(0);
+                texture2Uniform.set(1);
+                modelMatricesUniform.set(INSTANCE_TRANSFORM_UNIT);
+                flipTexCoordsUniform.set(mesh.hasTopLeftTexCoords());
+                renderBusy.store(true, std::memory_order_relaxed);     // draw it
+            }
+            else
+                renderBusy.store(ourShader.isReloading() || textureLoader.getPendingCount() > 0, std::memory_order_relaxed);
+        });
+
+        // everything the scene commands read is copied into the packet, the main thread moves on to the next frame
+        SceneFrame* scene = commands.allocate<SceneFrame>(1);
+        float timeValue = (float)simulation.getInterpolatedTime(); // retrieve time, blended between the last two ticks
+
         // note that we're translating the scene in the reverse direction of where we want to move
-        view = camera.GetViewMatrix();
-        ourShader.setMat4f("view", view);
-        projection = glm::perspective(glm::radians(camera.getZoom()), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        ourShader.setMat4f("projection", projection);
-
-        glBindVertexArray(VAO);
-        // create transformations
-        for (unsigned int i = 0; i < 10; i++)
-        {   
-            glm::mat4 model_transformed = glm::translate(model, cubePositions[i]);
-            float angle = 20.0f * i;
-            model_transformed = glm::rotate(model_transformed, (float)glfwGetTime() * glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-            ourShader.setMat4f("model", model_transformed);
-            
-            glDrawElements(GL_TRIANGLES, sizeof(indices)/ sizeof(indices[0]), GL_UNSIGNED_INT, 0);    // Draw all elements in indices
+        view = renderCamera.GetViewMatrix();
+        projection = renderCamera.GetProjectionMatrix((float)SCR_WIDTH / (float)SCR_HEIGHT);
+        frameData.view = view;
+        frameData.projection = projection;
+        frameData.viewProj = projection * view;
+        frameData.cameraPosition = renderCamera.getPosition();
+        frameData.time = timeValue; // the shader derives the changing green value from it
+        scene->frameData = frameData;
+        scene->cameraPosition = renderCamera.getPosition();
+        scene->zoom = renderCamera.getZoom();
+        scene->viewportHeight = (unsigned int)viewportHeight;
+        scene->draws = NULL;
+        scene->drawCount = 0;
+        scene->instances = NULL;
+        scene->instanceCount = 0;
+
+        // the GPU decides which cubes are visible, so all of them are animated
+        unsigned int visibleCount = cubeCount;
+        if (!gpuRenderer)
+        {
+            // only the cubes inside the view frustum are transformed and drawn
+            PROFILE_CPU_ZONE("Culling");
+            visibleCubes.clear();
+            cubeIndex.queryFrustum(Frustum::fromMatrix(frameData.viewProj), visibleCubes, jobSystem);
+            visibleCount = (unsigned int)visibleCubes.size();
+        }
 
+        // create transformations, the rotation is only visible on screen so hidden cubes are left alone
+        unsigned int transformsUpdated;
+        {
+            PROFILE_CPU_ZONE("Transforms");
+            if (animateCubes)
+            {
+                for (unsigned int v = 0; v < visibleCount; v++)
+                {
+                    unsigned int i = gpuRenderer ? v : visibleCubes[v];
+                    float angle = 20.0f * i;
+                    cubeTransforms.setRotation(i, glm::angleAxis(timeValue * glm::radians(angle), cubeAxis));
+                }
+            }
+            transformsUpdated = cubeTransforms.update(jobSystem);
+            // the matrices that changed go to the GPU with the packet
+            const std::vector<unsigned int>& changed = cubeTransforms.getChanged();
+            if (cubeTransforms.allChanged())
+            {
+                scene->changedObjects = NULL;
+                scene->changedCount = cubeTransforms.size();
+                scene->changedMatrices = commands.copy(cubeTransforms.getWorldMatrices(), scene->changedCount);
+            }
+            else
+            {
+                scene->changedCount = (unsigned int)changed.size();
+                scene->changedObjects = commands.copy(changed.data(), changed.size());
+                glm::mat4* matrices = commands.allocate<glm::mat4>(changed.size());
+                for (size_t c = 0; c < changed.size(); c++)
+                    matrices[c] = cubeTransforms.getWorld(changed[c]);
+                scene->changedMatrices = matrices;
+            }
+            cubeTransforms.clearChanged();
+
+            if (!gpuRenderer)
+            {
+                // far away cubes use a coarser level of detail, the instances are grouped by level
+                lodSelector.setView(renderCamera.getPosition(), renderCamera.getZoom(), scene->viewportHeight);
+                lodSelector.select(drawLods, visibleCubes.data(), visibleCount, cubePositions.data(), boundingRadius);
+                scene->instances = commands.copy(lodSelector.getObjects(), visibleCount);
+                scene->instanceCount = visibleCount;
+                LevelDraw* draws = commands.allocate<LevelDraw>(drawLods.size());
+                for (unsigned int level = 0; level < drawLods.size(); level++)
+                {
+                    if (lodSelector.getCount(level) == 0)
+                        continue;
+                    LevelDraw& draw = draws[scene->drawCount++];
+                    draw.indexCount = drawLods[level].indexCount;
+                    draw.firstIndex = drawLods[level].firstIndex;
+                    draw.firstInstance = lodSelector.getFirst(level);
+                    draw.instanceCount = lodSelector.getCount(level);
+                }
+                scene->draws = draws;
+            }
         }
-        
-        // glBindVertexArray(0); // no need to unbind it every time 
+        unsigned int trianglesDrawn = gpuRenderer ? 0 : lodSelector.getTriangleCount(drawLods);
+        commands.record([=]
+        {
+            Profiler& profiler = Profiler::Get();
+            profiler.setCounter(ticksCounter, ticks);
+            profiler.setCounter(transformsCounter, transformsUpdated);
+            if (!gpuRenderer)
+            {
+                profiler.setCounter(visibleCounter, visibleCount);
+                profiler.setCounter(trianglesCounter, trianglesDrawn);
+                profiler.setCounter(drawCallsCounter, scene->drawCount);
+            }
+        });
+
+        commands.record([&, scene]
+        {
+            PROFILE_GPU_ZONE("Scene");
+
+            // Rendering ------------------------------------------
+            // clear the colorbuffer
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            frameUniforms.update(scene->frameData);
+
+            // Draw the Triangle    
+            textureLoader.update(); // stream in textures that finished decoding
+            stateCache.bindTexture(0, GL_TEXTURE_2D, texture1->getID());   // bind textures on corresponding texture units
+            stateCache.bindTexture(1, GL_TEXTURE_2D, texture2->getID());
+
+            ourShader.use();
+
+            cubeRenderer.updateTransforms(scene->changedObjects, scene->changedMatrices, scene->changedCount, cubeCount);
+            if (gpuRenderer)
+            {
+                // these counts are a few frames old, they are read back without waiting for the GPU
+                Profiler& profiler = Profiler::Get();
+                lodSelector.setView(scene->cameraPosition, scene->zoom, scene->viewportHeight);
+                gpuRenderer->cull(Frustum::fromMatrix(scene->frameData.viewProj), lodSelector);
+                profiler.setCounter(visibleCounter, gpuRenderer->getVisibleObjects());
+                profiler.setCounter(trianglesCounter, gpuRenderer->getTriangleCount());
+
+                ourShader.use();    // cull() left the culling program bound
+                stateCache.bindVertexArray(drawVAO);
+                gpuRenderer->draw(cubeRenderer.getTransformTexture());
+                profiler.setCounter(drawCallsCounter, 1);
+            }
+            else
+            {
+                cubeRenderer.setInstances(scene->instances, scene->instanceCount);
+                stateCache.bindVertexArray(drawVAO);
+                for (unsigned int d = 0; d < scene->drawCount; d++)    // Draw the level's indices, once per cube using it
+                {
+                    const LevelDraw& draw = scene->draws[d];
+                    cubeRenderer.draw(draw.indexCount, drawIndexType, draw.firstIndex, draw.firstInstance, draw.instanceCount);
+                }
+            }
+            // glBindVertexArray(0); // no need to unbind it every time 
+        });
+
+        bool toggleHud = hudToggleRequested;
+        hudToggleRequested = false;
+        float frameDelta = deltaTime;
+        commands.record([perfHud, toggleHud, frameDelta]
+        {
+            if (toggleHud)
+                perfHud->toggle();
+            perfHud->render(frameDelta);
+        });
+
+        // swap the buffers ------------
+        frameCount++;
+#ifdef LEARNOPENGL_HAS_EGL
+        if (headless)
+        {
+            commands.record([headlessContext]
+            {
+                PROFILE_CPU_ZONE("Swap");
+                headlessContext->swapBuffers();
+            });
+            running = frameCount < benchmarkFrames;
+        }
+#endif
+#ifndef LEARNOPENGL_NO_GLFW
+        if (!headless)
+        {
+            commands.record([window]
+            {
+                PROFILE_CPU_ZONE("Swap");
+                glfwSwapBuffers(window);
+            });
+        }
+#endif
+
+        commands.record([&]
+        {
+            stateCache.endFrame();
+            streamBuffer.endFrame();
+            jobSystem.endFrame();
+            profiler.endFrame();
+        });
+        renderThread.submit();
+        framePacer.frameDrawn(getTime());
+    }
+    // the frames still queued count in the benchmark, then the context comes back to this thread
+    renderThread.finish();
+    renderThread.stop();
+
 
-        // check and call events and swap the buffers ------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    double benchmarkTime = getTime() - benchmarkStart;
+    std::cout << frameCount << " frames in " << benchmarkTime << " s" << std::endl;
+    if (!headless)
+        std::cout << "idle " << framePacer.getIdleTime() << " s, " << framePacer.getWakeups() << " wake-ups without a frame" << std::endl;
+
+    profiler.shutdown();
+    profiler.printSummary();
+    if (!profileOutput.empty())
+    {
+        profiler.exportCSV(profileOutput + ".csv");
+        profiler.exportJSON(profileOutput + ".json");
     }
 
     // clean up -----------------------------------------------------------------------------------------
@@ -335,8 +978,21 @@ int main()
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    mesh.release();
+    delete gpuRenderer;
+    delete perfHud;
+    streamBuffer.shutdown();
+#ifdef LEARNOPENGL_HAS_EGL
+    delete headlessContext;
+#endif
+#ifndef LEARNOPENGL_NO_GLFW
+    if (!headless)
+    {
+        // glfw: terminate, clearing all previously allocated GLFW resources.
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+#endif
+    logger.shutdown();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,489 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <cmath>
+
+// the frustum query keeps the planes a node still straddles in the top bits of its stack entry
+static const uint32_t BVH_PLANE_SHIFT = 26;
+static const uint32_t BVH_NODE_MASK = (1u << BVH_PLANE_SHIFT) - 1;
+static const uint32_t BVH_ALL_PLANES = (1u << FRUSTUM_PLANE_COUNT) - 1;
+
+static float surfaceArea(const glm::vec3& min, const glm::vec3& max)
+{
+    glm::vec3 size = max - min;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+BVH::BVH()
+{
+}
+
+void BVH::build(const glm::vec3* mins, const glm::vec3* maxs, unsigned int count)
+// (re)build the tree over count objects
+{
+    m_Min.assign(mins, mins + count);
+    m_Max.assign(maxs, maxs + count);
+    m_Objects.resize(count);
+    m_LeafOf.resize(count);
+    std::vector<glm::vec3> centroids(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        m_Objects[i] = i;
+        centroids[i] = (mins[i] + maxs[i]) * 0.5f;
+    }
+
+    m_Nodes.clear();
+    m_Parents.clear();
+    if (count == 0)
+        return;
+    m_Nodes.reserve(count > 0 ? 2 * count : 1);
+    m_Parents.reserve(m_Nodes.capacity());
+    Node root;
+    root.min = root.max = glm::vec3(0.0f);
+    root.leftOrFirst = 0;
+    root.count = count;
+    m_Nodes.push_back(root);
+    m_Parents.push_back(0);
+    updateBounds(0);
+
+    // top-down, children are always stored after their parent (refit() relies on it)
+    m_Stack.clear();
+    m_Stack.push_back(0);
+    while (!m_Stack.empty())
+    {
+        uint32_t node = m_Stack.back();
+        m_Stack.pop_back();
+        if (subdivide(node, centroids))
+        {
+            m_Stack.push_back(m_Nodes[node].leftOrFirst);
+            m_Stack.push_back(m_Nodes[node].leftOrFirst + 1);
+        }
+        else
+        {
+            const Node& leaf = m_Nodes[node];
+            for (uint32_t i = 0; i < leaf.count; i++)
+                m_LeafOf[m_Objects[leaf.leftOrFirst + i]] = node;
+        }
+    }
+}
+
+bool BVH::subdivide(uint32_t nodeIndex, const std::vector<glm::vec3>& centroids)
+// split node in two with the best SAH split of its centroids, false if keeping it a leaf is cheaper
+{
+    Node node = m_Nodes[nodeIndex];
+    if (node.count <= 1)
+        return false;
+
+    glm::vec3 centroidMin(1e30f), centroidMax(-1e30f);
+    for (uint32_t i = 0; i < node.count; i++)
+    {
+        const glm::vec3& centroid = centroids[m_Objects[node.leftOrFirst + i]];
+        centroidMin = glm::min(centroidMin, centroid);
+        centroidMax = glm::max(centroidMax, centroid);
+    }
+
+    // binned SAH: sort the centroids into bins along each axis and try every bin boundary
+    float bestCost = 1e30f;
+    int bestAxis = -1;
+    uint32_t bestSplit = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = centroidMax[axis] - centroidMin[axis];
+        if (extent <= 0.0f)
+            continue;
+        float scale = BVH_SAH_BINS / extent;
+
+        uint32_t binCount[BVH_SAH_BINS] = {};
+        glm::vec3 binMin[BVH_SAH_BINS], binMax[BVH_SAH_BINS];
+        for (uint32_t b = 0; b < BVH_SAH_BINS; b++)
+        {
+            binMin[b] = glm::vec3(1e30f);
+            binMax[b] = glm::vec3(-1e30f);
+        }
+        for (uint32_t i = 0; i < node.count; i++)
+        {
+            uint32_t object = m_Objects[node.leftOrFirst + i];
+            uint32_t bin = std::min(BVH_SAH_BINS - 1, (uint32_t)((centroids[object][axis] - centroidMin[axis]) * scale));
+            binCount[bin]++;
+            binMin[bin] = glm::min(binMin[bin], m_Min[object]);
+            binMax[bin] = glm::max(binMax[bin], m_Max[object]);
+        }
+
+        // sweep from the right to get the cost of every right side, then from the left
+        float rightCost[BVH_SAH_BINS];
+        glm::vec3 sweepMin(1e30f), sweepMax(-1e30f);
+        uint32_t sweepCount = 0;
+        for (uint32_t b = BVH_SAH_BINS - 1; b > 0; b--)
+        {
+            sweepCount += binCount[b];
+            sweepMin = glm::min(sweepMin, binMin[b]);
+            sweepMax = glm::max(sweepMax, binMax[b]);
+            rightCost[b] = sweepCount ? sweepCount * surfaceArea(sweepMin, sweepMax) : 0.0f;
+        }
+        sweepMin = glm::vec3(1e30f);
+        sweepMax = glm::vec3(-1e30f);
+        sweepCount = 0;
+        for (uint32_t b = 1; b < BVH_SAH_BINS; b++)
+        {
+            sweepCount += binCount[b - 1];
+            sweepMin = glm::min(sweepMin, binMin[b - 1]);
+            sweepMax = glm::max(sweepMax, binMax[b - 1]);
+            if (sweepCount == 0 || sweepCount == node.count)
+                continue;
+            float cost = sweepCount * surfaceArea(sweepMin, sweepMax) + rightCost[b];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+    if (bestAxis == -1)
+        return false; // all centroids in one spot
+
+    // a leaf costs one intersection test per object, a split adds the test of the two children (about one test);
+    // small nodes only split when that saves work
+    float nodeArea = surfaceArea(node.min, node.max);
+    float leafCost = node.count * nodeArea;
+    if (node.count <= BVH_MAX_LEAF_SIZE && bestCost + nodeArea >= leafCost)
+        return false;
+
+    // partition the object indices in place, with the same bin computation as above
+    float scale = BVH_SAH_BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+    uint32_t* first = m_Objects.data() + node.leftOrFirst;
+    uint32_t* middle = std::partition(first, first + node.count, [&](uint32_t object) {
+        uint32_t bin = std::min(BVH_SAH_BINS - 1, (uint32_t)((centroids[object][bestAxis] - centroidMin[bestAxis]) * scale));
+        return bin < bestSplit;
+    });
+    uint32_t leftCount = (uint32_t)(middle - first);
+
+    uint32_t left = (uint32_t)m_Nodes.size();
+    Node child;
+    child.min = child.max = glm::vec3(0.0f);
+    child.leftOrFirst = node.leftOrFirst;
+    child.count = leftCount;
+    m_Nodes.push_back(child);
+    child.leftOrFirst = node.leftOrFirst + leftCount;
+    child.count = node.count - leftCount;
+    m_Nodes.push_back(child);
+    m_Parents.push_back(nodeIndex);
+    m_Parents.push_back(nodeIndex);
+    updateBounds(left);
+    updateBounds(left + 1);
+
+    m_Nodes[nodeIndex].leftOrFirst = left;
+    m_Nodes[nodeIndex].count = 0;
+    return true;
+}
+
+bool BVH::updateBounds(uint32_t nodeIndex)
+// recompute the bounds of node from its objects or children, false if they did not change
+{
+    Node& node = m_Nodes[nodeIndex];
+    glm::vec3 min(1e30f), max(-1e30f);
+    if (node.count > 0)
+    {
+        for (uint32_t i = 0; i < node.count; i++)
+        {
+            uint32_t object = m_Objects[node.leftOrFirst + i];
+            min = glm::min(min, m_Min[object]);
+            max = glm::max(max, m_Max[object]);
+        }
+    }
+    else
+    {
+        const Node& left = m_Nodes[node.leftOrFirst];
+        const Node& right = m_Nodes[node.leftOrFirst + 1];
+        min = glm::min(left.min, right.min);
+        max = glm::max(left.max, right.max);
+    }
+    bool changed = min != node.min || max != node.max;
+    node.min = min;
+    node.max = max;
+    return changed;
+}
+
+void BVH::setBounds(unsigned int object, const glm::vec3& min, const glm::vec3& max)
+// set new bounds of an object, the tree is only updated by refit() or refitObjects()
+{
+    m_Min[object] = min;
+    m_Max[object] = max;
+}
+
+void BVH::refit()
+// update the bounds of every node
+{
+    // children are stored after their parents, so going backwards visits them first
+    for (size_t i = m_Nodes.size(); i-- > 0; )
+        updateBounds((uint32_t)i);
+}
+
+void BVH::refitObjects(const unsigned int* objects, unsigned int count)
+// update only the nodes above the given objects
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        uint32_t node = m_LeafOf[objects[i]];
+        // once a node keeps its bounds, nothing above it changes either
+        while (updateBounds(node) && node != 0)
+            node = m_Parents[node];
+    }
+}
+
+bool BVH::cullNode(const Node& node, const Frustum& frustum, const glm::vec3* absNormals, uint32_t& planes) const
+// test node (a stack entry) against the frustum planes it still straddles, false if it is outside.
+// Planes the node is completely inside of are removed from planes
+{
+    if (planes == 0)
+        return true;
+    glm::vec3 center = (node.min + node.max) * 0.5f;
+    glm::vec3 extent = (node.max - node.min) * 0.5f;
+    for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+    {
+        if (!(planes & (1u << p)))
+            continue;
+        float distance = glm::dot(glm::vec3(frustum.planes[p]), center) + frustum.planes[p].w;
+        float radius = glm::dot(absNormals[p], extent);
+        if (distance < -radius)
+            return false;
+        else if (distance >= radius)
+            planes &= ~(1u << p);
+    }
+    return true;
+}
+
+void BVH::cullLeaf(const Node& node, const Frustum& frustum, const glm::vec3* absNormals, uint32_t planes, std::vector<unsigned int>& visible) const
+// append the objects of leaf node that intersect the planes it straddles to visible
+{
+    for (uint32_t i = 0; i < node.count; i++)
+    {
+        uint32_t object = m_Objects[node.leftOrFirst + i];
+        bool inside = true;
+        if (planes != 0)
+        {
+            glm::vec3 center = (m_Min[object] + m_Max[object]) * 0.5f;
+            glm::vec3 extent = (m_Max[object] - m_Min[object]) * 0.5f;
+            for (int p = 0; p < FRUSTUM_PLANE_COUNT && inside; p++)
+                if (planes & (1u << p))
+                    inside = glm::dot(glm::vec3(frustum.planes[p]), center) + frustum.planes[p].w >= -glm::dot(absNormals[p], extent);
+        }
+        if (inside)
+            visible.push_back(object);
+    }
+}
+
+void BVH::queryFrustum(const Frustum& frustum, const glm::vec3* absNormals, std::vector<uint32_t>& stack, std::vector<unsigned int>& visible) const
+// depth-first frustum query of the entries on stack
+{
+    while (!stack.empty())
+    {
+        uint32_t entry = stack.back();
+        stack.pop_back();
+        const Node& node = m_Nodes[entry & BVH_NODE_MASK];
+        uint32_t planes = entry >> BVH_PLANE_SHIFT;
+
+        // test against the planes the parent straddles, a plane the node is completely inside of is dropped for its subtree
+        if (!cullNode(node, frustum, absNormals, planes))
+            continue;
+
+        if (node.count > 0)
+            cullLeaf(node, frustum, absNormals, planes, visible);
+        else
+        {
+            stack.push_back(node.leftOrFirst | (planes << BVH_PLANE_SHIFT));
+            stack.push_back((node.leftOrFirst + 1) | (planes << BVH_PLANE_SHIFT));
+        }
+    }
+}
+
+void BVH::queryFrustum(const Frustum& frustum, std::vector<unsigned int>& visible)
+// indices of the objects whose AABB intersects the frustum, appended to visible in no particular order
+{
+    if (m_Nodes.empty() || m_Objects.empty())
+        return;
+
+    glm::vec3 absNormals[FRUSTUM_PLANE_COUNT];
+    for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+        absNormals[p] = glm::abs(glm::vec3(frustum.planes[p]));
+
+    m_Stack.clear();
+    m_Stack.push_back(0 | (BVH_ALL_PLANES << BVH_PLANE_SHIFT));
+    queryFrustum(frustum, absNormals, m_Stack, visible);
+}
+
+void BVH::queryFrustum(const Frustum& frustum, std::vector<unsigned int>& visible, JobSystem& jobs)
+// same, with the subtrees below the top levels spread over the job system
+{
+    if (m_Objects.size() < BVH_JOB_MIN_OBJECTS || jobs.getWorkerCount() < 2)
+    {
+        queryFrustum(frustum, visible);
+        return;
+    }
+
+    glm::vec3 absNormals[FRUSTUM_PLANE_COUNT];
+    for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+        absNormals[p] = glm::abs(glm::vec3(frustum.planes[p]));
+
+    // open the top of the tree breadth first, so the subtrees handed out are of similar size
+    unsigned int target = jobs.getWorkerCount() * BVH_JOB_SUBTREES;
+    m_Subtrees.clear();
+    m_Subtrees.push_back(0 | (BVH_ALL_PLANES << BVH_PLANE_SHIFT));
+    while (!m_Subtrees.empty() && m_Subtrees.size() < target)
+    {
+        m_Stack.swap(m_Subtrees);
+        m_Subtrees.clear();
+        for (uint32_t entry : m_Stack)
+        {
+            const Node& node = m_Nodes[entry & BVH_NODE_MASK];
+            uint32_t planes = entry >> BVH_PLANE_SHIFT;
+            if (!cullNode(node, frustum, absNormals, planes))
+                continue;
+            if (node.count > 0)
+                cullLeaf(node, frustum, absNormals, planes, visible);
+            else
+            {
+                // the children are tested again when they are popped, with the planes their parent still straddles
+                m_Subtrees.push_back(node.leftOrFirst | (planes << BVH_PLANE_SHIFT));
+                m_Subtrees.push_back((node.leftOrFirst + 1) | (planes << BVH_PLANE_SHIFT));
+            }
+        }
+    }
+
+    // every subtree collects into its own list, appended in order so the result does not depend on the scheduling
+    unsigned int subtreeCount = (unsigned int)m_Subtrees.size();
+    if (m_SubtreeVisible.size() < subtreeCount)
+        m_SubtreeVisible.resize(subtreeCount);
+    jobs.parallelFor(0, subtreeCount, 1, [&](unsigned int first, unsigned int end)
+    {
+        std::vector<uint32_t> stack;
+        for (unsigned int s = first; s < end; s++)
+        {
+            m_SubtreeVisible[s].clear();
+            stack.push_back(m_Subtrees[s]);
+            queryFrustum(frustum, absNormals, stack, m_SubtreeVisible[s]);
+        }
+    });
+    for (unsigned int s = 0; s < subtreeCount; s++)
+        visible.insert(visible.end(), m_SubtreeVisible[s].begin(), m_SubtreeVisible[s].end());
+}
+
+static float intersectBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& min, const glm::vec3& max, float maxDistance)
+// slab test, distance to the box (0 if origin is inside it) or 1e30 if the ray misses it within maxDistance
+{
+    glm::vec3 t0 = (min - origin) * inverseDirection;
+    glm::vec3 t1 = (max - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+    return enter <= exit ? enter : 1e30f;
+}
+
+BVHHit BVH::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+// closest object whose AABB the ray hits, direction must be normalized
+{
+    BVHHit hit = { -1, maxDistance };
+    if (m_Nodes.empty() || m_Objects.empty())
+        return hit;
+
+    glm::vec3 inverseDirection = 1.0f / direction; // infinities for axis-parallel rays are fine for the slab test
+    if (intersectBox(origin, inverseDirection, m_Nodes[0].min, m_Nodes[0].max, hit.distance) == 1e30f)
+        return hit;
+
+    m_Stack.clear();
+    m_Stack.push_back(0);
+    while (!m_Stack.empty())
+    {
+        const Node& node = m_Nodes[m_Stack.back()];
+        m_Stack.pop_back();
+
+        if (node.count > 0)
+        {
+            for (uint32_t i = 0; i < node.count; i++)
+            {
+                uint32_t object = m_Objects[node.leftOrFirst + i];
+                float distance = intersectBox(origin, inverseDirection, m_Min[object], m_Max[object], hit.distance);
+                if (distance < hit.distance)
+                {
+                    hit.distance = distance;
+                    hit.object = (int)object;
+                }
+            }
+            continue;
+        }
+
+        // visit the nearer child first (pushed last), a hit there may let us skip the other one
+        uint32_t left = node.leftOrFirst, right = node.leftOrFirst + 1;
+        float leftDistance = intersectBox(origin, inverseDirection, m_Nodes[left].min, m_Nodes[left].max, hit.distance);
+        float rightDistance = intersectBox(origin, inverseDirection, m_Nodes[right].min, m_Nodes[right].max, hit.distance);
+        if (leftDistance > rightDistance)
+        {
+            std::swap(left, right);
+            std::swap(leftDistance, rightDistance);
+        }
+        if (rightDistance < hit.distance)
+            m_Stack.push_back(right);
+        if (leftDistance < hit.distance)
+            m_Stack.push_back(left);
+    }
+    return hit;
+}
+
+static float distanceSquaredToBox(const glm::vec3& point, const glm::vec3& min, const glm::vec3& max)
+{
+    glm::vec3 outside = glm::max(glm::max(min - point, point - max), glm::vec3(0.0f));
+    return glm::dot(outside, outside);
+}
+
+BVHHit BVH::nearest(const glm::vec3& point, float maxDistance)
+// object whose AABB is closest to point (distance 0 if point is inside it)
+{
+    BVHHit hit = { -1, maxDistance };
+    if (m_Nodes.empty() || m_Objects.empty())
+        return hit;
+    float best = maxDistance * maxDistance;
+
+    m_Stack.clear();
+    m_Stack.push_back(0);
+    while (!m_Stack.empty())
+    {
+        const Node& node = m_Nodes[m_Stack.back()];
+        m_Stack.pop_back();
+        // the stack may hold nodes that got out of range since they were pushed
+        if (distanceSquaredToBox(point, node.min, node.max) >= best)
+            continue;
+
+        if (node.count > 0)
+        {
+            for (uint32_t i = 0; i < node.count; i++)
+            {
+                uint32_t object = m_Objects[node.leftOrFirst + i];
+                float distance = distanceSquaredToBox(point, m_Min[object], m_Max[object]);
+                if (distance < best)
+                {
+                    best = distance;
+                    hit.object = (int)object;
+                }
+            }
+            continue;
+        }
+
+        // nearer child first, as in raycast()
+        uint32_t left = node.leftOrFirst, right = node.leftOrFirst + 1;
+        float leftDistance = distanceSquaredToBox(point, m_Nodes[left].min, m_Nodes[left].max);
+        float rightDistance = distanceSquaredToBox(point, m_Nodes[right].min, m_Nodes[right].max);
+        if (leftDistance > rightDistance)
+        {
+            std::swap(left, right);
+            std::swap(leftDistance, rightDistance);
+        }
+        if (rightDistance < best)
+            m_Stack.push_back(right);
+        if (leftDistance < best)
+            m_Stack.push_back(left);
+    }
+    if (hit.object != -1)
+        hit.distance = std::sqrt(best);
+    return hit;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Frustum.h"
+#include "JobSystem.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+const unsigned int BVH_MAX_LEAF_SIZE = 4;   // objects per leaf
+const unsigned int BVH_SAH_BINS = 16;       // centroid bins tried per axis when splitting
+const unsigned int BVH_JOB_MIN_OBJECTS = 16384; // smaller trees are queried on the calling thread
+const unsigned int BVH_JOB_SUBTREES = 8;    // subtrees handed out per worker by the parallel frustum query
+
+// result of BVH::raycast() and BVH::nearest(), object is -1 when nothing was found
+struct BVHHit
+{
+    int object;
+    float distance;
+};
+
+// Bounding volume hierarchy over object AABBs, built top-down with the binned surface area heuristic.
+// Objects that move are refit in place (bounds grow/shrink, the tree shape is kept), which is much cheaper
+// than a rebuild; rebuild once the tree gets too loose (e.g. after objects have moved far).
+class BVH
+{
+private:
+    struct Node
+    {
+        glm::vec3 min;
+        uint32_t leftOrFirst;   // internal: index of the left child (the right one follows it), leaf: first entry in m_Objects
+        glm::vec3 max;
+        uint32_t count;         // objects in the leaf, 0 for internal nodes
+    };
+
+    std::vector<Node> m_Nodes;
+    std::vector<uint32_t> m_Parents;    // parent of every node, root has none
+    std::vector<uint32_t> m_Objects;    // object indices, grouped by leaf
+    std::vector<uint32_t> m_LeafOf;     // leaf node of every object
+    std::vector<glm::vec3> m_Min;       // object bounds
+    std::vector<glm::vec3> m_Max;
+    std::vector<uint32_t> m_Stack;      // traversal scratch space, queries are not thread safe
+    std::vector<uint32_t> m_Subtrees;   // roots handed out by the parallel frustum query
+    std::vector<std::vector<unsigned int>> m_SubtreeVisible;
+
+    // split node in two with the best SAH split of its centroids, false if keeping it a leaf is cheaper
+    bool subdivide(uint32_t node, const std::vector<glm::vec3>& centroids);
+    // recompute the bounds of node from its objects or children, false if they did not change
+    bool updateBounds(uint32_t node);
+    // test node (a stack entry) against the frustum planes it still straddles, false if it is outside.
+    // Planes the node is completely inside of are removed from planes
+    bool cullNode(const Node& node, const Frustum& frustum, const glm::vec3* absNormals, uint32_t& planes) const;
+    // append the objects of leaf node that intersect the planes it straddles to visible
+    void cullLeaf(const Node& node, const Frustum& frustum, const glm::vec3* absNormals, uint32_t planes, std::vector<unsigned int>& visible) const;
+    // depth-first frustum query of the entries on stack
+    void queryFrustum(const Frustum& frustum, const glm::vec3* absNormals, std::vector<uint32_t>& stack, std::vector<unsigned int>& visible) const;
+
+public:
+    BVH();
+
+    // (re)build the tree over count objects
+    void build(const glm::vec3* mins, const glm::vec3* maxs, unsigned int count);
+    // set new bounds of an object, the tree is only updated by refit() or refitObjects()
+    void setBounds(unsigned int object, const glm::vec3& min, const glm::vec3& max);
+    // update the bounds of every node
+    void refit();
+    // update only the nodes above the given objects, cost grows with the number of moved objects instead of the scene size
+    void refitObjects(const unsigned int* objects, unsigned int count);
+
+    // indices of the objects whose AABB intersects the frustum, appended to visible in no particular order
+    void queryFrustum(const Frustum& frustum, std::vector<unsigned int>& visible);
+    // same, with the subtrees below the top levels spread over the job system
+    void queryFrustum(const Frustum& frustum, std::vector<unsigned int>& visible, JobSystem& jobs);
+    // closest object whose AABB the ray hits, direction must be normalized
+    BVHHit raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance = 1e30f);
+    // object whose AABB is closest to point (distance 0 if point is inside it)
+    BVHHit nearest(const glm::vec3& point, float maxDistance = 1e30f);
+
+    unsigned int getObjectCount() const { return (unsigned int)m_Min.size(); }
+    unsigned int getNodeCount() const { return (unsigned int)m_Nodes.size(); }
+};
@@ -0,0 +1,333 @@
+#include "Benchmarks.h"
+#include "BVH.h"
+#include "Camera.h"
+#include "Culling.h"
+#include "JobSystem.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// every measurement repeats its work until at least this much time has passed
+static const double BENCHMARK_MIN_MS = 200.0;
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int runCullingBenchmark(unsigned int objectCount)
+// frustum culling throughput of every supported instruction set, in objects tested per millisecond
+{
+    // objects scattered in a box around the default camera, roughly a tenth of them end up visible
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> scatter(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.2f, 2.0f);
+    BoundingSpheres spheres;
+    BoundingBoxes boxes;
+    spheres.resize(objectCount);
+    boxes.resize(objectCount);
+    for (unsigned int i = 0; i < objectCount; i++)
+    {
+        glm::vec3 center(scatter(rng), scatter(rng), scatter(rng));
+        float radius = size(rng);
+        spheres.set(i, center, radius);
+        boxes.set(i, center - glm::vec3(radius), center + glm::vec3(radius));
+    }
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+    Frustum frustum = camera.GetFrustum(16.0f / 9.0f);
+
+    std::cout << "Frustum culling, " << objectCount << " objects" << std::endl;
+    std::vector<unsigned int> visible;
+    const CullingPath paths[] = { CULLING_SCALAR, CULLING_SSE, CULLING_AVX };
+    int expectedSpheres = -1, expectedBoxes = -1;
+    int result = 0;
+    for (CullingPath path : paths)
+    {
+        if (!isCullingPathSupported(path))
+        {
+            std::cout << "  " << getCullingPathName(path) << ": not supported on this CPU" << std::endl;
+            continue;
+        }
+
+        unsigned int sphereCount = 0, boxCount = 0;
+        unsigned int iterations = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        double sphereMs;
+        do
+        {
+            sphereCount = cullSpheres(frustum, spheres, visible, path);
+            iterations++;
+        } while ((sphereMs = elapsedMs(start)) < BENCHMARK_MIN_MS);
+        double spheresPerMs = (double)objectCount * iterations / sphereMs;
+
+        iterations = 0;
+        start = std::chrono::steady_clock::now();
+        double boxMs;
+        do
+        {
+            boxCount = cullBoxes(frustum, boxes, visible, path);
+            iterations++;
+        } while ((boxMs = elapsedMs(start)) < BENCHMARK_MIN_MS);
+        double boxesPerMs = (double)objectCount * iterations / boxMs;
+
+        std::cout << "  " << getCullingPathName(path) << ": spheres " << (unsigned long long)spheresPerMs << " objects/ms (" << sphereCount << " visible), "
+                  << "boxes " << (unsigned long long)boxesPerMs << " objects/ms (" << boxCount << " visible)" << std::endl;
+
+        // every path must agree with the scalar reference
+        if (expectedSpheres == -1)
+        {
+            expectedSpheres = (int)sphereCount;
+            expectedBoxes = (int)boxCount;
+        }
+        else if ((int)sphereCount != expectedSpheres || (int)boxCount != expectedBoxes)
+        {
+            std::cout << "  ERROR: " << getCullingPathName(path) << " disagrees with the scalar result" << std::endl;
+            result = 1;
+        }
+    }
+    return result;
+}
+
+int runBVHBenchmark(unsigned int objectCount)
+// BVH build, refit and query times, compared against testing every object
+{
+    if (objectCount == 0)
+    {
+        std::cout << "ERROR::BENCHMARK::NO_OBJECTS --bench-bvh N needs N > 0" << std::endl;
+        return 1;
+    }
+    // unit cubes scattered like the --cubes scene
+    std::mt19937 rng(1234);
+    float extent = 2.0f * std::cbrt((float)objectCount);
+    std::uniform_real_distribution<float> scatter(-extent, extent);
+    std::vector<glm::vec3> mins(objectCount), maxs(objectCount);
+    BoundingBoxes boxes;
+    boxes.resize(objectCount);
+    for (unsigned int i = 0; i < objectCount; i++)
+    {
+        glm::vec3 center(scatter(rng), scatter(rng), scatter(rng) - extent);
+        mins[i] = center - glm::vec3(0.5f);
+        maxs[i] = center + glm::vec3(0.5f);
+        boxes.set(i, mins[i], maxs[i]);
+    }
+    std::cout << "BVH, " << objectCount << " objects" << std::endl;
+
+    BVH bvh;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bvh.build(mins.data(), maxs.data(), objectCount);
+    std::cout << "  build: " << elapsedMs(start) << " ms, " << bvh.getNodeCount() << " nodes" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    bvh.refit();
+    std::cout << "  full refit: " << elapsedMs(start) << " ms" << std::endl;
+
+    // move 1% of the objects a little and refit only above them
+    std::vector<unsigned int> moved;
+    std::uniform_int_distribution<unsigned int> pick(0, objectCount - 1);
+    std::uniform_real_distribution<float> nudge(-0.5f, 0.5f);
+    for (unsigned int i = 0; i < objectCount / 100 + 1; i++)
+    {
+        unsigned int object = pick(rng);
+        glm::vec3 offset(nudge(rng), nudge(rng), nudge(rng));
+        mins[object] += offset;
+        maxs[object] += offset;
+        boxes.set(object, mins[object], maxs[object]);
+        bvh.setBounds(object, mins[object], maxs[object]);
+        moved.push_back(object);
+    }
+    start = std::chrono::steady_clock::now();
+    bvh.refitObjects(moved.data(), (unsigned int)moved.size());
+    std::cout << "  refit of " << moved.size() << " moved objects: " << elapsedMs(start) << " ms" << std::endl;
+
+    // frustum query against the linear SIMD loop
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+    Frustum frustum = camera.GetFrustum(16.0f / 9.0f);
+    std::vector<unsigned int> visible;
+    unsigned int iterations = 0;
+    double bvhMs;
+    start = std::chrono::steady_clock::now();
+    do
+    {
+        visible.clear();
+        bvh.queryFrustum(frustum, visible);
+        iterations++;
+    } while ((bvhMs = elapsedMs(start)) < BENCHMARK_MIN_MS);
+    size_t bvhVisible = visible.size();
+    bvhMs /= iterations;
+
+    iterations = 0;
+    unsigned int linearVisible = 0;
+    double linearMs;
+    start = std::chrono::steady_clock::now();
+    do
+    {
+        linearVisible = cullBoxes(frustum, boxes, visible);
+        iterations++;
+    } while ((linearMs = elapsedMs(start)) < BENCHMARK_MIN_MS);
+    linearMs /= iterations;
+    std::cout << "  frustum query: " << bvhMs << " ms (" << bvhVisible << " visible), linear " << getCullingPathName(CULLING_BEST)
+              << ": " << linearMs << " ms (" << linearVisible << " visible)" << std::endl;
+    int result = bvhVisible == linearVisible ? 0 : 1;
+
+    // same query with the subtrees spread over the job system
+    JobSystem jobs;
+    iterations = 0;
+    double jobsMs;
+    start = std::chrono::steady_clock::now();
+    do
+    {
+        visible.clear();
+        bvh.queryFrustum(frustum, visible, jobs);
+        iterations++;
+    } while ((jobsMs = elapsedMs(start)) < BENCHMARK_MIN_MS);
+    jobsMs /= iterations;
+    std::cout << "  frustum query on " << jobs.getWorkerCount() << " workers: " << jobsMs << " ms (" << visible.size() << " visible)" << std::endl;
+    if (visible.size() != bvhVisible)
+        result = 1;
+
+    // rays and nearest neighbours from random points, a few of them checked against brute force
+    const unsigned int QUERIES = 10000;
+    std::vector<glm::vec3> origins(QUERIES), directions(QUERIES);
+    for (unsigned int i = 0; i < QUERIES; i++)
+    {
+        origins[i] = glm::vec3(scatter(rng), scatter(rng), scatter(rng) - extent);
+        directions[i] = glm::normalize(glm::vec3(nudge(rng), nudge(rng), nudge(rng)) + glm::vec3(1e-4f));
+    }
+    unsigned int hits = 0;
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < QUERIES; i++)
+        hits += bvh.raycast(origins[i], directions[i]).object != -1;
+    std::cout << "  raycast: " << elapsedMs(start) * 1000.0 / QUERIES << " us per ray (" << hits << " of " << QUERIES << " hit)" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    float distanceSum = 0.0f;
+    for (unsigned int i = 0; i < QUERIES; i++)
+        distanceSum += bvh.nearest(origins[i]).distance;
+    std::cout << "  nearest: " << elapsedMs(start) * 1000.0 / QUERIES << " us per query (mean distance " << distanceSum / QUERIES << ")" << std::endl;
+
+    for (unsigned int i = 0; i < 20; i++)
+    {
+        float best = 1e30f;
+        for (unsigned int object = 0; object < objectCount; object++)
+        {
+            glm::vec3 outside = glm::max(glm::max(mins[object] - origins[i], origins[i] - maxs[object]), glm::vec3(0.0f));
+            best = std::min(best, glm::length(outside));
+        }
+        if (std::fabs(best - bvh.nearest(origins[i]).distance) > 1e-3f)
+            result = 1;
+    }
+    if (result != 0)
+        std::cout << "  ERROR: BVH results disagree with brute force" << std::endl;
+    return result;
+}
+
+static std::vector<uint64_t> sortedTriangles(const unsigned int* indices, std::size_t indexCount)
+// the triangle list as a sorted multiset, each triangle rotated to start with its smallest index so that the winding is kept
+{
+    std::vector<uint64_t> triangles;
+    for (std::size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        unsigned int t[3] = { indices[i], indices[i + 1], indices[i + 2] };
+        int first = t[1] < t[0] ? (t[2] < t[1] ? 2 : 1) : (t[2] < t[0] ? 2 : 0);
+        // 21 bits per index is plenty for the benchmark grids
+        triangles.push_back((uint64_t)t[first] << 42 | (uint64_t)t[(first + 1) % 3] << 21 | (uint64_t)t[(first + 2) % 3]);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+int runMeshOptimizerBenchmark(unsigned int gridSize)
+// index optimizations on a gridSize x gridSize vertex grid sprinkled with degenerate triangles, checks that the
+// triangles come out the same set in a new order
+{
+    gridSize = std::min(std::max(gridSize, 2u), 1024u);
+    std::vector<glm::vec3> positions;
+    for (unsigned int y = 0; y < gridSize; y++)
+        for (unsigned int x = 0; x < gridSize; x++)
+            positions.push_back(glm::vec3((float)x, (float)y, 0.0f));
+
+    // two triangles per quad, the quads shuffled like an exporter that ignores the vertex cache
+    std::mt19937 rng(1234);
+    std::vector<unsigned int> quads;
+    for (unsigned int y = 0; y + 1 < gridSize; y++)
+        for (unsigned int x = 0; x + 1 < gridSize; x++)
+            quads.push_back(y * gridSize + x);
+    std::shuffle(quads.begin(), quads.end(), rng);
+    std::vector<unsigned int> valid;
+    for (unsigned int q : quads)
+    {
+        const unsigned int quad[6] = { q, q + 1, q + gridSize, q + 1, q + gridSize + 1, q + gridSize };
+        valid.insert(valid.end(), quad, quad + 6);
+    }
+    // every 8th triangle is followed by a degenerate one: repeated indices in each position, or three vertices in a row
+    std::vector<unsigned int> indices;
+    std::size_t degenerateCount = 0;
+    for (std::size_t i = 0; i < valid.size(); i += 3)
+    {
+        indices.insert(indices.end(), valid.begin() + i, valid.begin() + i + 3);
+        if ((i / 3) % 8 != 0)
+            continue;
+        unsigned int a = valid[i], b = valid[i + 1];
+        unsigned int row = a - a % gridSize;
+        const unsigned int degenerates[4][3] = { { a, a, b }, { a, b, a }, { b, a, a }, { row, row + 1, row + gridSize - 1 } };
+        const unsigned int* degenerate = degenerates[(i / 3 / 8) % 4];
+        indices.insert(indices.end(), degenerate, degenerate + 3);
+        degenerateCount++;
+    }
+    std::cout << "Mesh optimizer, " << valid.size() / 3 << " triangles and " << degenerateCount << " degenerate ones" << std::endl;
+    int result = 0;
+
+    // the cache optimizer alone must cope with the degenerate triangles
+    std::vector<unsigned int> raw(indices);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    optimizeVertexCache(raw.data(), raw.size(), positions.size());
+    std::cout << "  vertex cache with degenerate triangles: " << elapsedMs(start) << " ms" << std::endl;
+    if (sortedTriangles(raw.data(), raw.size()) != sortedTriangles(indices.data(), indices.size()))
+    {
+        std::cout << "  ERROR: optimizeVertexCache lost or changed triangles" << std::endl;
+        result = 1;
+    }
+
+    // the import pipeline: degenerate triangles dropped first, then the three optimizations
+    start = std::chrono::steady_clock::now();
+    indices.resize(removeDegenerateTriangles(indices.data(), indices.size(), positions.data(), sizeof(glm::vec3)));
+    double removeMs = elapsedMs(start);
+    if (indices.size() != valid.size())
+    {
+        std::cout << "  ERROR: removeDegenerateTriangles kept " << indices.size() / 3 << " triangles, expected " << valid.size() / 3 << std::endl;
+        result = 1;
+    }
+    VertexCacheStats before = analyzeVertexCache(indices.data(), indices.size(), positions.size());
+    start = std::chrono::steady_clock::now();
+    optimizeVertexCache(indices.data(), indices.size(), positions.size());
+    double cacheMs = elapsedMs(start);
+    start = std::chrono::steady_clock::now();
+    optimizeOverdraw(indices.data(), indices.size(), positions.data(), sizeof(glm::vec3), positions.size());
+    double overdrawMs = elapsedMs(start);
+    VertexCacheStats after = analyzeVertexCache(indices.data(), indices.size(), positions.size());
+    std::vector<unsigned int> remap;
+    start = std::chrono::steady_clock::now();
+    optimizeVertexFetch(indices.data(), indices.size(), positions.size(), remap);
+    double fetchMs = elapsedMs(start);
+    std::cout << "  degenerate removal " << removeMs << " ms, vertex cache " << cacheMs << " ms, overdraw " << overdrawMs << " ms, vertex fetch "
+              << fetchMs << " ms (ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << ")" << std::endl;
+
+    // undo the vertex renumbering to compare with the input
+    std::vector<unsigned int> inverse(remap.size());
+    for (std::size_t i = 0; i < remap.size(); i++)
+        inverse[remap[i]] = (unsigned int)i;
+    for (unsigned int& index : indices)
+        index = inverse[index];
+    if (sortedTriangles(indices.data(), indices.size()) != sortedTriangles(valid.data(), valid.size()))
+    {
+        std::cout << "  ERROR: the optimized index list does not hold the input triangles" << std::endl;
+        result = 1;
+    }
+    return result;
+}
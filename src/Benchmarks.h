@@ -0,0 +1,14 @@
+#pragma once
+
+// Command line micro-benchmarks (--bench-* flags), they run without an OpenGL context and print their results.
+// Each returns the process exit code.
+
+// frustum culling throughput of every supported instruction set, in objects tested per millisecond
+int runCullingBenchmark(unsigned int objectCount);
+
+// BVH build, refit and query times, compared against testing every object
+int runBVHBenchmark(unsigned int objectCount);
+
+// index optimizations on a gridSize x gridSize vertex grid sprinkled with degenerate triangles, checks that the
+// triangles come out the same set in a new order
+int runMeshOptimizerBenchmark(unsigned int gridSize);
@@ -42,6 +42,18 @@ glm::mat4 Camera::GetViewMatrix()
     return glm::lookAt(Position, Position + Front, Up);
 }
 
+glm::mat4 Camera::GetProjectionMatrix(float aspect, float nearPlane, float farPlane)
+// returns the perspective projection for the current zoom (vertical field of view)
+{
+    return glm::perspective(glm::radians(Zoom), aspect, nearPlane, farPlane);
+}
+
+Frustum Camera::GetFrustum(float aspect, float nearPlane, float farPlane)
+// returns the world space view frustum, the planes of GetProjectionMatrix() * GetViewMatrix()
+{
+    return Frustum::fromMatrix(GetProjectionMatrix(aspect, nearPlane, farPlane) * GetViewMatrix());
+}
+
 void Camera::ProcessKeyboard(Camera_Movement direction, float deltaTime)
 // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
 {
@@ -88,6 +100,12 @@ void Camera::ProcessMouseScroll(float yoffset)
         Zoom = 45.0f;
 }
 
+void Camera::setPosition(glm::vec3 position)
+// moves the camera without changing where it looks, e.g. to a position interpolated between simulation ticks
+{
+    Position = position;
+}
+
 glm::vec3 Camera::getPosition()
 {
     return Position;
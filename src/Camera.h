@@ -4,6 +4,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "Frustum.h"
+
 #include <vector>
 
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
@@ -20,6 +22,8 @@ const float PITCH = 0.0f;
 const float SPEED = 2.5f;
 const float SENSITIVITY = 0.1f;
 const float ZOOM = 45.0f;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
 
 class Camera
 {
@@ -47,12 +51,18 @@ public:
     Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch);
     // returns the view matrix calculated using Euler Angles and the LookAt Matrix
     glm::mat4 GetViewMatrix();
+    // returns the perspective projection for the current zoom (vertical field of view)
+    glm::mat4 GetProjectionMatrix(float aspect, float nearPlane = NEAR_PLANE, float farPlane = FAR_PLANE);
+    // returns the world space view frustum, the planes of GetProjectionMatrix() * GetViewMatrix()
+    Frustum GetFrustum(float aspect, float nearPlane = NEAR_PLANE, float farPlane = FAR_PLANE);
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, float deltaTime);
     // processes input received from a mouse input system. Expects the offset value in both the x and y direction.
     void ProcessMouseMovement(float xoffset, float yoffset, GLboolean constrainPitch = true);
     // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
     void ProcessMouseScroll(float yoffset);
+    // moves the camera without changing where it looks, e.g. to a position interpolated between simulation ticks
+    void setPosition(glm::vec3 position);
 
     glm::vec3 getPosition();
     glm::vec3 getFront();
@@ -0,0 +1,64 @@
+#include "CommandBuffer.h"
+
+CommandBuffer::CommandBuffer()
+    : m_Block(0), m_Used(0), m_Bytes(0), m_Count(0), m_First(NULL), m_Last(NULL)
+{
+}
+
+CommandBuffer::~CommandBuffer()
+{
+    finish(false);
+    for (const Block& block : m_Blocks)
+        delete[] block.data;
+}
+
+void* CommandBuffer::allocate(std::size_t size, std::size_t alignment)
+// size bytes valid until the next execute(), alignment at most alignof(std::max_align_t)
+{
+    for (;;)
+    {
+        if (m_Block < m_Blocks.size())
+        {
+            Block& block = m_Blocks[m_Block];
+            std::size_t offset = (m_Used + alignment - 1) / alignment * alignment;
+            if (offset + size <= block.size)
+            {
+                m_Used = offset + size;
+                m_Bytes += size;
+                return block.data + offset;
+            }
+            m_Block++;
+            m_Used = 0;
+            continue;
+        }
+        // out of blocks: new ones stay for the next frames; new[] returns memory aligned for any standard type
+        Block block;
+        block.size = size > COMMAND_BLOCK_SIZE ? size : COMMAND_BLOCK_SIZE;
+        block.data = new unsigned char[block.size];
+        m_Blocks.push_back(block);
+    }
+}
+
+void CommandBuffer::finish(bool run)
+// destroys the commands, running them first if run
+{
+    Command* command = m_First;
+    while (command)
+    {
+        Command* next = command->next;     // read before the command destroys itself
+        command->invoke(command, run);
+        command = next;
+    }
+    m_First = NULL;
+    m_Last = NULL;
+    m_Block = 0;
+    m_Used = 0;
+    m_Bytes = 0;
+    m_Count = 0;
+}
+
+void CommandBuffer::execute()
+// run the commands in recording order and empty the buffer
+{
+    finish(true);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+const std::size_t COMMAND_BLOCK_SIZE = 64 * 1024;   // bytes per block of the linear allocator, bigger allocations get their own
+
+// Commands recorded now and executed later, possibly on another thread. Every command is a function object
+// (usually a lambda capturing what it needs by value) placed in a linear allocator along with the data it points
+// to (copy()/allocate()), so recording a frame costs no heap allocation once the blocks have grown to its size.
+// execute() runs the commands in order and empties the buffer, keeping the blocks.
+class CommandBuffer
+{
+private:
+    struct Command
+    {
+        void (*invoke)(Command* command, bool run);  // runs the function if run, then destroys it
+        Command* next;
+    };
+
+    template <typename Function>
+    struct CommandOf : Command
+    {
+        Function function;
+
+        template <typename F>
+        CommandOf(F&& f) : function(std::forward<F>(f)) {}
+
+        static void invoke(Command* command, bool run)
+        {
+            CommandOf* self = static_cast<CommandOf*>(command);
+            if (run)
+                self->function();
+            self->~CommandOf();
+        }
+    };
+
+    struct Block
+    {
+        unsigned char* data;
+        std::size_t size;
+    };
+
+    std::vector<Block> m_Blocks;
+    std::size_t m_Block;        // block being filled
+    std::size_t m_Used;         // bytes used in it
+    std::size_t m_Bytes;        // bytes allocated since the last execute()
+    unsigned int m_Count;       // commands recorded since the last execute()
+    Command* m_First;
+    Command* m_Last;
+
+    // destroys the commands, running them first if run
+    void finish(bool run);
+
+public:
+    CommandBuffer();
+    // Destructor, drops the commands not executed
+    ~CommandBuffer();
+
+    CommandBuffer(const CommandBuffer&) = delete;
+    CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+    // size bytes valid until the next execute(), alignment at most alignof(std::max_align_t)
+    void* allocate(std::size_t size, std::size_t alignment);
+    // uninitialized array of count T, T must be trivially copyable
+    template <typename T>
+    T* allocate(std::size_t count)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "CommandBuffer arrays are not destroyed");
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+    // copy of count T for a command to read when it runs
+    template <typename T>
+    T* copy(const T* data, std::size_t count)
+    {
+        T* out = allocate<T>(count);
+        if (count > 0)
+            memcpy(out, data, count * sizeof(T));
+        return out;
+    }
+
+    // append a command, function is moved into the buffer and called without arguments by execute()
+    template <typename Function>
+    void record(Function&& function)
+    {
+        typedef CommandOf<typename std::decay<Function>::type> Recorded;
+        static_assert(alignof(Recorded) <= alignof(std::max_align_t), "over-aligned command");
+        Command* command = new (allocate(sizeof(Recorded), alignof(Recorded))) Recorded(std::forward<Function>(function));
+        command->invoke = &Recorded::invoke;
+        command->next = NULL;
+        if (m_Last)
+            m_Last->next = command;
+        else
+            m_First = command;
+        m_Last = command;
+        m_Count++;
+    }
+
+    // run the commands in recording order and empty the buffer
+    void execute();
+
+    std::size_t getBytes() const { return m_Bytes; }
+    unsigned int getCount() const { return m_Count; }
+};
@@ -0,0 +1,373 @@
+#include "Culling.h"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CULLING_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// the AVX loops are compiled for AVX even when the rest of the program is not, and only called if the CPU has it
+#if defined(CULLING_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CULLING_TARGET_AVX __attribute__((target("avx")))
+#else
+#define CULLING_TARGET_AVX
+#endif
+
+// padding objects: never visible, whatever the frustum
+static const float NEVER_VISIBLE = -1e30f;
+
+static unsigned int paddedCount(unsigned int count)
+{
+    return (count + CULLING_BATCH - 1) / CULLING_BATCH * CULLING_BATCH;
+}
+
+// ------------------------------------------------------------------------
+// storage
+// ------------------------------------------------------------------------
+
+void BoundingSpheres::resize(unsigned int count)
+{
+    unsigned int padded = paddedCount(count);
+    m_X.resize(padded, 0.0f);
+    m_Y.resize(padded, 0.0f);
+    m_Z.resize(padded, 0.0f);
+    m_Radius.resize(padded, NEVER_VISIBLE);
+    // a shrink leaves former objects in the padding
+    for (unsigned int i = count; i < padded; i++)
+        m_Radius[i] = NEVER_VISIBLE;
+    m_Count = count;
+}
+
+void BoundingSpheres::set(unsigned int index, const glm::vec3& center, float radius)
+{
+    m_X[index] = center.x;
+    m_Y[index] = center.y;
+    m_Z[index] = center.z;
+    m_Radius[index] = radius;
+}
+
+void BoundingBoxes::resize(unsigned int count)
+{
+    unsigned int padded = paddedCount(count);
+    m_X.resize(padded, 0.0f);
+    m_Y.resize(padded, 0.0f);
+    m_Z.resize(padded, 0.0f);
+    m_ExtentX.resize(padded, NEVER_VISIBLE);
+    m_ExtentY.resize(padded, NEVER_VISIBLE);
+    m_ExtentZ.resize(padded, NEVER_VISIBLE);
+    for (unsigned int i = count; i < padded; i++)
+        m_ExtentX[i] = m_ExtentY[i] = m_ExtentZ[i] = NEVER_VISIBLE;
+    m_Count = count;
+}
+
+void BoundingBoxes::set(unsigned int index, const glm::vec3& min, const glm::vec3& max)
+{
+    glm::vec3 center = (min + max) * 0.5f;
+    glm::vec3 extent = (max - min) * 0.5f;
+    m_X[index] = center.x;
+    m_Y[index] = center.y;
+    m_Z[index] = center.z;
+    m_ExtentX[index] = extent.x;
+    m_ExtentY[index] = extent.y;
+    m_ExtentZ[index] = extent.z;
+}
+
+// ------------------------------------------------------------------------
+// CPU feature detection
+// ------------------------------------------------------------------------
+
+static bool cpuHasAVX()
+{
+#if defined(CULLING_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    // the OS must save the YMM registers on context switches as well
+    return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#elif defined(CULLING_X86)
+    return __builtin_cpu_supports("avx") != 0;
+#else
+    return false;
+#endif
+}
+
+bool isCullingPathSupported(CullingPath path)
+// true if path can run on this CPU (CULLING_SCALAR and CULLING_BEST always can)
+{
+    switch (path)
+    {
+#ifdef CULLING_X86
+    case CULLING_SSE: return true; // SSE2 is part of x86-64, and required by every x86 CPU that runs OpenGL 3.3
+    case CULLING_AVX:
+    {
+        static const bool avx = cpuHasAVX();
+        return avx;
+    }
+#else
+    case CULLING_SSE: return false;
+    case CULLING_AVX: return false;
+#endif
+    default: return true;
+    }
+}
+
+static CullingPath resolvePath(CullingPath path)
+{
+    if (path == CULLING_BEST)
+        path = isCullingPathSupported(CULLING_AVX) ? CULLING_AVX : (isCullingPathSupported(CULLING_SSE) ? CULLING_SSE : CULLING_SCALAR);
+    return isCullingPathSupported(path) ? path : CULLING_SCALAR;
+}
+
+const char* getCullingPathName(CullingPath path)
+{
+    switch (resolvePath(path))
+    {
+    case CULLING_SSE: return "SSE";
+    case CULLING_AVX: return "AVX";
+    default: return "scalar";
+    }
+}
+
+// ------------------------------------------------------------------------
+// culling loops: a mask of visible objects per batch, then a branchless append of their indices
+// ------------------------------------------------------------------------
+
+static unsigned int appendVisible(unsigned int* out, unsigned int first, unsigned int mask, unsigned int width)
+{
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < width; i++)
+    {
+        out[count] = first + i;
+        count += (mask >> i) & 1;
+    }
+    return count;
+}
+
+static unsigned int cullSpheresScalar(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+                                      unsigned int count, unsigned int* out)
+{
+    unsigned int visible = 0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        bool inside = true;
+        for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+        {
+            const glm::vec4& plane = frustum.planes[p];
+            inside &= plane.x * x[i] + plane.y * y[i] + plane.z * z[i] + plane.w + radius[i] >= 0.0f;
+        }
+        out[visible] = i;
+        visible += inside ? 1 : 0;
+    }
+    return visible;
+}
+
+static unsigned int cullBoxesScalar(const Frustum& frustum, const float* x, const float* y, const float* z,
+                                    const float* ex, const float* ey, const float* ez, unsigned int count, unsigned int* out)
+{
+    unsigned int visible = 0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        bool inside = true;
+        for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+        {
+            const glm::vec4& plane = frustum.planes[p];
+            float radius = std::fabs(plane.x) * ex[i] + std::fabs(plane.y) * ey[i] + std::fabs(plane.z) * ez[i];
+            inside &= plane.x * x[i] + plane.y * y[i] + plane.z * z[i] + plane.w + radius >= 0.0f;
+        }
+        out[visible] = i;
+        visible += inside ? 1 : 0;
+    }
+    return visible;
+}
+
+#ifdef CULLING_X86
+static unsigned int cullSpheresSSE(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+                                   unsigned int count, unsigned int* out)
+{
+    __m128 planes[FRUSTUM_PLANE_COUNT][4];
+    for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+        for (int c = 0; c < 4; c++)
+            planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+
+    unsigned int visible = 0;
+    for (unsigned int i = 0; i < count; i += 4)
+    {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 pz = _mm_loadu_ps(z + i);
+        __m128 r = _mm_loadu_ps(radius + i);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], px), _mm_mul_ps(planes[p][1], py)),
+                                         _mm_add_ps(_mm_mul_ps(planes[p][2], pz), _mm_add_ps(planes[p][3], r)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+        }
+        visible += appendVisible(out + visible, i, (unsigned int)_mm_movemask_ps(inside), 4);
+    }
+    return visible;
+}
+
+static unsigned int cullBoxesSSE(const Frustum& frustum, const float* x, const float* y, const float* z,
+                                 const float* ex, const float* ey, const float* ez, unsigned int count, unsigned int* out)
+{
+    __m128 planes[FRUSTUM_PLANE_COUNT][4];
+    __m128 absPlanes[FRUSTUM_PLANE_COUNT][3];
+    for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+    {
+        for (int c = 0; c < 4; c++)
+            planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+        for (int c = 0; c < 3; c++)
+            absPlanes[p][c] = _mm_set1_ps(std::fabs(frustum.planes[p][c]));
+    }
+
+    unsigned int visible = 0;
+    for (unsigned int i = 0; i < count; i += 4)
+    {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 pz = _mm_loadu_ps(z + i);
+        __m128 qx = _mm_loadu_ps(ex + i);
+        __m128 qy = _mm_loadu_ps(ey + i);
+        __m128 qz = _mm_loadu_ps(ez + i);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+        {
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absPlanes[p][0], qx), _mm_mul_ps(absPlanes[p][1], qy)), _mm_mul_ps(absPlanes[p][2], qz));
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], px), _mm_mul_ps(planes[p][1], py)),
+                                         _mm_add_ps(_mm_mul_ps(planes[p][2], pz), _mm_add_ps(planes[p][3], radius)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+        }
+        visible += appendVisible(out + visible, i, (unsigned int)_mm_movemask_ps(inside), 4);
+    }
+    return visible;
+}
+
+CULLING_TARGET_AVX
+static unsigned int cullSpheresAVX(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+                                   unsigned int count, unsigned int* out)
+{
+    __m256 planes[FRUSTUM_PLANE_COUNT][4];
+    for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+        for (int c = 0; c < 4; c++)
+            planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+
+    unsigned int visible = 0;
+    for (unsigned int i = 0; i < count; i += 8)
+    {
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        __m256 pz = _mm256_loadu_ps(z + i);
+        __m256 r = _mm256_loadu_ps(radius + i);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+        {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[p][0], px), _mm256_mul_ps(planes[p][1], py)),
+                                            _mm256_add_ps(_mm256_mul_ps(planes[p][2], pz), _mm256_add_ps(planes[p][3], r)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        visible += appendVisible(out + visible, i, (unsigned int)_mm256_movemask_ps(inside), 8);
+    }
+    return visible;
+}
+
+CULLING_TARGET_AVX
+static unsigned int cullBoxesAVX(const Frustum& frustum, const float* x, const float* y, const float* z,
+                                 const float* ex, const float* ey, const float* ez, unsigned int count, unsigned int* out)
+{
+    __m256 planes[FRUSTUM_PLANE_COUNT][4];
+    __m256 absPlanes[FRUSTUM_PLANE_COUNT][3];
+    for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+    {
+        for (int c = 0; c < 4; c++)
+            planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+        for (int c = 0; c < 3; c++)
+            absPlanes[p][c] = _mm256_set1_ps(std::fabs(frustum.planes[p][c]));
+    }
+
+    unsigned int visible = 0;
+    for (unsigned int i = 0; i < count; i += 8)
+    {
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        __m256 pz = _mm256_loadu_ps(z + i);
+        __m256 qx = _mm256_loadu_ps(ex + i);
+        __m256 qy = _mm256_loadu_ps(ey + i);
+        __m256 qz = _mm256_loadu_ps(ez + i);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+        {
+            __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absPlanes[p][0], qx), _mm256_mul_ps(absPlanes[p][1], qy)),
+                                          _mm256_mul_ps(absPlanes[p][2], qz));
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[p][0], px), _mm256_mul_ps(planes[p][1], py)),
+                                            _mm256_add_ps(_mm256_mul_ps(planes[p][2], pz), _mm256_add_ps(planes[p][3], radius)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        visible += appendVisible(out + visible, i, (unsigned int)_mm256_movemask_ps(inside), 8);
+    }
+    return visible;
+}
+#endif
+
+// ------------------------------------------------------------------------
+// entry points
+// ------------------------------------------------------------------------
+
+unsigned int cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<unsigned int>& visible, CullingPath path)
+// test every object against the frustum, returns the visible count N and writes their indices to visible[0 .. N-1]
+{
+    // room for a whole batch past the last visible object, the append writes before it counts.
+    // Never shrunk, so that resizing does not clear the whole array every frame
+    if (visible.size() < spheres.m_X.size() + CULLING_BATCH)
+        visible.resize(spheres.m_X.size() + CULLING_BATCH);
+    unsigned int count = 0;
+    switch (resolvePath(path))
+    {
+#ifdef CULLING_X86
+    case CULLING_AVX:
+        count = cullSpheresAVX(frustum, spheres.m_X.data(), spheres.m_Y.data(), spheres.m_Z.data(), spheres.m_Radius.data(),
+                               (unsigned int)spheres.m_X.size(), visible.data());
+        break;
+    case CULLING_SSE:
+        count = cullSpheresSSE(frustum, spheres.m_X.data(), spheres.m_Y.data(), spheres.m_Z.data(), spheres.m_Radius.data(),
+                               (unsigned int)spheres.m_X.size(), visible.data());
+        break;
+#endif
+    default:
+        count = cullSpheresScalar(frustum, spheres.m_X.data(), spheres.m_Y.data(), spheres.m_Z.data(), spheres.m_Radius.data(),
+                                  spheres.m_Count, visible.data());
+        break;
+    }
+    return count;
+}
+
+unsigned int cullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, std::vector<unsigned int>& visible, CullingPath path)
+// test every object against the frustum, returns the visible count N and writes their indices to visible[0 .. N-1]
+{
+    if (visible.size() < boxes.m_X.size() + CULLING_BATCH)
+        visible.resize(boxes.m_X.size() + CULLING_BATCH);
+    unsigned int count = 0;
+    switch (resolvePath(path))
+    {
+#ifdef CULLING_X86
+    case CULLING_AVX:
+        count = cullBoxesAVX(frustum, boxes.m_X.data(), boxes.m_Y.data(), boxes.m_Z.data(),
+                             boxes.m_ExtentX.data(), boxes.m_ExtentY.data(), boxes.m_ExtentZ.data(), (unsigned int)boxes.m_X.size(), visible.data());
+        break;
+    case CULLING_SSE:
+        count = cullBoxesSSE(frustum, boxes.m_X.data(), boxes.m_Y.data(), boxes.m_Z.data(),
+                             boxes.m_ExtentX.data(), boxes.m_ExtentY.data(), boxes.m_ExtentZ.data(), (unsigned int)boxes.m_X.size(), visible.data());
+        break;
+#endif
+    default:
+        count = cullBoxesScalar(frustum, boxes.m_X.data(), boxes.m_Y.data(), boxes.m_Z.data(),
+                                boxes.m_ExtentX.data(), boxes.m_ExtentY.data(), boxes.m_ExtentZ.data(), boxes.m_Count, visible.data());
+        break;
+    }
+    return count;
+}
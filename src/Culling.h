@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Frustum.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Batches are padded to a multiple of CULLING_BATCH with objects that are never visible, so the SIMD loops need no tail
+const unsigned int CULLING_BATCH = 8;
+
+// instruction sets the culling loops are written for, CULLING_BEST picks the fastest one the CPU supports
+enum CullingPath { CULLING_SCALAR, CULLING_SSE, CULLING_AVX, CULLING_BEST };
+
+// Bounding spheres in structure-of-arrays layout: one array per component, so one SIMD load reads 4 (SSE) or 8 (AVX) objects
+class BoundingSpheres
+{
+private:
+    friend unsigned int cullSpheres(const Frustum&, const BoundingSpheres&, std::vector<unsigned int>&, CullingPath);
+    std::vector<float> m_X;
+    std::vector<float> m_Y;
+    std::vector<float> m_Z;
+    std::vector<float> m_Radius;
+    unsigned int m_Count;
+
+public:
+    BoundingSpheres() : m_Count(0) {}
+
+    void resize(unsigned int count);
+    void set(unsigned int index, const glm::vec3& center, float radius);
+    unsigned int size() const { return m_Count; }
+};
+
+// Axis-aligned bounding boxes in structure-of-arrays layout, stored as center and half extent
+class BoundingBoxes
+{
+private:
+    friend unsigned int cullBoxes(const Frustum&, const BoundingBoxes&, std::vector<unsigned int>&, CullingPath);
+    std::vector<float> m_X;
+    std::vector<float> m_Y;
+    std::vector<float> m_Z;
+    std::vector<float> m_ExtentX;
+    std::vector<float> m_ExtentY;
+    std::vector<float> m_ExtentZ;
+    unsigned int m_Count;
+
+public:
+    BoundingBoxes() : m_Count(0) {}
+
+    void resize(unsigned int count);
+    void set(unsigned int index, const glm::vec3& min, const glm::vec3& max);
+    unsigned int size() const { return m_Count; }
+};
+
+// test every object against the frustum, returns the visible count N and writes their indices to visible[0 .. N-1] in order.
+// visible is grown as needed and never shrunk (it is used as scratch space past N), only the first N entries are meaningful.
+unsigned int cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<unsigned int>& visible, CullingPath path = CULLING_BEST);
+unsigned int cullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, std::vector<unsigned int>& visible, CullingPath path = CULLING_BEST);
+
+// true if path can run on this CPU (CULLING_SCALAR and CULLING_BEST always can)
+bool isCullingPathSupported(CullingPath path);
+const char* getCullingPathName(CullingPath path);
@@ -0,0 +1,82 @@
+#include "FileUtils.h"
+
+#include <cstdio>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#include <sys/stat.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+
+uint64_t hashBytes(const void* data, std::size_t size, uint64_t seed)
+// 64-bit FNV-1a of size bytes, pass the previous result as seed to hash several pieces
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = seed;
+    for (std::size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool createDirectories(const std::string& path)
+// mkdir -p, true if path is a directory afterwards
+{
+    for (std::size_t i = 1; i <= path.size(); i++)
+    {
+        if (i < path.size() && path[i] != '/' && path[i] != '\\')
+            continue;
+        std::string parent = path.substr(0, i);
+#ifdef _WIN32
+        _mkdir(parent.c_str());
+#else
+        mkdir(parent.c_str(), 0755);
+#endif
+    }
+#ifdef _WIN32
+    struct _stat info;
+    return _stat(path.c_str(), &info) == 0 && (info.st_mode & _S_IFDIR);
+#else
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+bool writeFileAtomic(const std::string& path, const void* data, std::size_t size)
+// write to a temporary file next to path, then rename it over path
+{
+    // unique per process and per call, several threads may write the same path at once
+    static std::atomic<unsigned int> counter(0);
+#ifdef _WIN32
+    int process = _getpid();
+#else
+    int process = (int)getpid();
+#endif
+    char suffix[48];
+    snprintf(suffix, sizeof(suffix), ".%d.%u.tmp", process, counter++);
+    std::string temporaryPath = path + suffix;
+
+    FILE* file = fopen(temporaryPath.c_str(), "wb");
+    if (!file)
+        return false;
+    bool written = fwrite(data, 1, size, file) == size;
+    written = fclose(file) == 0 && written;
+#ifdef _WIN32
+    // rename does not replace an existing file on Windows
+    if (written)
+        remove(path.c_str());
+#endif
+    if (!written || rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64-bit FNV-1a of size bytes, pass the previous result as seed to hash several pieces
+uint64_t hashBytes(const void* data, std::size_t size, uint64_t seed = 14695981039346656037ull);
+inline uint64_t hashString(const std::string& text, uint64_t seed = 14695981039346656037ull) { return hashBytes(text.data(), text.size(), seed); }
+
+// mkdir -p, true if path is a directory afterwards
+bool createDirectories(const std::string& path);
+
+// write to a temporary file next to path, then rename it over path,
+// so a crash or another running instance never sees a half written file
+bool writeFileAtomic(const std::string& path, const void* data, std::size_t size);
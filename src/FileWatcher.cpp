@@ -0,0 +1,143 @@
+#include "FileWatcher.h"
+
+#include <chrono>
+#include <iostream>
+#include <map>
+
+#include <sys/stat.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// how long the watcher thread sleeps between checks for m_Stopping (and between polls without inotify)
+static const int WATCH_INTERVAL_MS = 200;
+
+static long long modificationTime(const std::string& path)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return -1;
+    return (long long)info.st_mtime;
+}
+
+FileWatcher::FileWatcher()
+// constructor starts the watcher thread
+    : m_Stopping(false), m_FilesChanged(false)
+{
+    m_Thread = std::thread(&FileWatcher::threadLoop, this);
+}
+
+FileWatcher::~FileWatcher()
+// Destructor stops the watcher thread
+{
+    m_Stopping = true;
+    m_Thread.join();
+}
+
+void FileWatcher::watch(const std::string& path)
+// start watching path; its directory is watched, so files that editors replace by renaming are seen as well
+{
+    WatchedFile file;
+    file.path = path;
+    std::size_t slash = path.find_last_of("/\\");
+    file.directory = slash == std::string::npos ? "." : path.substr(0, slash);
+    file.name = slash == std::string::npos ? path : path.substr(slash + 1);
+    file.modified = modificationTime(path);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Files.push_back(file);
+    m_FilesChanged = true;
+}
+
+bool FileWatcher::poll(std::vector<std::string>& changed)
+// move the paths changed since the last call into changed, false if there were none
+{
+    changed.clear();
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Changed.empty())
+        return false;
+    changed.assign(m_Changed.begin(), m_Changed.end());
+    m_Changed.clear();
+    return true;
+}
+
+void FileWatcher::markChanged(const std::string& directory, const std::string& name)
+// watcher thread: record a change of directory/name if it is a watched file, m_Mutex must be held
+{
+    for (const WatchedFile& file : m_Files)
+        if (file.directory == directory && file.name == name)
+            m_Changed.insert(file.path);
+}
+
+#ifdef __linux__
+void FileWatcher::threadLoop()
+// watcher thread: one inotify watch per directory, events are matched against the watched file names
+{
+    int inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify < 0)
+    {
+        std::cout << "ERROR::FILE_WATCHER::INOTIFY_INIT_FAILED" << std::endl;
+        return;
+    }
+
+    std::map<int, std::string> directories; // watch descriptor -> directory
+    alignas(struct inotify_event) char buffer[4096];
+    while (!m_Stopping)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_FilesChanged)
+            {
+                // inotify_add_watch returns the existing descriptor for a directory that is already watched
+                for (const WatchedFile& file : m_Files)
+                {
+                    int descriptor = inotify_add_watch(inotify, file.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+                    if (descriptor >= 0)
+                        directories[descriptor] = file.directory;
+                }
+                m_FilesChanged = false;
+            }
+        }
+
+        struct pollfd descriptor = { inotify, POLLIN, 0 };
+        if (::poll(&descriptor, 1, WATCH_INTERVAL_MS) <= 0)
+            continue;
+
+        ssize_t length;
+        while ((length = read(inotify, buffer, sizeof(buffer))) > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            for (char* at = buffer; at < buffer + length; )
+            {
+                const struct inotify_event* event = (const struct inotify_event*)at;
+                std::map<int, std::string>::const_iterator directory = directories.find(event->wd);
+                if (event->len > 0 && directory != directories.end())
+                    markChanged(directory->second, event->name);
+                at += sizeof(struct inotify_event) + event->len;
+            }
+        }
+    }
+    close(inotify);
+}
+#else
+void FileWatcher::threadLoop()
+// watcher thread: compare modification times every WATCH_INTERVAL_MS
+{
+    while (!m_Stopping)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_INTERVAL_MS));
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (WatchedFile& file : m_Files)
+        {
+            long long modified = modificationTime(file.path);
+            if (modified != file.modified)
+            {
+                file.modified = modified;
+                markChanged(file.directory, file.name);
+            }
+        }
+    }
+}
+#endif
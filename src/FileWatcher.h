@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches files for changes on a background thread: inotify on Linux, modification time polling elsewhere.
+// The render thread collects the changed paths once per frame with poll(), which never blocks on the file system.
+class FileWatcher
+{
+private:
+    struct WatchedFile
+    {
+        std::string path;       // as passed to watch(), reported back as is
+        std::string directory;
+        std::string name;
+        long long modified;     // polling fallback only
+    };
+
+    std::thread m_Thread;
+    std::atomic<bool> m_Stopping;
+
+    // guarded by m_Mutex
+    std::mutex m_Mutex;
+    std::vector<WatchedFile> m_Files;
+    std::set<std::string> m_Changed;
+    bool m_FilesChanged;        // the watcher thread has to pick up new directories
+
+    void threadLoop();
+    void markChanged(const std::string& directory, const std::string& name);
+
+public:
+    // constructor starts the watcher thread
+    FileWatcher();
+    // Destructor stops the watcher thread
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // start watching path; its directory is watched, so files that editors replace by renaming are seen as well
+    void watch(const std::string& path);
+    // move the paths changed since the last call into changed, false if there were none
+    bool poll(std::vector<std::string>& changed);
+};
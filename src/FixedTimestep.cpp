@@ -0,0 +1,25 @@
+#include "FixedTimestep.h"
+
+#include <cmath>
+
+FixedTimestep::FixedTimestep(double hz)
+    : m_Step(1.0 / (hz > 0.0 ? hz : SIMULATION_HZ)), m_Accumulator(0.0), m_Tick(0)
+{
+}
+
+unsigned int FixedTimestep::advance(double frameTime)
+// number of ticks to run for frameTime seconds of real time
+{
+    m_Accumulator += frameTime > 0.0 ? frameTime : 0.0;
+    unsigned int steps = 0;
+    while (m_Accumulator >= m_Step && steps < SIMULATION_MAX_STEPS)
+    {
+        m_Accumulator -= m_Step;
+        steps++;
+    }
+    // too far behind to catch up: drop the backlog instead of running ever more ticks per frame
+    if (m_Accumulator >= m_Step)
+        m_Accumulator = fmod(m_Accumulator, m_Step);
+    m_Tick += steps;
+    return steps;
+}
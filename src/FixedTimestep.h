@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+const double SIMULATION_HZ = 60.0;              // default simulation ticks per second, --tick-rate HZ to change it
+const unsigned int SIMULATION_MAX_STEPS = 8;    // ticks run per frame at most, a slower frame slows the simulation down
+
+// Fixed-rate simulation clock. Every frame advance() is handed the real time elapsed and returns how many ticks of
+// getStep() seconds to run; the remainder is carried over to the next frame. The simulation keeps its previous and
+// current tick's state and renders them blended by getAlpha(), so it looks smooth whether frames are drawn faster or
+// slower than it ticks, and its cost only depends on the tick rate.
+class FixedTimestep
+{
+private:
+    double m_Step;
+    double m_Accumulator;   // real time not simulated yet, less than a step after advance()
+    uint64_t m_Tick;        // ticks run since startup
+
+public:
+    FixedTimestep(double hz = SIMULATION_HZ);
+
+    // number of ticks to run for frameTime seconds of real time
+    unsigned int advance(double frameTime);
+
+    double getStep() const { return m_Step; }
+    uint64_t getTick() const { return m_Tick; }
+    // simulated time at the current tick
+    double getTime() const { return m_Tick * m_Step; }
+    // how far real time is between the current tick and the next one, 0 to 1: the blend from previous to current state
+    float getAlpha() const { return (float)(m_Accumulator / m_Step); }
+    // simulated time matching getAlpha(), between the previous tick and the current one
+    double getInterpolatedTime() const { return m_Tick > 0 ? getTime() - m_Step + m_Accumulator : 0.0; }
+};
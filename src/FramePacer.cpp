@@ -0,0 +1,58 @@
+#include "FramePacer.h"
+
+FramePacer::FramePacer()
+    : m_OnDemand(false), m_Dirty(true), m_Animating(false), m_Minimized(false), m_Focused(true), m_LastFrame(-1.0), m_IdleTime(0.0),
+      m_Wakeups(0)
+{
+}
+
+void FramePacer::setMinimized(bool minimized)
+// from the iconify callback, nothing is drawn while minimized
+{
+    m_Minimized = minimized;
+    if (!minimized)
+        m_Dirty = true;     // the window content may be gone
+}
+
+void FramePacer::setFocused(bool focused)
+// from the focus callback, the frame rate is capped while unfocused
+{
+    m_Focused = focused;
+    m_Dirty = true;
+}
+
+bool FramePacer::shouldDraw(double now) const
+// true if a frame should be drawn now
+{
+    if (m_Minimized)
+        return false;
+    if (m_OnDemand && !m_Dirty && !m_Animating)
+        return false;
+    return m_Focused || now - m_LastFrame >= 1.0 / PACER_UNFOCUSED_FPS;
+}
+
+double FramePacer::getWaitTimeout(double now) const
+// seconds to wait for events before the next frame is due, 0 to only poll them
+{
+    if (m_Minimized || (m_OnDemand && !m_Dirty && !m_Animating))
+        return PACER_IDLE_TIMEOUT;
+    if (m_Focused)
+        return 0.0;
+    double next = m_LastFrame + 1.0 / PACER_UNFOCUSED_FPS - now;
+    return next > 0.0 ? next : 0.0;
+}
+
+void FramePacer::waited(double seconds, bool drawn)
+// account time spent waiting for events, drawn tells whether a frame followed
+{
+    m_IdleTime += seconds;
+    if (!drawn)
+        m_Wakeups++;
+}
+
+void FramePacer::frameDrawn(double now)
+// call after drawing a frame
+{
+    m_LastFrame = now;
+    m_Dirty = false;
+}
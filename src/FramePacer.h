@@ -0,0 +1,50 @@
+#pragma once
+
+const double PACER_IDLE_TIMEOUT = 0.25;     // seconds between wake-ups while idle, to watch files and stream textures
+const double PACER_UNFOCUSED_FPS = 10.0;    // frame rate cap while the window does not have the focus
+const float PACER_MAX_FRAME_DELTA = 0.1f;   // longest deltaTime handed to the simulation, e.g. after an idle pause
+
+// Decides when a windowed frame is drawn. In render-on-demand mode a frame is only drawn when something changed
+// (invalidate(): input, resize, a reloaded shader...) or while something keeps changing (setAnimating()); otherwise
+// the loop sleeps in glfwWaitEventsTimeout(getWaitTimeout()). In every mode nothing is drawn while the window is
+// minimized, and the frame rate is capped at PACER_UNFOCUSED_FPS while it is in the background.
+class FramePacer
+{
+private:
+    bool m_OnDemand;
+    bool m_Dirty;
+    bool m_Animating;
+    bool m_Minimized;
+    bool m_Focused;
+    double m_LastFrame;     // time the last frame was drawn
+    double m_IdleTime;      // seconds spent waiting for events
+    unsigned int m_Wakeups; // waits that did not lead to a frame
+
+public:
+    FramePacer();
+
+    // false (default): draw continuously, only throttled when minimized or unfocused
+    void setOnDemand(bool onDemand) { m_OnDemand = onDemand; }
+    bool isOnDemand() const { return m_OnDemand; }
+
+    // something visible changed, draw the next frame
+    void invalidate() { m_Dirty = true; }
+    // draw every frame while true (animations, textures streaming in)
+    void setAnimating(bool animating) { m_Animating = animating; }
+    // from the iconify callback, nothing is drawn while minimized
+    void setMinimized(bool minimized);
+    // from the focus callback, the frame rate is capped while unfocused
+    void setFocused(bool focused);
+
+    // true if a frame should be drawn now
+    bool shouldDraw(double now) const;
+    // seconds to wait for events before the next frame is due, 0 to only poll them
+    double getWaitTimeout(double now) const;
+    // account time spent waiting for events, drawn tells whether a frame followed
+    void waited(double seconds, bool drawn);
+    // call after drawing a frame
+    void frameDrawn(double now);
+
+    double getIdleTime() const { return m_IdleTime; }
+    unsigned int getWakeups() const { return m_Wakeups; }
+};
@@ -0,0 +1,24 @@
+#include "FrameUniforms.h"
+#include "GLStateCache.h"
+#include "StreamBuffer.h"
+
+#include <cstring>
+
+FrameUniforms::FrameUniforms()
+// needs StreamBuffer::Get() initialized
+    : m_Alignment(0)
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_Alignment = alignment > 0 ? alignment : 256;
+}
+
+void FrameUniforms::update(const FrameUniformsData& data)
+// write this frame's data to the stream buffer and bind that range, the GPU keeps reading older frames' copies
+{
+    StreamBuffer& streamBuffer = StreamBuffer::Get();
+    StreamAllocation allocation = streamBuffer.allocate(sizeof(FrameUniformsData), m_Alignment);
+    memcpy(allocation.data, &data, sizeof(FrameUniformsData));
+    streamBuffer.flush();
+    GLStateCache::Get().bindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, allocation.buffer, allocation.offset, sizeof(FrameUniformsData));
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// binding point of the FrameUniforms block, every Shader binds its block here after linking
+const unsigned int FRAME_UNIFORMS_BINDING = 0;
+
+// Per-frame data shared by all shader programs. std140 layout, must match the FrameUniforms block in the shaders:
+//
+//  layout (std140) uniform FrameUniforms
+//  {
+//      mat4 view;
+//      mat4 projection;
+//      mat4 viewProj;
+//      vec3 cameraPosition;
+//      float time;
+//  };
+struct FrameUniformsData
+{
+    glm::mat4 view;             // world to camera
+    glm::mat4 projection;       // camera to screen
+    glm::mat4 viewProj;         // projection * view
+    glm::vec3 cameraPosition;   // std140 packs the float below into the 4th component of this vec3
+    float time;                 // seconds since startup
+};
+static_assert(sizeof(FrameUniformsData) == 3 * 64 + 16, "FrameUniformsData must match the std140 layout");
+
+// FrameUniformsData written once per frame into the StreamBuffer and bound at FRAME_UNIFORMS_BINDING,
+// so switching shader programs needs no uniform calls for the camera
+class FrameUniforms
+{
+private:
+    GLintptr m_Alignment;   // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+
+public:
+    // needs StreamBuffer::Get() initialized
+    FrameUniforms();
+
+    FrameUniforms(const FrameUniforms&) = delete;
+    FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+    // write this frame's data to the stream buffer and bind that range, the GPU keeps reading older frames' copies
+    void update(const FrameUniformsData& data);
+};
@@ -0,0 +1,44 @@
+#include "Frustum.h"
+
+Frustum Frustum::fromMatrix(const glm::mat4& viewProjection)
+// extract the planes from a view * projection matrix (Gribb/Hartmann), OpenGL clip space (-w <= z <= w)
+{
+    // glm is column major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+    Frustum frustum;
+    frustum.planes[FRUSTUM_LEFT] = rows[3] + rows[0];
+    frustum.planes[FRUSTUM_RIGHT] = rows[3] - rows[0];
+    frustum.planes[FRUSTUM_BOTTOM] = rows[3] + rows[1];
+    frustum.planes[FRUSTUM_TOP] = rows[3] - rows[1];
+    frustum.planes[FRUSTUM_NEAR] = rows[3] + rows[2];
+    frustum.planes[FRUSTUM_FAR] = rows[3] - rows[2];
+    for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+        frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+    return frustum;
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const
+{
+    for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+        if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+            return false;
+    return true;
+}
+
+bool Frustum::intersectsBox(const glm::vec3& min, const glm::vec3& max) const
+{
+    glm::vec3 center = (min + max) * 0.5f;
+    glm::vec3 extent = (max - min) * 0.5f;
+    for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+    {
+        glm::vec3 normal(planes[i]);
+        // projected radius of the box onto the plane normal
+        float radius = glm::dot(glm::abs(normal), extent);
+        if (glm::dot(normal, center) + planes[i].w < -radius)
+            return false;
+    }
+    return true;
+}
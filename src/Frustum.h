@@ -0,0 +1,19 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+enum FrustumPlane { FRUSTUM_LEFT, FRUSTUM_RIGHT, FRUSTUM_BOTTOM, FRUSTUM_TOP, FRUSTUM_NEAR, FRUSTUM_FAR, FRUSTUM_PLANE_COUNT };
+
+// View frustum as six world space planes (xyz = normal pointing inside, w = distance), normalized so that
+// dot(plane.xyz, p) + plane.w is the signed distance of p to the plane
+struct Frustum
+{
+    glm::vec4 planes[FRUSTUM_PLANE_COUNT];
+
+    // extract the planes from a view * projection matrix (Gribb/Hartmann), OpenGL clip space (-w <= z <= w)
+    static Frustum fromMatrix(const glm::mat4& viewProjection);
+
+    // reference tests, the batch versions are in Culling.h
+    bool intersectsSphere(const glm::vec3& center, float radius) const;
+    bool intersectsBox(const glm::vec3& min, const glm::vec3& max) const;
+};
@@ -0,0 +1,231 @@
+#include "GLStateCache.h"
+#include "Profiler.h"
+
+GLStateCache::GLStateCache()
+    : m_Issued(0), m_Elided(0), m_IssuedCounter(-1), m_ElidedCounter(-1)
+{
+    invalidate();
+}
+
+GLStateCache& GLStateCache::Get()
+{
+    static GLStateCache instance;
+    return instance;
+}
+
+void GLStateCache::invalidate()
+// forget everything, the next call of every kind is issued
+{
+    m_Program = UNKNOWN;
+    m_VertexArray = UNKNOWN;
+    for (unsigned int i = 0; i < BUF_TARGET_COUNT; i++)
+        m_Buffers[i] = UNKNOWN;
+    m_ActiveUnit = UNKNOWN;
+    for (unsigned int unit = 0; unit < STATE_CACHE_TEXTURE_UNITS; unit++)
+        for (unsigned int i = 0; i < TEX_TARGET_COUNT; i++)
+            m_Textures[unit][i] = UNKNOWN;
+    for (unsigned int i = 0; i < CAP_COUNT; i++)
+        m_Capabilities[i] = -1;
+}
+
+void GLStateCache::useProgram(unsigned int program)
+{
+    if (m_Program == program)
+    {
+        m_Elided++;
+        return;
+    }
+    glUseProgram(program);
+    m_Program = program;
+    m_Issued++;
+}
+
+void GLStateCache::bindVertexArray(unsigned int vao)
+{
+    if (m_VertexArray == vao)
+    {
+        m_Elided++;
+        return;
+    }
+    glBindVertexArray(vao);
+    m_VertexArray = vao;
+    // the element array buffer binding is part of the VAO
+    m_Buffers[BUF_ELEMENT_ARRAY] = UNKNOWN;
+    m_Issued++;
+}
+
+void GLStateCache::bindBuffer(GLenum target, unsigned int buffer)
+{
+    int index = bufferTargetIndex(target);
+    if (index >= 0 && m_Buffers[index] == buffer)
+    {
+        m_Elided++;
+        return;
+    }
+    glBindBuffer(target, buffer);
+    if (index >= 0)
+        m_Buffers[index] = buffer;
+    m_Issued++;
+}
+
+void GLStateCache::bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size)
+// indexed binding (uniform/shader storage blocks), always issued; it also binds the generic target, which is tracked
+{
+    glBindBufferRange(target, index, buffer, offset, size);
+    int targetIndex = bufferTargetIndex(target);
+    if (targetIndex >= 0)
+        m_Buffers[targetIndex] = buffer;
+    m_Issued++;
+}
+
+void GLStateCache::bindTexture(unsigned int unit, GLenum target, unsigned int texture)
+// binds texture on unit, glActiveTexture is only issued when a bind is actually needed
+{
+    int index = textureTargetIndex(target);
+    bool tracked = index >= 0 && unit < STATE_CACHE_TEXTURE_UNITS;
+    if (tracked && m_Textures[unit][index] == texture)
+    {
+        m_Elided++;
+        return;
+    }
+    if (m_ActiveUnit != unit)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        m_ActiveUnit = unit;
+        m_Issued++;
+    }
+    glBindTexture(target, texture);
+    if (tracked)
+        m_Textures[unit][index] = texture;
+    m_Issued++;
+}
+
+void GLStateCache::enable(GLenum cap)
+{
+    int index = capabilityIndex(cap);
+    if (index >= 0 && m_Capabilities[index] == 1)
+    {
+        m_Elided++;
+        return;
+    }
+    glEnable(cap);
+    if (index >= 0)
+        m_Capabilities[index] = 1;
+    m_Issued++;
+}
+
+void GLStateCache::disable(GLenum cap)
+{
+    int index = capabilityIndex(cap);
+    if (index >= 0 && m_Capabilities[index] == 0)
+    {
+        m_Elided++;
+        return;
+    }
+    glDisable(cap);
+    if (index >= 0)
+        m_Capabilities[index] = 0;
+    m_Issued++;
+}
+
+void GLStateCache::forgetProgram(unsigned int program)
+{
+    if (m_Program == program)
+        m_Program = UNKNOWN;
+}
+
+void GLStateCache::forgetVertexArray(unsigned int vao)
+{
+    if (m_VertexArray == vao)
+    {
+        m_VertexArray = UNKNOWN;
+        m_Buffers[BUF_ELEMENT_ARRAY] = UNKNOWN;
+    }
+}
+
+void GLStateCache::forgetBuffer(unsigned int buffer)
+{
+    for (unsigned int i = 0; i < BUF_TARGET_COUNT; i++)
+        if (m_Buffers[i] == buffer)
+            m_Buffers[i] = UNKNOWN;
+}
+
+void GLStateCache::forgetTexture(unsigned int texture)
+{
+    for (unsigned int unit = 0; unit < STATE_CACHE_TEXTURE_UNITS; unit++)
+        for (unsigned int i = 0; i < TEX_TARGET_COUNT; i++)
+            if (m_Textures[unit][i] == texture)
+                m_Textures[unit][i] = UNKNOWN;
+}
+
+uint64_t GLStateCache::getIssued() const
+{
+    return m_Issued;
+}
+
+uint64_t GLStateCache::getElided() const
+{
+    return m_Elided;
+}
+
+void GLStateCache::endFrame()
+// report this frame's issued/elided calls to the profiler and reset them
+{
+    Profiler& profiler = Profiler::Get();
+    if (m_IssuedCounter < 0)
+    {
+        m_IssuedCounter = profiler.registerCounter("state_calls_issued");
+        m_ElidedCounter = profiler.registerCounter("state_calls_elided");
+    }
+    profiler.setCounter(m_IssuedCounter, (double)m_Issued);
+    profiler.setCounter(m_ElidedCounter, (double)m_Elided);
+    m_Issued = 0;
+    m_Elided = 0;
+}
+
+int GLStateCache::textureTargetIndex(GLenum target)
+{
+    switch (target)
+    {
+    case GL_TEXTURE_2D: return TEX_2D;
+    case GL_TEXTURE_3D: return TEX_3D;
+    case GL_TEXTURE_CUBE_MAP: return TEX_CUBE_MAP;
+    case GL_TEXTURE_2D_ARRAY: return TEX_2D_ARRAY;
+    case GL_TEXTURE_BUFFER: return TEX_BUFFER;
+    default: return -1;
+    }
+}
+
+int GLStateCache::bufferTargetIndex(GLenum target)
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER: return BUF_ARRAY;
+    case GL_ELEMENT_ARRAY_BUFFER: return BUF_ELEMENT_ARRAY;
+    case GL_UNIFORM_BUFFER: return BUF_UNIFORM;
+    case GL_SHADER_STORAGE_BUFFER: return BUF_SHADER_STORAGE;
+    case GL_DRAW_INDIRECT_BUFFER: return BUF_DRAW_INDIRECT;
+    case GL_PIXEL_UNPACK_BUFFER: return BUF_PIXEL_UNPACK;
+    case GL_PIXEL_PACK_BUFFER: return BUF_PIXEL_PACK;
+    case GL_COPY_READ_BUFFER: return BUF_COPY_READ;
+    case GL_COPY_WRITE_BUFFER: return BUF_COPY_WRITE;
+    case GL_PARAMETER_BUFFER: return BUF_PARAMETER;
+    default: return -1;
+    }
+}
+
+int GLStateCache::capabilityIndex(GLenum cap)
+{
+    switch (cap)
+    {
+    case GL_DEPTH_TEST: return CAP_DEPTH_TEST;
+    case GL_BLEND: return CAP_BLEND;
+    case GL_CULL_FACE: return CAP_CULL_FACE;
+    case GL_SCISSOR_TEST: return CAP_SCISSOR_TEST;
+    case GL_STENCIL_TEST: return CAP_STENCIL_TEST;
+    case GL_PRIMITIVE_RESTART: return CAP_PRIMITIVE_RESTART;
+    case GL_FRAMEBUFFER_SRGB: return CAP_FRAMEBUFFER_SRGB;
+    case GL_MULTISAMPLE: return CAP_MULTISAMPLE;
+    default: return -1;
+    }
+}
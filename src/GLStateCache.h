@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+const unsigned int STATE_CACHE_TEXTURE_UNITS = 32;
+
+// Shadow copy of the OpenGL binding state: program, VAO, buffers, textures per unit and enable bits.
+// Calls that would not change anything are skipped, and both issued and skipped (elided) calls are counted.
+// Setup code may bind directly with gl* calls, but must call invalidate() before the cache is used again;
+// same for any code that changes bindings behind the cache's back (e.g. the ImGui backend).
+class GLStateCache
+{
+private:
+    // tracked texture targets, others are passed through
+    enum TextureTarget { TEX_2D, TEX_3D, TEX_CUBE_MAP, TEX_2D_ARRAY, TEX_BUFFER, TEX_TARGET_COUNT };
+    // tracked buffer targets, others are passed through
+    enum BufferTarget { BUF_ARRAY, BUF_ELEMENT_ARRAY, BUF_UNIFORM, BUF_SHADER_STORAGE, BUF_DRAW_INDIRECT,
+        BUF_PIXEL_UNPACK, BUF_PIXEL_PACK, BUF_COPY_READ, BUF_COPY_WRITE, BUF_PARAMETER, BUF_TARGET_COUNT };
+    // tracked capabilities for glEnable/glDisable, others are passed through
+    enum Capability { CAP_DEPTH_TEST, CAP_BLEND, CAP_CULL_FACE, CAP_SCISSOR_TEST, CAP_STENCIL_TEST,
+        CAP_PRIMITIVE_RESTART, CAP_FRAMEBUFFER_SRGB, CAP_MULTISAMPLE, CAP_COUNT };
+
+    static const unsigned int UNKNOWN = 0xFFFFFFFFu;   // binding not known, the next call is always issued
+
+    unsigned int m_Program;
+    unsigned int m_VertexArray;
+    unsigned int m_Buffers[BUF_TARGET_COUNT];
+    unsigned int m_ActiveUnit;
+    unsigned int m_Textures[STATE_CACHE_TEXTURE_UNITS][TEX_TARGET_COUNT];
+    int m_Capabilities[CAP_COUNT];  // -1 unknown, 0 disabled, 1 enabled
+
+    uint64_t m_Issued;  // calls forwarded to the driver since the last endFrame()
+    uint64_t m_Elided;  // redundant calls skipped since the last endFrame()
+    int m_IssuedCounter;
+    int m_ElidedCounter;
+
+    GLStateCache();
+    static int textureTargetIndex(GLenum target);
+    static int bufferTargetIndex(GLenum target);
+    static int capabilityIndex(GLenum cap);
+
+public:
+    static GLStateCache& Get();
+
+    GLStateCache(const GLStateCache&) = delete;
+    GLStateCache& operator=(const GLStateCache&) = delete;
+
+    // forget everything, the next call of every kind is issued
+    void invalidate();
+
+    void useProgram(unsigned int program);
+    void bindVertexArray(unsigned int vao);
+    void bindBuffer(GLenum target, unsigned int buffer);
+    // indexed binding (uniform/shader storage blocks), always issued; it also binds the generic target, which is tracked
+    void bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size);
+    // binds texture on unit, glActiveTexture is only issued when a bind is actually needed
+    void bindTexture(unsigned int unit, GLenum target, unsigned int texture);
+    void enable(GLenum cap);
+    void disable(GLenum cap);
+
+    // call after deleting an object so its (reusable) name is not considered bound anymore
+    void forgetProgram(unsigned int program);
+    void forgetVertexArray(unsigned int vao);
+    void forgetBuffer(unsigned int buffer);
+    void forgetTexture(unsigned int texture);
+
+    uint64_t getIssued() const;
+    uint64_t getElided() const;
+    // report this frame's issued/elided calls to the profiler and reset them
+    void endFrame();
+};
@@ -0,0 +1,243 @@
+#include "GpuDrivenRenderer.h"
+#include "GLStateCache.h"
+#include "InstancedRenderer.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static const char* CULL_SHADER_PATH = "res/shaders/cull.comp";
+
+static unsigned int buildComputeProgram(const char* path)
+// compile and link a compute shader from path, 0 and the log printed if that fails
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+        return 0;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    std::string code = stream.str();
+    const char* source = code.c_str();
+
+    unsigned int shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    int success = 0;
+    char infoLog[1024];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+        std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: COMPUTE\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDetachShader(program, shader);
+    glDeleteShader(shader);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glGetProgramInfoLog(program, 1024, NULL, infoLog);
+        std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: PROGRAM\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+bool GpuDrivenRenderer::isSupported()
+// true if the context can run this path
+{
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+GpuDrivenRenderer::GpuDrivenRenderer(unsigned int vao, unsigned int attribLocation)
+// constructor builds the culling program and points the per-instance object index attribute at attribLocation
+// to its own buffer. Construct it after the InstancedRenderer of the same VAO, whose draw() is not used anymore
+    : m_VAO(vao), m_AttribLocation(attribLocation), m_Program(0), m_ObjectBuffer(0), m_CommandBuffer(0), m_VisibleBuffer(0),
+      m_ObjectCount(0), m_VisibleCapacity(0), m_IndexType(GL_UNSIGNED_INT), m_ReadbackFrame(0), m_VisibleObjects(0), m_Triangles(0)
+{
+    m_Program = buildComputeProgram(CULL_SHADER_PATH);
+    if (m_Program)
+    {
+        m_FrustumPlanesLocation = glGetUniformLocation(m_Program, "frustumPlanes");
+        m_ObjectCountLocation = glGetUniformLocation(m_Program, "objectCount");
+        m_LodCountLocation = glGetUniformLocation(m_Program, "lodCount");
+        m_LodErrorsLocation = glGetUniformLocation(m_Program, "lodErrors");
+        m_CameraPositionLocation = glGetUniformLocation(m_Program, "cameraPosition");
+        m_PixelsPerUnitLocation = glGetUniformLocation(m_Program, "pixelsPerUnit");
+        m_PixelErrorLocation = glGetUniformLocation(m_Program, "pixelError");
+    }
+
+    glGenBuffers(1, &m_ObjectBuffer);
+    glGenBuffers(1, &m_CommandBuffer);
+    glGenBuffers(1, &m_VisibleBuffer);
+    glGenBuffers(GPU_READBACK_FRAMES, m_Readback);
+    for (unsigned int i = 0; i < GPU_READBACK_FRAMES; i++)
+        m_ReadbackFences[i] = 0;
+
+    // the storage bindings never change, nothing else uses these indices
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_OBJECTS_BINDING, m_ObjectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_COMMANDS_BINDING, m_CommandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_VISIBLE_BINDING, m_VisibleBuffer);
+
+    // same attribute as InstancedRenderer's, now sourced from the buffer the culling pass writes. Left alone
+    // without a program so that the InstancedRenderer keeps working
+    if (m_Program)
+    {
+        glBindVertexArray(m_VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_VisibleBuffer);
+        glVertexAttribIPointer(m_AttribLocation, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+        glEnableVertexAttribArray(m_AttribLocation);
+        glVertexAttribDivisor(m_AttribLocation, 1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    GLStateCache::Get().invalidate();
+}
+
+GpuDrivenRenderer::~GpuDrivenRenderer()
+{
+    GLStateCache& stateCache = GLStateCache::Get();
+    for (unsigned int i = 0; i < GPU_READBACK_FRAMES; i++)
+    {
+        if (m_ReadbackFences[i])
+            glDeleteSync(m_ReadbackFences[i]);
+        stateCache.forgetBuffer(m_Readback[i]);
+    }
+    glDeleteBuffers(GPU_READBACK_FRAMES, m_Readback);
+    stateCache.forgetBuffer(m_ObjectBuffer);
+    stateCache.forgetBuffer(m_CommandBuffer);
+    stateCache.forgetBuffer(m_VisibleBuffer);
+    glDeleteBuffers(1, &m_ObjectBuffer);
+    glDeleteBuffers(1, &m_CommandBuffer);
+    glDeleteBuffers(1, &m_VisibleBuffer);
+    if (m_Program)
+    {
+        stateCache.forgetProgram(m_Program);
+        glDeleteProgram(m_Program);
+    }
+}
+
+void GpuDrivenRenderer::setObjects(const glm::vec3* centers, unsigned int count, float radius)
+// bounding spheres of all objects, object i is drawn with model matrix i
+{
+    std::vector<glm::vec4> spheres(count);
+    for (unsigned int i = 0; i < count; i++)
+        spheres[i] = glm::vec4(centers[i], radius);
+    GLStateCache::Get().bindBuffer(GL_SHADER_STORAGE_BUFFER, m_ObjectBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, spheres.size() * sizeof(glm::vec4), spheres.data(), GL_STATIC_DRAW);
+    m_ObjectCount = count;
+    resizeVisible();
+}
+
+void GpuDrivenRenderer::setMesh(const std::vector<MeshLod>& lods, GLenum indexType)
+// levels of detail of the mesh in the VAO
+{
+    m_IndexType = indexType;
+    m_Commands.resize(lods.size());
+    m_LodErrors.resize(lods.size());
+    for (unsigned int level = 0; level < lods.size(); level++)
+    {
+        DrawElementsIndirectCommand& command = m_Commands[level];
+        command.count = lods[level].indexCount;
+        command.instanceCount = 0;
+        command.firstIndex = lods[level].firstIndex;
+        command.baseVertex = 0;
+        command.baseInstance = 0;   // set by resizeVisible()
+        m_LodErrors[level] = lods[level].error;
+    }
+    for (unsigned int i = 0; i < GPU_READBACK_FRAMES; i++)
+    {
+        GLStateCache::Get().bindBuffer(GL_COPY_WRITE_BUFFER, m_Readback[i]);
+        glBufferData(GL_COPY_WRITE_BUFFER, m_Commands.size() * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_READ);
+    }
+    resizeVisible();
+}
+
+void GpuDrivenRenderer::resizeVisible()
+// every level can hold all objects, so the culling pass needs no second pass to find where each level starts
+{
+    for (unsigned int level = 0; level < m_Commands.size(); level++)
+        m_Commands[level].baseInstance = level * m_ObjectCount;
+    unsigned int capacity = (unsigned int)m_Commands.size() * m_ObjectCount;
+    if (capacity > m_VisibleCapacity)
+    {
+        m_VisibleCapacity = capacity;
+        GLStateCache::Get().bindBuffer(GL_SHADER_STORAGE_BUFFER, m_VisibleBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)m_VisibleCapacity * sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+    }
+}
+
+void GpuDrivenRenderer::cull(const Frustum& frustum, const LodSelector& lods)
+// run the culling pass with the view and pixel error of lods. Leaves the culling program bound
+{
+    if (!m_Program || m_Commands.empty())
+        return;
+    GLStateCache& stateCache = GLStateCache::Get();
+    readBack();
+
+    // reset the instance counts; the previous frame's draw still reads the old commands, the driver keeps them apart
+    stateCache.bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_CommandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, m_Commands.size() * sizeof(DrawElementsIndirectCommand), m_Commands.data(), GL_DYNAMIC_DRAW);
+
+    stateCache.useProgram(m_Program);
+    glUniform4fv(m_FrustumPlanesLocation, FRUSTUM_PLANE_COUNT, &frustum.planes[0][0]);
+    glUniform1ui(m_ObjectCountLocation, m_ObjectCount);
+    glUniform1i(m_LodCountLocation, (int)m_LodErrors.size());
+    glUniform1fv(m_LodErrorsLocation, (GLsizei)m_LodErrors.size(), m_LodErrors.data());
+    glUniform3fv(m_CameraPositionLocation, 1, &lods.getCameraPosition()[0]);
+    glUniform1f(m_PixelsPerUnitLocation, lods.getPixelsPerUnit());
+    glUniform1f(m_PixelErrorLocation, lods.getPixelError());
+    glDispatchCompute((m_ObjectCount + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE, 1, 1);
+    // the draw reads the commands and the instance attribute the pass wrote
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void GpuDrivenRenderer::draw(unsigned int transformTexture)
+// draw everything that passed with the model matrices in transformTexture (InstancedRenderer::getTransformTexture()),
+// with the VAO and the drawing program bound
+{
+    if (!m_Program || m_Commands.empty())
+        return;
+    GLStateCache& stateCache = GLStateCache::Get();
+    stateCache.bindTexture(INSTANCE_TRANSFORM_UNIT, GL_TEXTURE_BUFFER, transformTexture);
+    stateCache.bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_CommandBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, m_IndexType, (void*)0, (GLsizei)m_Commands.size(), sizeof(DrawElementsIndirectCommand));
+
+    // keep a copy of the commands for the statistics, read once the GPU got there
+    unsigned int slot = m_ReadbackFrame % GPU_READBACK_FRAMES;
+    stateCache.bindBuffer(GL_COPY_READ_BUFFER, m_CommandBuffer);
+    stateCache.bindBuffer(GL_COPY_WRITE_BUFFER, m_Readback[slot]);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, m_Commands.size() * sizeof(DrawElementsIndirectCommand));
+    if (m_ReadbackFences[slot])
+        glDeleteSync(m_ReadbackFences[slot]);
+    m_ReadbackFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_ReadbackFrame++;
+}
+
+void GpuDrivenRenderer::readBack()
+// take the statistics from the oldest copy if its fence has signalled, without waiting
+{
+    unsigned int slot = m_ReadbackFrame % GPU_READBACK_FRAMES;     // the copy about to be overwritten
+    GLsync fence = m_ReadbackFences[slot];
+    if (!fence || glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        return;
+    std::vector<DrawElementsIndirectCommand> commands(m_Commands.size());
+    GLStateCache::Get().bindBuffer(GL_COPY_READ_BUFFER, m_Readback[slot]);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+    m_VisibleObjects = 0;
+    m_Triangles = 0;
+    for (const DrawElementsIndirectCommand& command : commands)
+    {
+        m_VisibleObjects += command.instanceCount;
+        m_Triangles += command.instanceCount * (command.count / 3);
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "LodSelector.h"
+#include "MeshLoader.h"
+
+#include <vector>
+
+const unsigned int GPU_CULL_GROUP_SIZE = 64;        // local_size_x of cull.comp
+const unsigned int GPU_OBJECTS_BINDING = 0;         // shader storage bindings of cull.comp
+const unsigned int GPU_COMMANDS_BINDING = 1;
+const unsigned int GPU_VISIBLE_BINDING = 2;
+const unsigned int GPU_READBACK_FRAMES = 3;         // draw commands are read back this many frames late, never stalling
+
+// record of glMultiDrawElementsIndirect, written by the culling shader
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// GPU driven variant of InstancedRenderer + LodSelector, needs OpenGL 4.3 (compute shaders, shader storage buffers,
+// multi draw indirect). The bounding spheres of all objects live in a shader storage buffer; every frame a compute
+// pass (res/shaders/cull.comp) culls them, picks their level of detail and appends them to one indirect draw command
+// per level, then a single glMultiDrawElementsIndirect draws everything. The CPU cost no longer depends on the
+// object count. The visible object indices feed the same per-instance attribute InstancedRenderer uses (through
+// each command's base instance), so the vertex shader and the model matrix buffer are shared with it.
+class GpuDrivenRenderer
+{
+private:
+    unsigned int m_VAO;
+    unsigned int m_AttribLocation;
+    unsigned int m_Program;
+    unsigned int m_ObjectBuffer;    // vec4 bounding sphere per object
+    unsigned int m_CommandBuffer;   // one DrawElementsIndirectCommand per level of detail
+    unsigned int m_VisibleBuffer;   // object indices, objectCount slots per level
+    unsigned int m_ObjectCount;
+    unsigned int m_VisibleCapacity;
+    GLenum m_IndexType;
+    std::vector<DrawElementsIndirectCommand> m_Commands;   // with instanceCount 0, uploaded before each cull
+    std::vector<float> m_LodErrors;
+
+    // uniforms of cull.comp
+    int m_FrustumPlanesLocation;
+    int m_ObjectCountLocation;
+    int m_LodCountLocation;
+    int m_LodErrorsLocation;
+    int m_CameraPositionLocation;
+    int m_PixelsPerUnitLocation;
+    int m_PixelErrorLocation;
+
+    // copies of past frames' commands, mapped once their fence has signalled
+    unsigned int m_Readback[GPU_READBACK_FRAMES];
+    GLsync m_ReadbackFences[GPU_READBACK_FRAMES];
+    unsigned int m_ReadbackFrame;
+    unsigned int m_VisibleObjects;
+    unsigned int m_Triangles;
+
+    void resizeVisible();
+    void readBack();
+
+public:
+    // true if the context can run this path
+    static bool isSupported();
+
+    // constructor builds the culling program and points the per-instance object index attribute at attribLocation
+    // to its own buffer. Construct it after the InstancedRenderer of the same VAO, whose draw() is not used anymore
+    GpuDrivenRenderer(unsigned int vao, unsigned int attribLocation = 3);
+    // Destructor
+    ~GpuDrivenRenderer();
+
+    GpuDrivenRenderer(const GpuDrivenRenderer&) = delete;
+    GpuDrivenRenderer& operator=(const GpuDrivenRenderer&) = delete;
+
+    // false if the culling program failed to build
+    bool isValid() const { return m_Program != 0; }
+
+    // bounding spheres of all objects, object i is drawn with model matrix i
+    void setObjects(const glm::vec3* centers, unsigned int count, float radius);
+    // levels of detail of the mesh in the VAO
+    void setMesh(const std::vector<MeshLod>& lods, GLenum indexType);
+    // run the culling pass with the view and pixel error of lods. Leaves the culling program bound
+    void cull(const Frustum& frustum, const LodSelector& lods);
+    // draw everything that passed with the model matrices in transformTexture (InstancedRenderer::getTransformTexture()),
+    // with the VAO and the drawing program bound
+    void draw(unsigned int transformTexture);
+
+    // from the last frame whose commands have been read back, a few frames old
+    unsigned int getVisibleObjects() const { return m_VisibleObjects; }
+    unsigned int getTriangleCount() const { return m_Triangles; }
+};
@@ -0,0 +1,138 @@
+#include <glad/glad.h>
+
+#include "HeadlessContext.h"
+
+#include <EGL/eglext.h>
+
+#include <iostream>
+
+HeadlessContext::HeadlessContext(int width, int height, int majorVersion, int minorVersion)
+// constructor creates the context and makes it current on the calling thread
+    : m_Display(EGL_NO_DISPLAY), m_Context(EGL_NO_CONTEXT), m_FBO(0), m_ColorRBO(0), m_DepthRBO(0), m_Width(width), m_Height(height)
+{
+    // surfaceless platform: no window system and no pbuffer needed, works on Mesa llvmpipe
+    PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (eglGetPlatformDisplayEXT)
+        m_Display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (m_Display == EGL_NO_DISPLAY)
+        m_Display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (m_Display == EGL_NO_DISPLAY || !eglInitialize(m_Display, &major, &minor))
+    {
+        std::cout << "ERROR::EGL::INITIALIZE_FAILED" << std::endl;
+        m_Display = EGL_NO_DISPLAY;
+        return;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        std::cout << "ERROR::EGL::OPENGL_API_NOT_SUPPORTED" << std::endl;
+        return;
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, majorVersion,
+        EGL_CONTEXT_MINOR_VERSION, minorVersion,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    // EGL_KHR_no_config_context: there is no surface, so no config is needed either
+    m_Context = eglCreateContext(m_Display, (EGLConfig)0, EGL_NO_CONTEXT, contextAttribs);
+    if (m_Context == EGL_NO_CONTEXT)
+    {
+        std::cout << "ERROR::EGL::CONTEXT_CREATION_FAILED (0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+        return;
+    }
+
+    if (!eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_Context))
+    {
+        std::cout << "ERROR::EGL::MAKE_CURRENT_FAILED" << std::endl;
+        eglDestroyContext(m_Display, m_Context);
+        m_Context = EGL_NO_CONTEXT;
+    }
+}
+
+HeadlessContext::~HeadlessContext()
+{
+    if (m_FBO)
+    {
+        glDeleteFramebuffers(1, &m_FBO);
+        glDeleteRenderbuffers(1, &m_ColorRBO);
+        glDeleteRenderbuffers(1, &m_DepthRBO);
+    }
+    if (m_Display != EGL_NO_DISPLAY)
+    {
+        eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (m_Context != EGL_NO_CONTEXT)
+            eglDestroyContext(m_Display, m_Context);
+        eglTerminate(m_Display);
+    }
+}
+
+bool HeadlessContext::isValid() const
+// true if the context was created and made current
+{
+    return m_Context != EGL_NO_CONTEXT;
+}
+
+bool HeadlessContext::createFramebuffer()
+// create and bind the offscreen framebuffer, call after GLAD has been loaded
+{
+    glGenRenderbuffers(1, &m_ColorRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_ColorRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_Width, m_Height);
+
+    glGenRenderbuffers(1, &m_DepthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_DepthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_Width, m_Height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &m_FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_ColorRBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_DepthRBO);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "ERROR::FRAMEBUFFER::NOT_COMPLETE" << std::endl;
+        return false;
+    }
+
+    // the FBO stays bound for the whole run and acts as the default framebuffer
+    glViewport(0, 0, m_Width, m_Height);
+    return true;
+}
+
+void HeadlessContext::swapBuffers()
+// stand-in for glfwSwapBuffers(): waits for the GPU so that frame times include the rendering work
+{
+    glFinish();
+}
+
+bool HeadlessContext::makeCurrent(bool current)
+// make the context current (true) or not current (false) on the calling thread, e.g. to hand it to a render thread
+{
+    if (eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, current ? m_Context : EGL_NO_CONTEXT))
+        return true;
+    std::cout << "ERROR::EGL::MAKE_CURRENT_FAILED" << std::endl;
+    return false;
+}
+
+int HeadlessContext::getWidth() const
+{
+    return m_Width;
+}
+
+int HeadlessContext::getHeight() const
+{
+    return m_Height;
+}
+
+void* HeadlessContext::getProcAddress(const char* name)
+// function loader to pass to gladLoadGLLoader()
+{
+    // EGL_KHR_get_all_proc_addresses lets this return core functions as well
+    return (void*)eglGetProcAddress(name);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <EGL/egl.h>
+
+// Offscreen OpenGL context for machines without a display (e.g. CI running Mesa llvmpipe).
+// Uses an EGL surfaceless display, so all rendering goes to an FBO owned by this class instead of a window.
+class HeadlessContext
+{
+private:
+    EGLDisplay m_Display;
+    EGLContext m_Context;
+    // offscreen render target that replaces the default framebuffer
+    unsigned int m_FBO;
+    unsigned int m_ColorRBO;
+    unsigned int m_DepthRBO;
+    int m_Width;
+    int m_Height;
+
+public:
+    // constructor creates the context and makes it current on the calling thread
+    HeadlessContext(int width, int height, int majorVersion = 3, int minorVersion = 3);
+    // Destructor
+    ~HeadlessContext();
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // true if the context was created and made current
+    bool isValid() const;
+    // create and bind the offscreen framebuffer, call after GLAD has been loaded
+    bool createFramebuffer();
+    // stand-in for glfwSwapBuffers(): waits for the GPU so that frame times include the rendering work
+    void swapBuffers();
+    // make the context current (true) or not current (false) on the calling thread, e.g. to hand it to a render thread
+    bool makeCurrent(bool current);
+
+    int getWidth() const;
+    int getHeight() const;
+
+    // function loader to pass to gladLoadGLLoader()
+    static void* getProcAddress(const char* name);
+};
@@ -0,0 +1,113 @@
+#include "InstancedRenderer.h"
+#include "GLStateCache.h"
+#include "StreamBuffer.h"
+#include "VertexLayout.h"
+
+#include <cstring>
+#include <iostream>
+
+InstancedRenderer::InstancedRenderer(unsigned int vao, unsigned int attribLocation)
+// constructor adds the per-instance object index attribute at attribLocation to the VAO, needs StreamBuffer::Get() initialized
+    : m_VAO(vao), m_AttribLocation(attribLocation), m_InstanceBuffer(0), m_InstanceOffset(0), m_AttribBuffer(0), m_AttribOffset(0), m_Count(0),
+      m_TransformBuffer(0), m_TransformTexture(0), m_TransformCapacity(0)
+{
+    // an integer attribute (glVertexAttribIPointer, no conversion to float), advancing once per instance instead of once per vertex.
+    // draw() points it at the indices, which move through the stream buffer every frame
+    glBindVertexArray(m_VAO);
+    glEnableVertexAttribArray(attribLocation);
+    glVertexAttribDivisor(attribLocation, 1);
+    glBindVertexArray(0);
+
+    // the shader reads 4 RGBA32F texels (the columns) per matrix
+    glGenBuffers(1, &m_TransformBuffer);
+    glGenTextures(1, &m_TransformTexture);
+}
+
+InstancedRenderer::~InstancedRenderer()
+{
+    GLStateCache& stateCache = GLStateCache::Get();
+    stateCache.forgetBuffer(m_TransformBuffer);
+    stateCache.forgetTexture(m_TransformTexture);
+    glDeleteBuffers(1, &m_TransformBuffer);
+    glDeleteTextures(1, &m_TransformTexture);
+}
+
+void InstancedRenderer::uploadAll(const glm::mat4* world, unsigned int count)
+// (re)allocate the buffer if it is too small and upload the model matrices of all count objects
+{
+    GLStateCache& stateCache = GLStateCache::Get();
+    if (count > m_TransformCapacity)
+    {
+        GLint maxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        if ((GLint64)count * 4 > maxTexels)
+            std::cout << "Warning! " << count << " transforms exceed GL_MAX_TEXTURE_BUFFER_SIZE (" << maxTexels / 4 << " matrices)" << std::endl;
+        m_TransformCapacity = count > 2 * m_TransformCapacity ? count : 2 * m_TransformCapacity;
+    }
+    stateCache.bindBuffer(GL_TEXTURE_BUFFER, m_TransformBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, m_TransformCapacity * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+    if (count > 0)
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, count * sizeof(glm::mat4), world);
+    // the texture has to be re-attached after the storage changed
+    stateCache.bindTexture(INSTANCE_TRANSFORM_UNIT, GL_TEXTURE_BUFFER, m_TransformTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_TransformBuffer);
+}
+
+void InstancedRenderer::updateTransforms(const unsigned int* objects, const glm::mat4* matrices, unsigned int count, unsigned int objectCount)
+// copy the matrices that changed to the GPU, e.g. recorded from a TransformStore for the render thread: matrices[i] is
+// the model matrix of objects[i]. objects NULL means all objectCount matrices are given, which is required whenever objectCount grew
+{
+    if (!objects)
+    {
+        uploadAll(matrices, objectCount);
+        return;
+    }
+    // the matrices of a run of consecutive objects are consecutive too
+    GLStateCache::Get().bindBuffer(GL_TEXTURE_BUFFER, m_TransformBuffer);
+    unsigned int i = 0;
+    while (i < count)
+    {
+        unsigned int end = i + 1;
+        while (end < count && objects[end] == objects[end - 1] + 1)
+            end++;
+        glBufferSubData(GL_TEXTURE_BUFFER, objects[i] * sizeof(glm::mat4), (end - i) * sizeof(glm::mat4), matrices + i);
+        i = end;
+    }
+}
+
+void InstancedRenderer::setInstances(const unsigned int* objects, unsigned int count)
+// set the objects to draw this frame
+{
+    m_Count = count;
+    if (count == 0)
+        return;
+    // the region written this frame is not read by the GPU anymore, no orphaning or synchronization needed
+    StreamBuffer& streamBuffer = StreamBuffer::Get();
+    StreamAllocation allocation = streamBuffer.allocate(count * sizeof(unsigned int), sizeof(unsigned int));
+    memcpy(allocation.data, objects, count * sizeof(unsigned int));
+    streamBuffer.flush();
+    m_InstanceBuffer = allocation.buffer;
+    m_InstanceOffset = allocation.offset;
+    // the stream buffer reuses the names of buffers it deleted, so a matching name may be a different buffer
+    m_AttribBuffer = 0;
+}
+
+void InstancedRenderer::draw(unsigned int indexCount, GLenum indexType, unsigned int firstIndex, unsigned int firstInstance, unsigned int instanceCount)
+// draw instanceCount instances (all by default) starting at firstInstance, using indexCount indices from firstIndex.
+// The VAO must be bound. GL 3.3 has no base instance, so a different firstInstance moves the attribute pointer instead
+{
+    if (firstInstance >= m_Count)
+        return;
+    instanceCount = instanceCount < m_Count - firstInstance ? instanceCount : m_Count - firstInstance;
+    GLStateCache& stateCache = GLStateCache::Get();
+    GLintptr offset = m_InstanceOffset + firstInstance * sizeof(unsigned int);
+    if (m_InstanceBuffer != m_AttribBuffer || offset != m_AttribOffset)
+    {
+        stateCache.bindBuffer(GL_ARRAY_BUFFER, m_InstanceBuffer);
+        glVertexAttribIPointer(m_AttribLocation, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)offset);
+        m_AttribBuffer = m_InstanceBuffer;
+        m_AttribOffset = offset;
+    }
+    stateCache.bindTexture(INSTANCE_TRANSFORM_UNIT, GL_TEXTURE_BUFFER, m_TransformTexture);
+    glDrawElementsInstanced(GL_TRIANGLES, indexCount, indexType, (void*)((std::size_t)firstIndex * getIndexSize(indexType)), instanceCount);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <climits>
+
+const unsigned int INSTANCE_TRANSFORM_UNIT = 2; // texture unit of the model matrix buffer, set the shader's samplerBuffer to it
+
+// Draws many copies of the mesh in a VAO with a single glDrawElementsInstanced call (one per level of detail).
+// The model matrices of all objects live in a texture buffer that mirrors a TransformStore and only receives the matrices
+// that changed; the per-instance vertex attribute is just the index of the object to draw, so culling uploads 4 bytes
+// per visible object instead of a whole matrix, written straight into the StreamBuffer.
+class InstancedRenderer
+{
+private:
+    unsigned int m_VAO;
+    unsigned int m_AttribLocation;
+    unsigned int m_InstanceBuffer;  // StreamBuffer holding this frame's object index per instance
+    GLintptr m_InstanceOffset;
+    unsigned int m_AttribBuffer;    // where the instance attribute currently reads
+    GLintptr m_AttribOffset;
+    unsigned int m_Count;           // instances drawn
+    unsigned int m_TransformBuffer; // model matrices, indexed by object
+    unsigned int m_TransformTexture;
+    unsigned int m_TransformCapacity;
+
+    // (re)allocate the buffer if it is too small and upload the model matrices of all count objects
+    void uploadAll(const glm::mat4* world, unsigned int count);
+
+public:
+    // constructor adds the per-instance object index attribute at attribLocation to the VAO, needs StreamBuffer::Get() initialized
+    InstancedRenderer(unsigned int vao, unsigned int attribLocation = 3);
+    // Destructor
+    ~InstancedRenderer();
+
+    InstancedRenderer(const InstancedRenderer&) = delete;
+    InstancedRenderer& operator=(const InstancedRenderer&) = delete;
+
+    // copy the matrices that changed to the GPU, e.g. recorded from a TransformStore for the render thread: matrices[i] is
+    // the model matrix of objects[i]. objects NULL means all objectCount matrices are given, which is required whenever
+    // objectCount grew
+    void updateTransforms(const unsigned int* objects, const glm::mat4* matrices, unsigned int count, unsigned int objectCount);
+    // set the objects to draw this frame
+    void setInstances(const unsigned int* objects, unsigned int count);
+    // draw instanceCount instances (all by default) starting at firstInstance, using indexCount indices from firstIndex.
+    // The VAO must be bound. GL 3.3 has no base instance, so a different firstInstance moves the attribute pointer instead
+    void draw(unsigned int indexCount, GLenum indexType = GL_UNSIGNED_INT, unsigned int firstIndex = 0, unsigned int firstInstance = 0,
+              unsigned int instanceCount = UINT_MAX);
+
+    // texture buffer of the model matrices, for GpuDrivenRenderer::draw()
+    unsigned int getTransformTexture() const { return m_TransformTexture; }
+};
@@ -0,0 +1,309 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <string>
+
+// worker index of the current thread, and the system it belongs to
+static thread_local int t_WorkerIndex = -1;
+static thread_local const JobSystem* t_WorkerOwner = NULL;
+
+Job::Job(std::function<void()> function, JobPriority priority, const std::shared_ptr<Job>& parent)
+    : m_Function(function), m_Priority(priority), m_Parent(parent), m_Unfinished(1), m_Blockers(1), m_Finished(false)
+{
+}
+
+JobSystem::JobSystem(unsigned int workerCount)
+// constructor starts workerCount threads (0 = one per core besides the calling one, at least one)
+    : m_Queued(0), m_Stopping(false), m_LastReport(std::chrono::steady_clock::now()), m_ExecutedCounter(-1), m_StolenCounter(-1)
+{
+    if (workerCount == 0)
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        workerCount = cores > 1 ? cores - 1 : 1;
+    }
+    for (unsigned int i = 0; i < JOB_MAX_PROFILED_WORKERS; i++)
+        m_BusyCounters[i] = -1;
+
+    for (unsigned int i = 0; i <= workerCount; i++)
+    {
+        m_Workers.push_back(std::unique_ptr<Worker>(new Worker()));
+        Worker& worker = *m_Workers.back();
+        worker.busyNs = 0;
+        worker.executed = 0;
+        worker.stolen = 0;
+        worker.reportedBusyNs = 0;
+        worker.reportedExecuted = 0;
+        worker.reportedStolen = 0;
+    }
+    t_WorkerIndex = 0;
+    t_WorkerOwner = this;
+    // started once every deque exists, workers steal from all of them
+    for (unsigned int i = 1; i <= workerCount; i++)
+        m_Workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+// Destructor stops the workers, jobs still queued are dropped: wait for the ones you care about first
+{
+    {
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+        m_Stopping = true;
+    }
+    m_SleepCondition.notify_all();
+    for (std::unique_ptr<Worker>& worker : m_Workers)
+        if (worker->thread.joinable())
+            worker->thread.join();
+    if (t_WorkerOwner == this)
+    {
+        t_WorkerIndex = -1;
+        t_WorkerOwner = NULL;
+    }
+}
+
+int JobSystem::currentWorker() const
+// index of the calling thread in m_Workers, -1 for threads that do not belong to this system
+{
+    return t_WorkerOwner == this ? t_WorkerIndex : -1;
+}
+
+void JobSystem::workerLoop(unsigned int index)
+{
+    t_WorkerIndex = (int)index;
+    t_WorkerOwner = this;
+    for (;;)
+    {
+        JobHandle job = findJob((int)index, true);
+        if (job)
+        {
+            execute(job, (int)index);
+            continue;
+        }
+
+        // nothing to do anywhere, sleep until something is pushed
+        std::unique_lock<std::mutex> lock(m_SleepMutex);
+        m_SleepCondition.wait(lock, [this] { return m_Stopping || m_Queued.load(std::memory_order_acquire) > 0; });
+        if (m_Stopping)
+            return;
+    }
+}
+
+JobHandle JobSystem::findJob(int index, bool allowBackground)
+// next job for worker index: its own newest, else the oldest of another worker, else (if allowed) a background job
+{
+    JobHandle job;
+    if (index >= 0)
+    {
+        Worker& own = *m_Workers[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty())
+        {
+            job = own.jobs.back();
+            own.jobs.pop_back();
+        }
+    }
+
+    unsigned int count = (unsigned int)m_Workers.size();
+    for (unsigned int i = 1; !job && i <= count; i++)
+    {
+        unsigned int victim = (unsigned int)(index + i) % count;
+        if ((int)victim == index)
+            continue;
+        Worker& other = *m_Workers[victim];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.jobs.empty())
+        {
+            job = other.jobs.front();
+            other.jobs.pop_front();
+            if (index >= 0)
+                m_Workers[index]->stolen.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (!job && allowBackground)
+    {
+        std::lock_guard<std::mutex> lock(m_BackgroundMutex);
+        if (!m_Background.empty())
+        {
+            job = m_Background.front();
+            m_Background.pop_front();
+        }
+    }
+
+    if (job)
+        m_Queued.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+}
+
+void JobSystem::push(const JobHandle& job)
+{
+    if (job->m_Priority == JOB_BACKGROUND)
+    {
+        std::lock_guard<std::mutex> lock(m_BackgroundMutex);
+        m_Background.push_back(job);
+    }
+    else
+    {
+        // threads outside the system hand their jobs to worker 0's deque, where the workers steal them
+        int index = currentWorker();
+        Worker& worker = *m_Workers[index >= 0 ? index : 0];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.jobs.push_back(job);
+    }
+    m_Queued.fetch_add(1, std::memory_order_release);
+
+    // taking the mutex orders the push before a sleeping worker's check of m_Queued, so the wake up cannot be lost
+    {
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+    }
+    m_SleepCondition.notify_one();
+}
+
+void JobSystem::execute(const JobHandle& job, int index)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    job->m_Function();
+    uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    if (index >= 0)
+    {
+        m_Workers[index]->busyNs.fetch_add(ns, std::memory_order_relaxed);
+        m_Workers[index]->executed.fetch_add(1, std::memory_order_relaxed);
+    }
+    finish(job);
+}
+
+void JobSystem::finish(const JobHandle& job)
+// one unit of job (its function or a child) is done
+{
+    if (job->m_Unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    std::vector<JobHandle> dependents;
+    {
+        std::lock_guard<std::mutex> lock(job->m_DependentsMutex);
+        job->m_Finished = true;
+        dependents.swap(job->m_Dependents);
+    }
+    for (const JobHandle& dependent : dependents)
+        release(dependent);
+
+    if (job->m_Parent)
+    {
+        JobHandle parent = job->m_Parent;
+        job->m_Parent.reset();
+        finish(parent);
+    }
+}
+
+void JobSystem::release(const JobHandle& job)
+// one blocker of job is gone, queue it once none are left
+{
+    if (job->m_Blockers.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+    if (job->m_Function)
+        push(job);
+    else
+        finish(job);    // nothing to run, it is done once its children are
+}
+
+JobHandle JobSystem::create(std::function<void()> function, JobPriority priority, const JobHandle& parent)
+// create a job, it does not run before submit(). A child must be created before its parent is finished
+{
+    if (parent)
+        parent->m_Unfinished.fetch_add(1, std::memory_order_relaxed);
+    return JobHandle(new Job(function, priority, parent));
+}
+
+void JobSystem::addDependency(const JobHandle& job, const JobHandle& prerequisite)
+// job will not start before prerequisite has finished, call before submitting job
+{
+    std::lock_guard<std::mutex> lock(prerequisite->m_DependentsMutex);
+    if (prerequisite->m_Finished)
+        return;
+    job->m_Blockers.fetch_add(1, std::memory_order_relaxed);
+    prerequisite->m_Dependents.push_back(job);
+}
+
+void JobSystem::submit(const JobHandle& job)
+// hand the job over to the scheduler, it runs as soon as its dependencies are done
+{
+    release(job);
+}
+
+void JobSystem::wait(const JobHandle& job)
+// block until job has finished, running frame jobs in the meantime
+{
+    int index = currentWorker();
+    while (!job->isFinished())
+    {
+        // background jobs can take much longer than what we are waiting for, leave them to the idle workers
+        JobHandle other = findJob(index, false);
+        if (other)
+            execute(other, index);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::parallelFor(unsigned int begin, unsigned int end, unsigned int grain, const std::function<void(unsigned int, unsigned int)>& function)
+// call function(first, end) over [begin, end) in chunks of grain items spread over the workers, returns once all are done
+{
+    if (end <= begin)
+        return;
+    if (grain == 0)
+        grain = 1;
+    if (end - begin <= grain)
+    {
+        function(begin, end);
+        return;
+    }
+
+    JobHandle group = create(std::function<void()>());
+    for (unsigned int first = begin; first < end; first += grain)
+    {
+        unsigned int last = end - first > grain ? first + grain : end;
+        submit(create([&function, first, last] { function(first, last); }, JOB_FRAME, group));
+    }
+    submit(group);
+    wait(group);
+}
+
+unsigned int JobSystem::getWorkerCount() const
+{
+    return (unsigned int)m_Workers.size();
+}
+
+void JobSystem::endFrame()
+// render thread, once per frame: report the share of the frame each worker spent running jobs, and the jobs run/stolen
+{
+    Profiler& profiler = Profiler::Get();
+    if (m_ExecutedCounter < 0)
+    {
+        for (unsigned int i = 0; i < JOB_MAX_PROFILED_WORKERS && i < m_Workers.size(); i++)
+            m_BusyCounters[i] = profiler.registerCounter(("worker" + std::to_string(i) + "_busy_pct").c_str());
+        m_ExecutedCounter = profiler.registerCounter("jobs_executed");
+        m_StolenCounter = profiler.registerCounter("jobs_stolen");
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double frameNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_LastReport).count();
+    m_LastReport = now;
+
+    uint64_t executed = 0;
+    uint64_t stolen = 0;
+    for (unsigned int i = 0; i < m_Workers.size(); i++)
+    {
+        Worker& worker = *m_Workers[i];
+        uint64_t busyNs = worker.busyNs.load(std::memory_order_relaxed);
+        uint64_t workerExecuted = worker.executed.load(std::memory_order_relaxed);
+        uint64_t workerStolen = worker.stolen.load(std::memory_order_relaxed);
+        if (i < JOB_MAX_PROFILED_WORKERS && frameNs > 0.0)
+            profiler.setCounter(m_BusyCounters[i], 100.0 * (double)(busyNs - worker.reportedBusyNs) / frameNs);
+        executed += workerExecuted - worker.reportedExecuted;
+        stolen += workerStolen - worker.reportedStolen;
+        worker.reportedBusyNs = busyNs;
+        worker.reportedExecuted = workerExecuted;
+        worker.reportedStolen = workerStolen;
+    }
+    profiler.setCounter(m_ExecutedCounter, (double)executed);
+    profiler.setCounter(m_StolenCounter, (double)stolen);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const unsigned int JOB_MAX_PROFILED_WORKERS = 8; // workers with a utilization counter in the profiler
+
+enum JobPriority
+{
+    JOB_FRAME = 0,      // work the current frame waits for (culling, transforms), run by every thread
+    JOB_BACKGROUND = 1  // long running work (asset decoding), only run by the worker threads so it never delays a frame
+};
+
+// Unit of work for the JobSystem. A job runs once all its dependencies have finished, and counts as finished
+// once its function and all of its children have. A job without a function only groups its children.
+class Job
+{
+private:
+    friend class JobSystem;
+    std::function<void()> m_Function;
+    JobPriority m_Priority;
+    std::shared_ptr<Job> m_Parent;
+    std::atomic<int> m_Unfinished;  // the job itself and its unfinished children
+    std::atomic<int> m_Blockers;    // unfinished dependencies, plus one until it is submitted
+    std::mutex m_DependentsMutex;
+    std::vector<std::shared_ptr<Job>> m_Dependents; // jobs waiting for this one, guarded by m_DependentsMutex
+    bool m_Finished;                                // guarded by m_DependentsMutex
+
+public:
+    Job(std::function<void()> function, JobPriority priority, const std::shared_ptr<Job>& parent);
+
+    bool isFinished() const { return m_Unfinished.load(std::memory_order_acquire) == 0; }
+};
+
+typedef std::shared_ptr<Job> JobHandle;
+
+// Work-stealing job scheduler. Every thread has its own deque: it pushes and pops at the back (most recent work first,
+// still warm in its cache) while idle threads steal from the front of the others. The thread that creates the system
+// is worker 0 and only runs jobs while it waits for one; the other workers are threads started by the constructor.
+// Busy time and job counts per worker are reported to the profiler by endFrame().
+class JobSystem
+{
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;     // guarded by mutex
+        std::thread thread;             // not started for worker 0
+        std::atomic<uint64_t> busyNs;   // time spent running jobs, since startup
+        std::atomic<uint64_t> executed;
+        std::atomic<uint64_t> stolen;   // jobs taken from another worker's deque
+        uint64_t reportedBusyNs;        // busyNs at the last endFrame()
+        uint64_t reportedExecuted;
+        uint64_t reportedStolen;
+    };
+
+    std::vector<std::unique_ptr<Worker>> m_Workers;
+    std::mutex m_BackgroundMutex;
+    std::deque<JobHandle> m_Background;  // guarded by m_BackgroundMutex
+
+    std::atomic<unsigned int> m_Queued; // jobs in any queue, workers sleep while it is 0
+    std::mutex m_SleepMutex;
+    std::condition_variable m_SleepCondition;
+    bool m_Stopping;                     // guarded by m_SleepMutex
+
+    std::chrono::steady_clock::time_point m_LastReport;
+    int m_BusyCounters[JOB_MAX_PROFILED_WORKERS];
+    int m_ExecutedCounter;
+    int m_StolenCounter;
+
+    // index of the calling thread in m_Workers, -1 for threads that do not belong to this system
+    int currentWorker() const;
+    void workerLoop(unsigned int index);
+    // next job for worker index: its own newest, else the oldest of another worker, else (if allowed) a background job
+    JobHandle findJob(int index, bool allowBackground);
+    void push(const JobHandle& job);
+    void execute(const JobHandle& job, int index);
+    // one unit of job (its function or a child) is done
+    void finish(const JobHandle& job);
+    // one blocker of job is gone, queue it once none are left
+    void release(const JobHandle& job);
+
+public:
+    // constructor starts workerCount threads (0 = one per core besides the calling one, at least one)
+    JobSystem(unsigned int workerCount = 0);
+    // Destructor stops the workers, jobs still queued are dropped: wait for the ones you care about first
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // create a job, it does not run before submit(). A child must be created before its parent is finished
+    JobHandle create(std::function<void()> function, JobPriority priority = JOB_FRAME, const JobHandle& parent = JobHandle());
+    // job will not start before prerequisite has finished, call before submitting job
+    void addDependency(const JobHandle& job, const JobHandle& prerequisite);
+    // hand the job over to the scheduler, it runs as soon as its dependencies are done
+    void submit(const JobHandle& job);
+    // block until job has finished, running frame jobs in the meantime
+    void wait(const JobHandle& job);
+
+    // call function(first, end) over [begin, end) in chunks of grain items spread over the workers, returns once all are done
+    void parallelFor(unsigned int begin, unsigned int end, unsigned int grain, const std::function<void(unsigned int, unsigned int)>& function);
+
+    // worker threads plus the thread that created the system
+    unsigned int getWorkerCount() const;
+
+    // render thread, once per frame: report the share of the frame each worker spent running jobs, and the jobs run/stolen
+    void endFrame();
+};
@@ -0,0 +1,321 @@
+#include "Json.h"
+
+#include <cstdlib>
+#include <cstring>
+
+static const unsigned int JSON_MAX_DEPTH = 256; // nesting limit, keeps malicious files from overflowing the stack
+
+// recursive descent over the text, reports the offset of the first error
+class JsonParser
+{
+private:
+    const char* m_Text;
+    std::size_t m_Length;
+    std::size_t m_Position;
+    std::string m_Error;
+
+    bool fail(const char* message)
+    {
+        if (m_Error.empty())
+            m_Error = std::string(message) + " at byte " + std::to_string(m_Position);
+        return false;
+    }
+
+    void skipWhitespace()
+    {
+        while (m_Position < m_Length && (m_Text[m_Position] == ' ' || m_Text[m_Position] == '\t' ||
+               m_Text[m_Position] == '\n' || m_Text[m_Position] == '\r'))
+            m_Position++;
+    }
+
+    bool expect(const char* literal)
+    {
+        std::size_t length = strlen(literal);
+        if (m_Length - m_Position < length || memcmp(m_Text + m_Position, literal, length) != 0)
+            return fail("unexpected token");
+        m_Position += length;
+        return true;
+    }
+
+    static void appendUtf8(std::string& out, unsigned int codePoint)
+    {
+        if (codePoint < 0x80)
+            out += (char)codePoint;
+        else if (codePoint < 0x800)
+        {
+            out += (char)(0xC0 | (codePoint >> 6));
+            out += (char)(0x80 | (codePoint & 0x3F));
+        }
+        else if (codePoint < 0x10000)
+        {
+            out += (char)(0xE0 | (codePoint >> 12));
+            out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+            out += (char)(0x80 | (codePoint & 0x3F));
+        }
+        else
+        {
+            out += (char)(0xF0 | (codePoint >> 18));
+            out += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+            out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+            out += (char)(0x80 | (codePoint & 0x3F));
+        }
+    }
+
+    bool parseHex4(unsigned int& value)
+    {
+        if (m_Length - m_Position < 4)
+            return fail("truncated escape");
+        value = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            char c = m_Text[m_Position++];
+            value <<= 4;
+            if (c >= '0' && c <= '9') value |= (unsigned int)(c - '0');
+            else if (c >= 'a' && c <= 'f') value |= (unsigned int)(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') value |= (unsigned int)(c - 'A' + 10);
+            else return fail("invalid escape");
+        }
+        return true;
+    }
+
+    bool parseString(std::string& out)
+    {
+        // called on the opening quote
+        m_Position++;
+        out.clear();
+        for (;;)
+        {
+            if (m_Position >= m_Length)
+                return fail("unterminated string");
+            char c = m_Text[m_Position++];
+            if (c == '"')
+                return true;
+            if (c != '\\')
+            {
+                out += c;
+                continue;
+            }
+            if (m_Position >= m_Length)
+                return fail("unterminated string");
+            char escape = m_Text[m_Position++];
+            switch (escape)
+            {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u':
+            {
+                unsigned int codePoint = 0;
+                if (!parseHex4(codePoint))
+                    return false;
+                if (codePoint >= 0xD800 && codePoint < 0xDC00)
+                {
+                    // a high surrogate needs an escaped low one next, else it becomes U+FFFD and the next escape is read on its own
+                    std::size_t next = m_Position;
+                    unsigned int low = 0;
+                    if (m_Length - m_Position >= 6 && m_Text[m_Position] == '\\' && m_Text[m_Position + 1] == 'u')
+                    {
+                        m_Position += 2;
+                        if (!parseHex4(low))
+                            return false;
+                    }
+                    if (low >= 0xDC00 && low < 0xE000)
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    else
+                    {
+                        m_Position = next;
+                        codePoint = 0xFFFD;
+                    }
+                }
+                else if (codePoint >= 0xDC00 && codePoint < 0xE000)
+                    codePoint = 0xFFFD;     // low surrogate without a high one
+                appendUtf8(out, codePoint);
+                break;
+            }
+            default:
+                return fail("invalid escape");
+            }
+        }
+    }
+
+    bool parseNumber(double& out)
+    {
+        // strtod needs a terminated string, numbers are short so copy the token
+        char token[64];
+        std::size_t length = 0;
+        while (m_Position + length < m_Length && length < sizeof(token) - 1)
+        {
+            char c = m_Text[m_Position + length];
+            if (!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'))
+                break;
+            length++;
+        }
+        memcpy(token, m_Text + m_Position, length);
+        token[length] = '\0';
+        char* end;
+        out = strtod(token, &end);
+        if (end == token)
+            return fail("invalid number");
+        m_Position += (std::size_t)(end - token);
+        return true;
+    }
+
+public:
+    JsonParser(const char* text, std::size_t length) : m_Text(text), m_Length(length), m_Position(0) {}
+
+    const std::string& getError() const { return m_Error; }
+
+    bool parseDocument(JsonValue& out)
+    {
+        if (!parseValue(out, 0))
+            return false;
+        skipWhitespace();
+        if (m_Position != m_Length)
+            return fail("trailing characters");
+        return true;
+    }
+
+    bool parseValue(JsonValue& out, unsigned int depth)
+    {
+        if (depth > JSON_MAX_DEPTH)
+            return fail("nesting too deep");
+        skipWhitespace();
+        if (m_Position >= m_Length)
+            return fail("unexpected end");
+
+        out = JsonValue();
+        char c = m_Text[m_Position];
+        if (c == '{')
+        {
+            out.m_Type = JSON_OBJECT;
+            m_Position++;
+            skipWhitespace();
+            if (m_Position < m_Length && m_Text[m_Position] == '}')
+            {
+                m_Position++;
+                return true;
+            }
+            for (;;)
+            {
+                skipWhitespace();
+                if (m_Position >= m_Length || m_Text[m_Position] != '"')
+                    return fail("expected a member name");
+                out.m_Keys.push_back(std::string());
+                if (!parseString(out.m_Keys.back()))
+                    return false;
+                skipWhitespace();
+                if (m_Position >= m_Length || m_Text[m_Position] != ':')
+                    return fail("expected ':'");
+                m_Position++;
+                out.m_Values.push_back(JsonValue());
+                if (!parseValue(out.m_Values.back(), depth + 1))
+                    return false;
+                skipWhitespace();
+                if (m_Position < m_Length && m_Text[m_Position] == ',')
+                {
+                    m_Position++;
+                    continue;
+                }
+                if (m_Position < m_Length && m_Text[m_Position] == '}')
+                {
+                    m_Position++;
+                    return true;
+                }
+                return fail("expected ',' or '}'");
+            }
+        }
+        if (c == '[')
+        {
+            out.m_Type = JSON_ARRAY;
+            m_Position++;
+            skipWhitespace();
+            if (m_Position < m_Length && m_Text[m_Position] == ']')
+            {
+                m_Position++;
+                return true;
+            }
+            for (;;)
+            {
+                out.m_Values.push_back(JsonValue());
+                if (!parseValue(out.m_Values.back(), depth + 1))
+                    return false;
+                skipWhitespace();
+                if (m_Position < m_Length && m_Text[m_Position] == ',')
+                {
+                    m_Position++;
+                    continue;
+                }
+                if (m_Position < m_Length && m_Text[m_Position] == ']')
+                {
+                    m_Position++;
+                    return true;
+                }
+                return fail("expected ',' or ']'");
+            }
+        }
+        if (c == '"')
+        {
+            out.m_Type = JSON_STRING;
+            return parseString(out.m_String);
+        }
+        if (c == 't')
+        {
+            out.m_Type = JSON_BOOL;
+            out.m_Bool = true;
+            return expect("true");
+        }
+        if (c == 'f')
+        {
+            out.m_Type = JSON_BOOL;
+            out.m_Bool = false;
+            return expect("false");
+        }
+        if (c == 'n')
+            return expect("null");
+        out.m_Type = JSON_NUMBER;
+        return parseNumber(out.m_Number);
+    }
+};
+
+JsonValue::JsonValue()
+    : m_Type(JSON_NULL), m_Bool(false), m_Number(0.0)
+{
+}
+
+bool JsonValue::parse(const char* text, std::size_t length, JsonValue& out, std::string& error)
+// parse a whole document, error gets a message with the byte offset if it fails
+{
+    JsonParser parser(text, length);
+    if (parser.parseDocument(out))
+        return true;
+    error = parser.getError();
+    return false;
+}
+
+const JsonValue* JsonValue::find(const char* key) const
+// member of an object, NULL if missing (or not an object)
+{
+    if (m_Type != JSON_OBJECT)
+        return NULL;
+    for (std::size_t i = 0; i < m_Keys.size(); i++)
+        if (m_Keys[i] == key)
+            return &m_Values[i];
+    return NULL;
+}
+
+double JsonValue::getNumber(const char* key, double fallback) const
+{
+    const JsonValue* value = find(key);
+    return value && value->m_Type == JSON_NUMBER ? value->m_Number : fallback;
+}
+
+std::string JsonValue::getString(const char* key, const std::string& fallback) const
+{
+    const JsonValue* value = find(key);
+    return value && value->m_Type == JSON_STRING ? value->m_String : fallback;
+}
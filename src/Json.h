@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+enum JsonType
+{
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+};
+
+// Minimal JSON document (RFC 8259), enough to read glTF files.
+// Object members keep their file order, lookups are linear which is fine for the small objects glTF uses.
+class JsonValue
+{
+private:
+    friend class JsonParser;
+    JsonType m_Type;
+    bool m_Bool;
+    double m_Number;
+    std::string m_String;
+    std::vector<std::string> m_Keys;    // object member names
+    std::vector<JsonValue> m_Values;    // array items or object member values
+
+public:
+    JsonValue();
+
+    // parse a whole document, error gets a message with the byte offset if it fails
+    static bool parse(const char* text, std::size_t length, JsonValue& out, std::string& error);
+
+    JsonType getType() const { return m_Type; }
+    bool isObject() const { return m_Type == JSON_OBJECT; }
+    bool isArray() const { return m_Type == JSON_ARRAY; }
+    bool isNumber() const { return m_Type == JSON_NUMBER; }
+    bool isString() const { return m_Type == JSON_STRING; }
+
+    bool asBool() const { return m_Bool; }
+    double asNumber() const { return m_Number; }
+    const std::string& asString() const { return m_String; }
+
+    // items of an array or members of an object
+    std::size_t size() const { return m_Values.size(); }
+    const JsonValue& operator[](std::size_t index) const { return m_Values[index]; }
+    const std::string& getKey(std::size_t index) const { return m_Keys[index]; }
+
+    // member of an object, NULL if missing (or not an object)
+    const JsonValue* find(const char* key) const;
+    // number/string member of an object, fallback if it is missing or of another type
+    double getNumber(const char* key, double fallback) const;
+    std::string getString(const char* key, const std::string& fallback) const;
+};
@@ -0,0 +1,67 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+#include <cmath>
+
+LodSelector::LodSelector()
+    : m_CameraPosition(0.0f), m_PixelsPerUnit(1.0f), m_PixelError(LOD_PIXEL_ERROR)
+{
+}
+
+void LodSelector::setView(const glm::vec3& cameraPosition, float fovDegrees, unsigned int viewportHeight, float pixelError)
+// fovDegrees: vertical field of view, viewportHeight in pixels
+{
+    m_CameraPosition = cameraPosition;
+    // the view frustum is 2 * tan(fov / 2) units high at distance 1
+    m_PixelsPerUnit = (float)viewportHeight / (2.0f * std::tan(glm::radians(fovDegrees) * 0.5f));
+    m_PixelError = pixelError;
+}
+
+unsigned int LodSelector::selectLod(const std::vector<MeshLod>& lods, float distance) const
+// coarsest level whose error stays below the pixel error seen from distance
+{
+    for (unsigned int level = (unsigned int)lods.size() - 1; level > 0; level--)
+        if (lods[level].error * m_PixelsPerUnit <= m_PixelError * distance)
+            return level;
+    return 0;
+}
+
+void LodSelector::select(const std::vector<MeshLod>& lods, const unsigned int* objects, unsigned int count, const glm::vec3* centers,
+                         float boundingRadius)
+// group objects (indices into centers) by level, the distance is measured to the bounding sphere of each object
+{
+    unsigned int levelCount = (unsigned int)lods.size();
+    m_First.assign(levelCount, 0);
+    m_Count.assign(levelCount, 0);
+    m_Levels.resize(count);
+    m_Objects.resize(count);
+    if (levelCount == 1)
+    {
+        m_Count[0] = count;
+        std::copy(objects, objects + count, m_Objects.begin());
+        return;
+    }
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        float distance = glm::length(centers[objects[i]] - m_CameraPosition) - boundingRadius;
+        unsigned int level = distance > 0.0f ? selectLod(lods, distance) : 0;
+        m_Levels[i] = (unsigned char)level;
+        m_Count[level]++;
+    }
+    // counting sort, objects keep their culling order within a level
+    for (unsigned int level = 1; level < levelCount; level++)
+        m_First[level] = m_First[level - 1] + m_Count[level - 1];
+    m_Next = m_First;
+    for (unsigned int i = 0; i < count; i++)
+        m_Objects[m_Next[m_Levels[i]]++] = objects[i];
+}
+
+unsigned int LodSelector::getTriangleCount(const std::vector<MeshLod>& lods) const
+// triangles drawn for the last select()
+{
+    unsigned int triangles = 0;
+    for (unsigned int level = 0; level < m_Count.size() && level < lods.size(); level++)
+        triangles += m_Count[level] * (lods[level].indexCount / 3);
+    return triangles;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "MeshLoader.h"
+
+#include <vector>
+
+const float LOD_PIXEL_ERROR = 1.0f;    // a coarser level is used as long as its error covers at most this many pixels
+
+// Picks the level of detail of every object from how large the level's simplification error appears on screen:
+// error / distance * pixels per unit at distance 1, which follows from the camera's field of view (Camera::getZoom()).
+// Zooming in therefore selects finer levels just like moving closer does. The objects are grouped by level so that
+// each level is drawn with one instanced draw call.
+class LodSelector
+{
+private:
+    glm::vec3 m_CameraPosition;
+    float m_PixelsPerUnit;      // at distance 1
+    float m_PixelError;
+    std::vector<unsigned int> m_Objects;    // grouped by level
+    std::vector<unsigned int> m_First;      // per level, into m_Objects
+    std::vector<unsigned int> m_Count;
+    std::vector<unsigned int> m_Next;       // scratch for the counting sort
+    std::vector<unsigned char> m_Levels;    // level of each object passed to select()
+
+public:
+    LodSelector();
+
+    // fovDegrees: vertical field of view, viewportHeight in pixels
+    void setView(const glm::vec3& cameraPosition, float fovDegrees, unsigned int viewportHeight, float pixelError = LOD_PIXEL_ERROR);
+    // coarsest level whose error stays below the pixel error seen from distance
+    unsigned int selectLod(const std::vector<MeshLod>& lods, float distance) const;
+    // group objects (indices into centers) by level, the distance is measured to the bounding sphere of each object
+    void select(const std::vector<MeshLod>& lods, const unsigned int* objects, unsigned int count, const glm::vec3* centers, float boundingRadius);
+
+    // view of the last setView(), for GpuDrivenRenderer's culling pass
+    const glm::vec3& getCameraPosition() const { return m_CameraPosition; }
+    float getPixelsPerUnit() const { return m_PixelsPerUnit; }
+    float getPixelError() const { return m_PixelError; }
+
+    // objects of the last select(), level by level
+    const unsigned int* getObjects() const { return m_Objects.data(); }
+    unsigned int getFirst(unsigned int level) const { return m_First[level]; }
+    unsigned int getCount(unsigned int level) const { return m_Count[level]; }
+    // triangles drawn for the last select()
+    unsigned int getTriangleCount(const std::vector<MeshLod>& lods) const;
+};
@@ -0,0 +1,217 @@
+#include "Logger.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+void LogRecord::add(bool value)
+{
+    if (argCount == LOG_MAX_ARGS)
+        return;
+    LogArgument& argument = args[argCount++];
+    argument.type = LogArgument::BOOL;
+    argument.b = value;
+}
+
+void LogRecord::add(double value)
+{
+    if (argCount == LOG_MAX_ARGS)
+        return;
+    LogArgument& argument = args[argCount++];
+    argument.type = LogArgument::DOUBLE;
+    argument.d = value;
+}
+
+void LogRecord::add(const char* value)
+// copies the string, as much of it as there is room for
+{
+    if (argCount == LOG_MAX_ARGS)
+        return;
+    if (!value)
+        value = "(null)";
+    LogArgument& argument = args[argCount++];
+    argument.type = LogArgument::STRING;
+    argument.string = stringBytes;
+    // once full, the last byte stays the terminator and further strings come out empty
+    std::size_t length = strlen(value);
+    if (length > LOG_STRING_BYTES - 1 - stringBytes)
+        length = LOG_STRING_BYTES - 1 - stringBytes;
+    memcpy(strings + stringBytes, value, length);
+    strings[stringBytes + length] = '\0';
+    std::size_t used = stringBytes + length + 1;
+    stringBytes = (uint16_t)(used < LOG_STRING_BYTES ? used : LOG_STRING_BYTES - 1);
+}
+
+void LogRecord::add(const void* value)
+{
+    if (argCount == LOG_MAX_ARGS)
+        return;
+    LogArgument& argument = args[argCount++];
+    argument.type = LogArgument::POINTER;
+    argument.p = value;
+}
+
+void LogRecord::write(std::string& out) const
+// the message with every {} replaced by the next argument
+{
+    char number[32];
+    unsigned int next = 0;
+    for (const char* c = format; *c; c++)
+    {
+        if (c[0] != '{' || c[1] != '}')
+        {
+            out += *c;
+            continue;
+        }
+        c++;
+        if (next == argCount)
+        {
+            out += "{}";    // missing argument
+            continue;
+        }
+        const LogArgument& argument = args[next++];
+        switch (argument.type)
+        {
+        case LogArgument::INT:
+            snprintf(number, sizeof(number), "%" PRId64, argument.i);
+            out += number;
+            break;
+        case LogArgument::UINT:
+            snprintf(number, sizeof(number), "%" PRIu64, argument.u);
+            out += number;
+            break;
+        case LogArgument::DOUBLE:
+            snprintf(number, sizeof(number), "%g", argument.d);     // like std::cout's default
+            out += number;
+            break;
+        case LogArgument::BOOL:
+            out += argument.b ? "true" : "false";
+            break;
+        case LogArgument::STRING:
+            out += strings + argument.string;
+            break;
+        case LogArgument::POINTER:
+            snprintf(number, sizeof(number), "%p", argument.p);
+            out += number;
+            break;
+        }
+    }
+}
+
+Logger::Logger()
+    : m_Tail(0), m_Head(0), m_Level(LOG_LEVEL_TRACE), m_Dropped(0), m_Sleeping(false), m_Stopping(false)
+{
+    for (unsigned int i = 0; i < LOG_QUEUE_SIZE; i++)
+        m_Slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+Logger& Logger::Get()
+{
+    static Logger instance;
+    return instance;
+}
+
+Logger::~Logger()
+{
+    shutdown();
+}
+
+void Logger::init()
+// start the writer thread, messages logged before are kept until then
+{
+    if (m_Writer.joinable())
+        return;
+    m_Stopping.store(false, std::memory_order_relaxed);
+    m_Writer = std::thread(&Logger::run, this);
+}
+
+void Logger::shutdown()
+// print what is still queued and stop the writer thread
+{
+    if (!m_Writer.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_WakeMutex);
+        m_Stopping.store(true, std::memory_order_relaxed);
+    }
+    m_Wake.notify_one();
+    m_Writer.join();
+    uint64_t dropped = m_Dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped)
+        std::cout << "Warning! " << dropped << " log messages dropped, the queue was full" << std::endl;
+}
+
+bool Logger::reserve(uint64_t& position)
+// position of a free slot, false if the queue is full
+{
+    position = m_Tail.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Slot& slot = m_Slots[position % LOG_QUEUE_SIZE];
+        int64_t difference = (int64_t)slot.sequence.load(std::memory_order_acquire) - (int64_t)position;
+        if (difference == 0)
+        {
+            // free, claim it unless another producer was faster
+            if (m_Tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                return true;
+        }
+        else if (difference < 0)
+        {
+            // the writer has not read this slot yet since it was last used
+            m_Dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+            position = m_Tail.load(std::memory_order_relaxed);
+    }
+}
+
+void Logger::publish(uint64_t position)
+// hand the record at position to the writer thread
+{
+    m_Slots[position % LOG_QUEUE_SIZE].sequence.store(position + 1, std::memory_order_release);
+    if (m_Sleeping.load(std::memory_order_acquire))
+        m_Wake.notify_one();
+}
+
+bool Logger::drain(std::string& buffer)
+// format and print everything queued, true if there was anything
+{
+    buffer.clear();
+    for (;;)
+    {
+        Slot& slot = m_Slots[m_Head % LOG_QUEUE_SIZE];
+        if (slot.sequence.load(std::memory_order_acquire) != m_Head + 1)
+            break;      // empty, or the next record is still being written
+        slot.record.write(buffer);
+        buffer += '\n';
+        slot.sequence.store(m_Head + LOG_QUEUE_SIZE, std::memory_order_release);
+        m_Head++;
+    }
+    if (buffer.empty())
+        return false;
+    std::cout.write(buffer.data(), (std::streamsize)buffer.size());
+    std::cout.flush();
+    return true;
+}
+
+void Logger::run()
+// writer thread: prints batches of messages, sleeps while there are none
+{
+    std::string buffer;
+    for (;;)
+    {
+        if (drain(buffer))
+            continue;
+        std::unique_lock<std::mutex> lock(m_WakeMutex);
+        if (m_Stopping.load(std::memory_order_relaxed))
+            break;
+        // producers only notify while this is set, the timeout covers a notification sent just before the wait
+        m_Sleeping.store(true, std::memory_order_release);
+        m_Wake.wait_for(lock, std::chrono::milliseconds(50));
+        m_Sleeping.store(false, std::memory_order_relaxed);
+    }
+    drain(buffer);
+}
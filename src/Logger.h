@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+// Logger settings
+const unsigned int LOG_QUEUE_SIZE = 4096;   // records waiting for the writer thread, a power of two; more are dropped
+const unsigned int LOG_MAX_ARGS = 8;        // arguments per message, more are ignored
+const unsigned int LOG_STRING_BYTES = 128;  // string arguments are copied into the record, truncated beyond
+
+enum LogLevel
+{
+    LOG_LEVEL_TRACE = 0,    // every frame (held keys...)
+    LOG_LEVEL_DEBUG = 1,
+    LOG_LEVEL_INFO = 2,
+    LOG_LEVEL_WARNING = 3,
+    LOG_LEVEL_ERROR = 4,
+    LOG_LEVEL_NONE = 5
+};
+
+// messages below this level are compiled out, e.g. -DLEARNOPENGL_LOG_LEVEL=LOG_LEVEL_WARNING
+#ifndef LEARNOPENGL_LOG_LEVEL
+#ifdef NDEBUG
+#define LEARNOPENGL_LOG_LEVEL LOG_LEVEL_INFO
+#else
+#define LEARNOPENGL_LOG_LEVEL LOG_LEVEL_TRACE
+#endif
+#endif
+
+// One argument of a message, kept in binary form until the writer thread formats it
+struct LogArgument
+{
+    enum Type : uint8_t { INT, UINT, DOUBLE, BOOL, STRING, POINTER };
+    Type type;
+    union
+    {
+        int64_t i;
+        uint64_t u;
+        double d;
+        bool b;
+        uint16_t string;    // offset in LogRecord::strings
+        const void* p;
+    };
+};
+
+// A message as queued: the format string is not copied, so it must be a literal (or outlive the logger)
+struct LogRecord
+{
+    const char* format;
+    uint8_t argCount;
+    uint16_t stringBytes;
+    LogArgument args[LOG_MAX_ARGS];
+    char strings[LOG_STRING_BYTES];
+
+    void add(bool value);
+    void add(double value);
+    void add(const char* value);
+    void add(const std::string& value) { add(value.c_str()); }
+    void add(const void* value);
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value>::type add(T value)
+    {
+        if (argCount == LOG_MAX_ARGS)
+            return;
+        LogArgument& argument = args[argCount++];
+        if (std::is_signed<T>::value)
+        {
+            argument.type = LogArgument::INT;
+            argument.i = (int64_t)value;
+        }
+        else
+        {
+            argument.type = LogArgument::UINT;
+            argument.u = (uint64_t)value;
+        }
+    }
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type add(T value) { add((double)value); }
+    template <typename T>
+    typename std::enable_if<std::is_enum<T>::value>::type add(T value) { add((int64_t)value); }
+
+    // the message with every {} replaced by the next argument
+    void write(std::string& out) const;
+};
+
+// Asynchronous logger. Any thread may log: the arguments are copied into a slot of a bounded lock-free MPSC queue
+// and formatted later by a background writer thread, which prints whole batches with a single write. A full queue
+// drops the message instead of waiting, so logging never blocks the render thread.
+// Usage: LOG_INFO("Camera fov: {}", camera.getZoom());
+class Logger
+{
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence; // position + 1 once the record is complete, position + LOG_QUEUE_SIZE once free again
+        LogRecord record;
+    };
+
+    Slot m_Slots[LOG_QUEUE_SIZE];
+    std::atomic<uint64_t> m_Tail;       // next position handed to a producer
+    uint64_t m_Head;                    // next position read by the writer thread
+    std::atomic<int> m_Level;           // runtime filter, on top of LEARNOPENGL_LOG_LEVEL
+    std::atomic<uint64_t> m_Dropped;
+
+    std::thread m_Writer;
+    std::mutex m_WakeMutex;
+    std::condition_variable m_Wake;
+    std::atomic<bool> m_Sleeping;
+    std::atomic<bool> m_Stopping;
+
+    Logger();
+    // position of a free slot, false if the queue is full
+    bool reserve(uint64_t& position);
+    // hand the record at position to the writer thread
+    void publish(uint64_t position);
+    // format and print everything queued, true if there was anything
+    bool drain(std::string& buffer);
+    void run();
+
+public:
+    static Logger& Get();
+    // Destructor
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    // start the writer thread, messages logged before are kept until then
+    void init();
+    // print what is still queued and stop the writer thread
+    void shutdown();
+
+    void setLevel(LogLevel level) { m_Level.store(level, std::memory_order_relaxed); }
+    bool isEnabled(LogLevel level) const { return level >= m_Level.load(std::memory_order_relaxed); }
+    uint64_t getDropped() const { return m_Dropped.load(std::memory_order_relaxed); }
+
+    // queue a message, format must be a string literal with a {} per argument
+    template <typename... Args>
+    void log(LogLevel level, const char* format, const Args&... args)
+    {
+        if (!isEnabled(level))
+            return;
+        uint64_t position;
+        if (!reserve(position))
+            return;
+        LogRecord& record = m_Slots[position % LOG_QUEUE_SIZE].record;
+        record.format = format;
+        record.argCount = 0;
+        record.stringBytes = 0;
+        (record.add(args), ...);
+        publish(position);
+    }
+};
+
+#define LOG_AT_LEVEL(level, ...) \
+    do \
+    { \
+        if constexpr (level >= LEARNOPENGL_LOG_LEVEL) \
+            Logger::Get().log(level, __VA_ARGS__); \
+    } while (0)
+
+#define LOG_TRACE(...) LOG_AT_LEVEL(LOG_LEVEL_TRACE, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT_LEVEL(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT_LEVEL(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT_LEVEL(LOG_LEVEL_WARNING, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT_LEVEL(LOG_LEVEL_ERROR, __VA_ARGS__)
@@ -0,0 +1,118 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : m_Data(NULL), m_Size(0)
+#ifdef _WIN32
+    , m_File(NULL), m_Mapping(NULL)
+#else
+    , m_FD(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path)
+// map path into memory, false if it can't be opened (an empty file maps to size 0 and data NULL)
+{
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+    m_File = file;
+    m_Size = (std::size_t)size.QuadPart;
+    if (m_Size == 0)
+        return true;
+    m_Mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_Mapping)
+        m_Data = (const unsigned char*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    m_FD = ::open(path.c_str(), O_RDONLY);
+    if (m_FD < 0)
+        return false;
+    struct stat info;
+    if (fstat(m_FD, &info) != 0)
+    {
+        close();
+        return false;
+    }
+    m_Size = (std::size_t)info.st_size;
+    if (m_Size == 0)
+        return true;
+    void* data = mmap(NULL, m_Size, PROT_READ, MAP_PRIVATE, m_FD, 0);
+    if (data != MAP_FAILED)
+    {
+        m_Data = (const unsigned char*)data;
+        // the whole file is about to be read, let the kernel read ahead
+        madvise(data, m_Size, MADV_WILLNEED);
+    }
+#endif
+    if (!m_Data)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (m_Data)
+        UnmapViewOfFile(m_Data);
+    if (m_Mapping)
+        CloseHandle((HANDLE)m_Mapping);
+    if (m_File)
+        CloseHandle((HANDLE)m_File);
+    m_Mapping = NULL;
+    m_File = NULL;
+#else
+    if (m_Data)
+        munmap((void*)m_Data, m_Size);
+    if (m_FD >= 0)
+        ::close(m_FD);
+    m_FD = -1;
+#endif
+    m_Data = NULL;
+    m_Size = 0;
+}
+
+bool MappedFile::isOpen() const
+{
+#ifdef _WIN32
+    return m_File != NULL;
+#else
+    return m_FD >= 0;
+#endif
+}
+
+const unsigned char* MappedFile::data() const
+{
+    return m_Data;
+}
+
+std::size_t MappedFile::size() const
+{
+    return m_Size;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file (mmap on POSIX, MapViewOfFile on Windows)
+class MappedFile
+{
+private:
+    const unsigned char* m_Data;
+    std::size_t m_Size;
+#ifdef _WIN32
+    void* m_File;       // HANDLE
+    void* m_Mapping;    // HANDLE
+#else
+    int m_FD;
+#endif
+
+public:
+    MappedFile();
+    // Destructor unmaps the file
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // map path into memory, false if it can't be opened (an empty file maps to size 0 and data NULL)
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const;
+    const unsigned char* data() const;
+    std::size_t size() const;
+};
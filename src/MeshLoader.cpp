@@ -0,0 +1,1062 @@
+#include "MeshLoader.h"
+#include "GLStateCache.h"
+#include "Json.h"
+#include "MeshSimplifier.h"
+#include "VertexLayout.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Mesh -----------------------------------------------------------------------------------------------------------------
+
+Mesh::Mesh()
+    : m_VAO(0), m_VertexCount(0), m_VertexStride(0), m_IndexCount(0), m_IndexType(GL_UNSIGNED_INT), m_Min(0.0f), m_Max(0.0f), m_TopLeftTexCoords(false)
+{
+}
+
+Mesh::~Mesh()
+// Destructor deletes the VAO and buffers
+{
+    release();
+}
+
+void Mesh::release()
+{
+    GLStateCache& stateCache = GLStateCache::Get();
+    if (m_VAO != 0)
+    {
+        stateCache.forgetVertexArray(m_VAO);
+        glDeleteVertexArrays(1, &m_VAO);
+        m_VAO = 0;
+    }
+    for (unsigned int buffer : m_Buffers)
+    {
+        stateCache.forgetBuffer(buffer);
+        glDeleteBuffers(1, &buffer);
+    }
+    m_Buffers.clear();
+    m_VertexCount = 0;
+    m_VertexStride = 0;
+    m_IndexCount = 0;
+    m_Lods.clear();
+    m_TopLeftTexCoords = false;
+}
+
+float Mesh::getBoundingRadius() const
+// radius of a sphere around the model origin that holds the mesh whatever its rotation
+{
+    return glm::length(glm::max(glm::abs(m_Min), glm::abs(m_Max)));
+}
+
+// OBJ tokenizer ----------------------------------------------------------------------------------------------------------
+
+static const int OBJ_MISSING = INT_MIN;    // corner without texture coordinate or normal
+
+// what one job extracted from its slice of the file
+struct ObjChunk
+{
+    std::vector<float> positions;   // xyz
+    std::vector<float> texcoords;   // uv
+    std::vector<float> normals;     // xyz
+    std::vector<int> corners;       // position, texcoord, normal of every triangle corner, 0-based
+    std::vector<unsigned char> relative; // per corner, bit k: component k was negative in the file and counts from the
+                                         // start of this chunk until the chunk offsets are known
+    std::size_t badLines;
+};
+
+static inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char* skipBlanks(const char* p, const char* end)
+{
+    while (p < end && isBlank(*p))
+        p++;
+    return p;
+}
+
+static double powerOfTen(int exponent)
+{
+    static const double table[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    if (exponent >= 0 && exponent <= 22)
+        return table[exponent];
+    if (exponent < 0 && exponent >= -22)
+        return 1.0 / table[-exponent];
+    return std::pow(10.0, exponent);
+}
+
+static const char* parseFloat(const char* p, const char* end, float& out)
+// [sign] digits [. digits] [e [sign] digits], NULL if there is no number. Much faster than strtod, and locale independent
+{
+    p = skipBlanks(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    bool any = false;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, any = true)
+    {
+        if (digits < 18)
+        {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            if (mantissa)
+                digits++;
+        }
+        else
+            exponent++;
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, any = true)
+        {
+            if (digits < 18)
+            {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                if (mantissa)
+                    digits++;
+                exponent--;
+            }
+        }
+    }
+    if (!any)
+        return NULL;
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            negativeExponent = *q++ == '-';
+        if (q < end && *q >= '0' && *q <= '9')
+        {
+            int value = 0;
+            for (; q < end && *q >= '0' && *q <= '9'; q++)
+                value = value < 10000 ? value * 10 + (*q - '0') : value;
+            exponent += negativeExponent ? -value : value;
+            p = q;
+        }
+    }
+    double value = (double)mantissa * powerOfTen(exponent);
+    out = (float)(negative ? -value : value);
+    return p;
+}
+
+static const char* parseInt(const char* p, const char* end, int& out)
+// [-] digits, NULL if there is no number
+{
+    bool negative = false;
+    if (p < end && *p == '-')
+    {
+        negative = true;
+        p++;
+    }
+    if (p >= end || *p < '0' || *p > '9')
+        return NULL;
+    int value = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+        value = value < INT_MAX / 10 ? value * 10 + (*p - '0') : value;
+    out = negative ? -value : value;
+    return p;
+}
+
+static bool parseFloats(const char* p, const char* end, float* out, int count)
+{
+    for (int i = 0; i < count; i++)
+        if (!(p = parseFloat(p, end, out[i])))
+            return false;
+    return true;
+}
+
+static bool parseFace(const char* p, const char* end, ObjChunk& chunk, std::vector<int>& polygon, std::vector<unsigned char>& polygonRelative)
+// "f v/vt/vn ..." (vt and vn optional), fan-triangulated into chunk.corners
+{
+    const int counts[3] = { (int)(chunk.positions.size() / 3), (int)(chunk.texcoords.size() / 2), (int)(chunk.normals.size() / 3) };
+    polygon.clear();
+    polygonRelative.clear();
+    for (;;)
+    {
+        p = skipBlanks(p, end);
+        if (p >= end || *p == '#')
+            break;
+        int corner[3] = { OBJ_MISSING, OBJ_MISSING, OBJ_MISSING };
+        unsigned char relative = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            if (k > 0)
+            {
+                if (p < end && *p == '/')
+                    p++;
+                else
+                    break;
+            }
+            int value;
+            const char* next = parseInt(p, end, value);
+            if (!next)
+                continue;   // v//vn
+            p = next;
+            if (value > 0)
+                corner[k] = value - 1;
+            else if (value < 0)
+            {
+                corner[k] = counts[k] + value;
+                relative |= (unsigned char)(1 << k);
+            }
+            else
+                return false;
+        }
+        if (corner[0] == OBJ_MISSING || (p < end && !isBlank(*p)))
+            return false;
+        polygon.insert(polygon.end(), corner, corner + 3);
+        polygonRelative.push_back(relative);
+    }
+
+    std::size_t cornerCount = polygonRelative.size();
+    if (cornerCount < 3)
+        return false;
+    for (std::size_t i = 1; i + 1 < cornerCount; i++)
+    {
+        const std::size_t fan[3] = { 0, i, i + 1 };
+        for (std::size_t c : fan)
+        {
+            chunk.corners.insert(chunk.corners.end(), polygon.begin() + 3 * c, polygon.begin() + 3 * c + 3);
+            chunk.relative.push_back(polygonRelative[c]);
+        }
+    }
+    return true;
+}
+
+static void tokenizeOBJ(const char* p, const char* end, ObjChunk& chunk)
+// read the v, vt, vn and f lines of [p, end), everything else (groups, materials, comments) is skipped
+{
+    chunk.badLines = 0;
+    std::vector<int> polygon;
+    std::vector<unsigned char> polygonRelative;
+    while (p < end)
+    {
+        p = skipBlanks(p, end);
+        const char* lineEnd = (const char*)memchr(p, '\n', (std::size_t)(end - p));
+        if (!lineEnd)
+            lineEnd = end;
+
+        std::size_t length = (std::size_t)(lineEnd - p);
+        bool ok = true;
+        if (length >= 2 && p[0] == 'v' && isBlank(p[1]))
+        {
+            float xyz[3];
+            ok = parseFloats(p + 2, lineEnd, xyz, 3);
+            if (ok)
+                chunk.positions.insert(chunk.positions.end(), xyz, xyz + 3);
+        }
+        else if (length >= 3 && p[0] == 'v' && p[1] == 't' && isBlank(p[2]))
+        {
+            float uv[2];
+            ok = parseFloats(p + 3, lineEnd, uv, 2);
+            if (ok)
+                chunk.texcoords.insert(chunk.texcoords.end(), uv, uv + 2);
+        }
+        else if (length >= 3 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2]))
+        {
+            float xyz[3];
+            ok = parseFloats(p + 3, lineEnd, xyz, 3);
+            if (ok)
+                chunk.normals.insert(chunk.normals.end(), xyz, xyz + 3);
+        }
+        else if (length >= 2 && p[0] == 'f' && isBlank(p[1]))
+            ok = parseFace(p + 2, lineEnd, chunk, polygon, polygonRelative);
+
+        if (!ok)
+            chunk.badLines++;
+        p = lineEnd + 1;
+    }
+}
+
+// vertices are merged when all three indices match
+struct ObjCornerKey
+{
+    int position;
+    int texcoord;
+    int normal;
+
+    bool operator==(const ObjCornerKey& other) const
+    {
+        return position == other.position && texcoord == other.texcoord && normal == other.normal;
+    }
+};
+
+// open addressing table from corner to vertex index, a lot faster than std::unordered_map for millions of small keys
+class ObjVertexTable
+{
+private:
+    struct Slot
+    {
+        ObjCornerKey key;
+        unsigned int vertex;    // UINT_MAX for empty slots
+    };
+    std::vector<Slot> m_Slots;
+    std::size_t m_Mask;
+    std::size_t m_Count;
+
+    static std::size_t hash(const ObjCornerKey& key)
+    {
+        uint64_t hash = (uint64_t)(uint32_t)key.position * 0x9E3779B97F4A7C15ull ^ (uint64_t)(uint32_t)key.texcoord * 0xC2B2AE3D27D4EB4Full ^
+                        (uint64_t)(uint32_t)key.normal * 0x165667B19E3779F9ull;
+        return (std::size_t)(hash ^ (hash >> 29));
+    }
+
+    void resize(std::size_t size)
+    {
+        std::vector<Slot> old;
+        old.swap(m_Slots);
+        Slot empty = { { 0, 0, 0 }, UINT_MAX };
+        m_Slots.assign(size, empty);
+        m_Mask = size - 1;
+        for (const Slot& slot : old)
+        {
+            if (slot.vertex == UINT_MAX)
+                continue;
+            std::size_t i = hash(slot.key) & m_Mask;
+            while (m_Slots[i].vertex != UINT_MAX)
+                i = (i + 1) & m_Mask;
+            m_Slots[i] = slot;
+        }
+    }
+
+public:
+    // expected: number of vertices we expect, the table grows past it if needed
+    ObjVertexTable(std::size_t expected) : m_Mask(0), m_Count(0)
+    {
+        std::size_t size = 16;
+        while (size < expected * 2)
+            size *= 2;
+        resize(size);
+    }
+
+    // vertex of key, added as vertex next if it is new
+    unsigned int insert(const ObjCornerKey& key, unsigned int next, bool& added)
+    {
+        // at most half full, probes stay short
+        if (2 * (m_Count + 1) > m_Slots.size())
+            resize(2 * m_Slots.size());
+        for (std::size_t i = hash(key) & m_Mask;; i = (i + 1) & m_Mask)
+        {
+            Slot& slot = m_Slots[i];
+            if (slot.vertex == UINT_MAX)
+            {
+                slot.key = key;
+                slot.vertex = next;
+                m_Count++;
+                added = true;
+                return next;
+            }
+            if (slot.key == key)
+            {
+                added = false;
+                return slot.vertex;
+            }
+        }
+    }
+};
+
+// MeshLoader -------------------------------------------------------------------------------------------------------------
+
+MeshLoader::MeshLoader(JobSystem& jobs, bool compactVertices)
+    : m_JobSystem(jobs), m_CompactVertices(compactVertices)
+{
+}
+
+static std::vector<MeshLod> buildLods(std::vector<unsigned int>& indices, const void* positions, std::size_t positionStride, std::size_t vertexCount)
+// simplify each level from the previous one and append its indices, until a level would be too small or the simplifier gets stuck
+{
+    MeshLod full = { 0, (unsigned int)indices.size(), 0.0f };
+    std::vector<MeshLod> lods(1, full);
+    if (!positions)
+        return lods;
+    std::vector<unsigned int> level(indices);
+    while (lods.size() < MESH_MAX_LODS)
+    {
+        std::size_t target = (std::size_t)((float)(level.size() / 3) * MESH_LOD_REDUCTION) * 3;
+        if (target / 3 < MESH_LOD_MIN_TRIANGLES)
+            break;
+        float error;
+        std::size_t count = simplifyMesh(level.data(), level.data(), level.size(), positions, positionStride, vertexCount, target,
+                                         std::numeric_limits<float>::max(), &error);
+        // borders and seams are locked, a mesh made mostly of them barely shrinks
+        if ((float)count > (float)level.size() * MESH_LOD_MIN_REDUCTION)
+            break;
+        level.resize(count);
+        optimizeVertexCache(level.data(), level.size(), vertexCount);
+        // every level is simplified from the one before, so the errors add up
+        MeshLod lod = { (unsigned int)indices.size(), (unsigned int)count, lods.back().error + error };
+        lods.push_back(lod);
+        indices.insert(indices.end(), level.begin(), level.end());
+    }
+    return lods;
+}
+
+static bool dropDegenerateTriangles(std::vector<unsigned int>& indices, const void* positions, std::size_t positionStride, const std::string& path)
+// remove the triangles that draw nothing before they reach the optimizers, false if none are left
+{
+    std::size_t count = removeDegenerateTriangles(indices.data(), indices.size(), positions, positionStride);
+    if (count < indices.size())
+        std::cout << "Warning! " << (indices.size() - count + 2) / 3 << " degenerate triangles skipped in " << path << std::endl;
+    indices.resize(count);
+    if (count == 0)
+    {
+        std::cout << "ERROR::MESH::NO_TRIANGLES " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static void optimizeTriangleOrder(std::vector<unsigned int>& indices, std::size_t vertexCount, const void* positions, std::size_t positionStride,
+                                  MeshLoadStats& stats)
+// reorder triangles for the vertex cache, then for overdraw if positions are given, and record the cache efficiency before and after
+{
+    stats.cacheBefore = analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+    optimizeVertexCache(indices.data(), indices.size(), vertexCount);
+    if (positions)
+        optimizeOverdraw(indices.data(), indices.size(), positions, positionStride, vertexCount);
+    stats.cacheAfter = analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+}
+
+bool MeshLoader::load(const std::string& path, Mesh& out, MeshLoadStats* stats)
+// load path (.obj, .gltf or .glb) into out and print the parse throughput and vertex cache efficiency, needs a current context.
+// For glTF the first primitive of the first mesh is loaded
+{
+    MeshLoadStats localStats = {};
+    MeshLoadStats& result = stats ? *stats : localStats;
+    result = MeshLoadStats();
+
+    MappedFile file;
+    if (!file.open(path))
+    {
+        std::cout << "ERROR::MESH::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+        return false;
+    }
+
+    std::string extension = path.substr(path.find_last_of('.') == std::string::npos ? path.size() : path.find_last_of('.'));
+    for (char& c : extension)
+        c = (char)tolower((unsigned char)c);
+
+    out.release();
+    bool loaded;
+    if (extension == ".obj")
+        loaded = loadOBJ(file, path, out, result);
+    else if (extension == ".gltf" || extension == ".glb")
+        loaded = loadGLTF(file, path, extension == ".glb", out, result);
+    else
+    {
+        std::cout << "ERROR::MESH::UNKNOWN_FORMAT " << path << std::endl;
+        return false;
+    }
+    // the loaders bind directly
+    GLStateCache::Get().invalidate();
+    if (!loaded)
+    {
+        out.release();
+        return false;
+    }
+
+    double parsedMB = (double)result.parsedBytes / (1024.0 * 1024.0);
+    double uploadedMB = (double)result.uploadedBytes / (1024.0 * 1024.0);
+    std::cout << "Loaded mesh " << path << ": " << out.getVertexCount() << " vertices, " << out.getIndexCount() / 3 << " triangles, "
+              << parsedMB << " MB parsed in " << result.parseMs << " ms (" << (result.parseMs > 0.0 ? parsedMB * 1000.0 / result.parseMs : 0.0)
+              << " MB/s), ";
+    if (result.buildMs > 0.0)
+        std::cout << "indexed in " << result.buildMs << " ms, ";
+    std::cout << "optimized in " << result.optimizeMs << " ms (ACMR " << result.cacheBefore.acmr << " -> " << result.cacheAfter.acmr
+              << ", ATVR " << result.cacheBefore.atvr << " -> " << result.cacheAfter.atvr << "), ";
+    const std::vector<MeshLod>& lods = out.getLods();
+    std::cout << lods.size() << " LODs down to " << lods.back().indexCount / 3 << " triangles (error " << lods.back().error << ") in "
+              << result.lodMs << " ms, ";
+    std::cout << uploadedMB << " MB uploaded in " << result.uploadMs << " ms, " << out.getVertexStride() << " bytes per vertex, "
+              << (out.getIndexType() == GL_UNSIGNED_SHORT ? 16 : 32) << "-bit indices" << std::endl;
+    return true;
+}
+
+bool MeshLoader::loadOBJ(const MappedFile& file, const std::string& path, Mesh& out, MeshLoadStats& stats)
+{
+    const char* text = (const char*)file.data();
+    std::size_t size = file.size();
+    stats.parsedBytes = size;
+
+    // 1. tokenize: cut the file into slices at line ends, one job each
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::size_t> bounds(1, 0);
+    while (size - bounds.back() > OBJ_CHUNK_BYTES)
+    {
+        std::size_t from = bounds.back() + OBJ_CHUNK_BYTES;
+        const char* newline = (const char*)memchr(text + from, '\n', size - from);
+        if (!newline)
+            break;
+        bounds.push_back((std::size_t)(newline - text) + 1);
+    }
+    bounds.push_back(size);
+    unsigned int chunkCount = (unsigned int)bounds.size() - 1;
+    std::vector<ObjChunk> chunks(chunkCount);
+    m_JobSystem.parallelFor(0, chunkCount, 1, [&](unsigned int first, unsigned int end)
+    {
+        for (unsigned int c = first; c < end; c++)
+            tokenizeOBJ(text + bounds[c], text + bounds[c + 1], chunks[c]);
+    });
+    stats.parseMs = elapsedMs(start);
+
+    // 2. build: concatenate the attributes, resolve relative indices and merge identical corners into vertices
+    start = std::chrono::steady_clock::now();
+    std::vector<float> positions, texcoords, normals;
+    std::size_t badLines = 0;
+    std::size_t cornerCount = 0;
+    for (const ObjChunk& chunk : chunks)
+    {
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        texcoords.insert(texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+        normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+        badLines += chunk.badLines;
+        cornerCount += chunk.relative.size();
+    }
+    if (badLines > 0)
+        std::cout << "Warning! " << badLines << " malformed lines skipped in " << path << std::endl;
+    const int totals[3] = { (int)(positions.size() / 3), (int)(texcoords.size() / 2), (int)(normals.size() / 3) };
+    if (cornerCount == 0)
+    {
+        std::cout << "ERROR::MESH::NO_TRIANGLES " << path << std::endl;
+        return false;
+    }
+
+    bool hasTexcoords = totals[1] > 0;
+    bool hasNormals = totals[2] > 0;
+    std::vector<unsigned int> indices;
+    indices.reserve(cornerCount);
+    std::vector<ObjCornerKey> vertices;     // corner each vertex is built from
+    // most meshes have about as many vertices as their largest attribute array
+    ObjVertexTable vertexOf(hasTexcoords || hasNormals ? (std::size_t)std::max(totals[0], std::max(totals[1], totals[2])) : 0);
+
+    int bases[3] = { 0, 0, 0 };
+    for (const ObjChunk& chunk : chunks)
+    {
+        for (std::size_t c = 0; c < chunk.relative.size(); c++)
+        {
+            int corner[3];
+            for (int k = 0; k < 3; k++)
+            {
+                corner[k] = chunk.corners[3 * c + k];
+                if (chunk.relative[c] & (1 << k))
+                    corner[k] += bases[k];
+                if (corner[k] != OBJ_MISSING && (corner[k] < 0 || corner[k] >= totals[k]))
+                {
+                    std::cout << "ERROR::MESH::INDEX_OUT_OF_RANGE " << path << std::endl;
+                    return false;
+                }
+            }
+            ObjCornerKey key = { corner[0], hasTexcoords ? corner[1] : OBJ_MISSING, hasNormals ? corner[2] : OBJ_MISSING };
+            if (!hasTexcoords && !hasNormals)
+            {
+                // positions only: every position is a vertex, no merging needed
+                indices.push_back((unsigned int)key.position);
+                continue;
+            }
+            bool added;
+            indices.push_back(vertexOf.insert(key, (unsigned int)vertices.size(), added));
+            if (added)
+                vertices.push_back(key);
+        }
+        bases[0] += (int)(chunk.positions.size() / 3);
+        bases[1] += (int)(chunk.texcoords.size() / 2);
+        bases[2] += (int)(chunk.normals.size() / 3);
+    }
+    if (!hasTexcoords && !hasNormals)
+        for (int i = 0; i < totals[0]; i++)
+            vertices.push_back(ObjCornerKey{ i, OBJ_MISSING, OBJ_MISSING });
+
+    out.m_Min = glm::vec3(1e30f);
+    out.m_Max = glm::vec3(-1e30f);
+    for (std::size_t i = 0; i < positions.size(); i += 3)
+    {
+        glm::vec3 position(positions[i], positions[i + 1], positions[i + 2]);
+        out.m_Min = glm::min(out.m_Min, position);
+        out.m_Max = glm::max(out.m_Max, position);
+    }
+    stats.buildMs = elapsedMs(start);
+
+    // 3. optimize: triangle order for the vertex cache and overdraw, then vertex order for fetching
+    start = std::chrono::steady_clock::now();
+    std::vector<glm::vec3> vertexPositions(vertices.size());
+    for (std::size_t i = 0; i < vertices.size(); i++)
+        vertexPositions[i] = glm::vec3(positions[3 * (std::size_t)vertices[i].position], positions[3 * (std::size_t)vertices[i].position + 1],
+                                       positions[3 * (std::size_t)vertices[i].position + 2]);
+    if (!dropDegenerateTriangles(indices, vertexPositions.data(), sizeof(glm::vec3), path))
+        return false;
+    optimizeTriangleOrder(indices, vertices.size(), vertexPositions.data(), sizeof(glm::vec3), stats);
+    std::vector<unsigned int> remap;
+    optimizeVertexFetch(indices.data(), indices.size(), vertices.size(), remap);
+    std::vector<ObjCornerKey> fetchOrder(vertices.size());
+    std::vector<glm::vec3> fetchOrderPositions(vertices.size());
+    for (std::size_t i = 0; i < vertices.size(); i++)
+    {
+        fetchOrder[remap[i]] = vertices[i];
+        fetchOrderPositions[remap[i]] = vertexPositions[i];
+    }
+    vertices.swap(fetchOrder);
+    vertexPositions.swap(fetchOrderPositions);
+    stats.optimizeMs = elapsedMs(start);
+
+    // 4. simplify: the levels of detail are appended to the index list
+    start = std::chrono::steady_clock::now();
+    out.m_Lods = buildLods(indices, vertexPositions.data(), sizeof(glm::vec3), vertices.size());
+    stats.lodMs = elapsedMs(start);
+
+    // 5. upload: interleaved position [normal] [texcoord] in the layout picked below, converted straight into the mapped buffers
+    start = std::chrono::steady_clock::now();
+    glm::vec3 extent = glm::max(glm::abs(out.m_Min), glm::abs(out.m_Max));
+    bool halfPositions = m_CompactVertices && glm::max(extent.x, glm::max(extent.y, extent.z)) <= MESH_HALF_POSITION_LIMIT;
+    VertexLayout layout;
+    layout.add(MESH_ATTRIB_POSITION, halfPositions ? VERTEX_HALF4 : VERTEX_FLOAT3);
+    if (hasNormals)
+        layout.add(MESH_ATTRIB_NORMAL, m_CompactVertices ? VERTEX_OCTAHEDRAL : VERTEX_FLOAT3);
+    if (hasTexcoords)
+        layout.add(MESH_ATTRIB_TEXCOORD, m_CompactVertices ? VERTEX_HALF2 : VERTEX_FLOAT2);
+    int normalAttribute = layout.find(MESH_ATTRIB_NORMAL);
+    int texcoordAttribute = layout.find(MESH_ATTRIB_TEXCOORD);
+    std::size_t vertexBytes = vertices.size() * layout.getStride();
+    GLenum indexType = chooseIndexType(vertices.size());
+    std::size_t indexBytes = indices.size() * getIndexSize(indexType);
+
+    unsigned int buffers[2];
+    glGenVertexArrays(1, &out.m_VAO);
+    glGenBuffers(2, buffers);
+    out.m_Buffers.assign(buffers, buffers + 2);
+    glBindVertexArray(out.m_VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexBytes, NULL, GL_STATIC_DRAW);
+    unsigned char* destination = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, (GLsizeiptr)vertexBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!destination)
+    {
+        std::cout << "ERROR::MESH::BUFFER_MAPPING_FAILED " << path << std::endl;
+        glBindVertexArray(0);
+        return false;
+    }
+    const float zero[3] = { 0.0f, 0.0f, 0.0f };
+    for (const ObjCornerKey& vertex : vertices)
+    {
+        layout.write(destination, 0, &positions[3 * (std::size_t)vertex.position], 3);
+        if (normalAttribute >= 0)
+            layout.write(destination, (unsigned int)normalAttribute, vertex.normal != OBJ_MISSING ? &normals[3 * (std::size_t)vertex.normal] : zero, 3);
+        if (texcoordAttribute >= 0)
+            layout.write(destination, (unsigned int)texcoordAttribute, vertex.texcoord != OBJ_MISSING ? &texcoords[2 * (std::size_t)vertex.texcoord] : zero, 2);
+        destination += layout.getStride();
+    }
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    layout.apply();
+
+    // OBJ has no vertex colors: a disabled attribute reads the current generic value (context state, not VAO state), draw untinted
+    glVertexAttrib4f(MESH_ATTRIB_COLOR, 1.0f, 1.0f, 1.0f, 1.0f);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    if (indexType == GL_UNSIGNED_INT)
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexBytes, indices.data(), GL_STATIC_DRAW);
+    else
+    {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexBytes, NULL, GL_STATIC_DRAW);
+        void* mappedIndices = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, (GLsizeiptr)indexBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (!mappedIndices)
+        {
+            std::cout << "ERROR::MESH::BUFFER_MAPPING_FAILED " << path << std::endl;
+            glBindVertexArray(0);
+            return false;
+        }
+        writeIndices(indices.data(), indices.size(), indexType, mappedIndices);
+        glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+    }
+    glBindVertexArray(0);
+    stats.uploadMs = elapsedMs(start);
+    stats.uploadedBytes = vertexBytes + indexBytes;
+
+    out.m_VertexCount = (unsigned int)vertices.size();
+    out.m_VertexStride = layout.getStride();
+    out.m_IndexCount = out.m_Lods[0].indexCount;
+    out.m_IndexType = indexType;
+    return true;
+}
+
+// glTF -------------------------------------------------------------------------------------------------------------------
+
+static const uint32_t GLB_MAGIC = 0x46546C67;       // "glTF"
+static const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;  // "JSON"
+static const uint32_t GLB_CHUNK_BIN = 0x004E4942;   // "BIN\0"
+
+static uint32_t readU32(const unsigned char* p)
+{
+    // glb is little endian, like every platform we build for
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// data of a glTF buffer: a mapped .bin file or the BIN chunk of a .glb
+struct GltfBuffer
+{
+    const unsigned char* data;
+    std::size_t size;
+};
+
+// accessor resolved down to its buffer view
+struct GltfAccessor
+{
+    const unsigned char* viewData;  // start of the buffer view
+    std::size_t viewLength;
+    int view;
+    std::size_t offset;             // of the first element in the view
+    GLenum componentType;           // glTF uses the GL enums (GL_FLOAT, GL_UNSIGNED_SHORT, ...)
+    int components;
+    bool normalized;
+    std::size_t count;
+    std::size_t stride;             // 0 when tightly packed
+};
+
+static std::size_t componentSize(GLenum type)
+{
+    switch (type)
+    {
+    case GL_BYTE: case GL_UNSIGNED_BYTE: return 1;
+    case GL_SHORT: case GL_UNSIGNED_SHORT: return 2;
+    case GL_UNSIGNED_INT: case GL_FLOAT: return 4;
+    default: return 0;
+    }
+}
+
+static bool readAccessor(const JsonValue& document, const std::vector<GltfBuffer>& buffers, int index, GltfAccessor& out, std::string& error)
+{
+    const JsonValue* accessors = document.find("accessors");
+    const JsonValue* views = document.find("bufferViews");
+    if (!accessors || !views || index < 0 || (std::size_t)index >= accessors->size())
+    {
+        error = "missing accessor";
+        return false;
+    }
+    const JsonValue& accessor = (*accessors)[(std::size_t)index];
+    if (accessor.find("sparse") || !accessor.find("bufferView"))
+    {
+        error = "sparse accessors and accessors without a buffer view are not supported";
+        return false;
+    }
+
+    static const char* types[] = { "SCALAR", "VEC2", "VEC3", "VEC4" };
+    std::string type = accessor.getString("type", "");
+    out.components = 0;
+    for (int i = 0; i < 4; i++)
+        if (type == types[i])
+            out.components = i + 1;
+    out.componentType = (GLenum)accessor.getNumber("componentType", 0);
+    out.count = (std::size_t)accessor.getNumber("count", 0);
+    out.offset = (std::size_t)accessor.getNumber("byteOffset", 0);
+    const JsonValue* normalized = accessor.find("normalized");
+    out.normalized = normalized && normalized->getType() == JSON_BOOL && normalized->asBool();
+    if (out.components == 0 || componentSize(out.componentType) == 0)
+    {
+        error = "unsupported accessor type";
+        return false;
+    }
+
+    out.view = (int)accessor.getNumber("bufferView", -1);
+    if (out.view < 0 || (std::size_t)out.view >= views->size())
+    {
+        error = "missing buffer view";
+        return false;
+    }
+    const JsonValue& view = (*views)[(std::size_t)out.view];
+    int buffer = (int)view.getNumber("buffer", -1);
+    std::size_t viewOffset = (std::size_t)view.getNumber("byteOffset", 0);
+    out.viewLength = (std::size_t)view.getNumber("byteLength", 0);
+    out.stride = (std::size_t)view.getNumber("byteStride", 0);
+    if (buffer < 0 || (std::size_t)buffer >= buffers.size() || viewOffset + out.viewLength > buffers[(std::size_t)buffer].size)
+    {
+        error = "buffer view out of range";
+        return false;
+    }
+    out.viewData = buffers[(std::size_t)buffer].data + viewOffset;
+
+    std::size_t elementSize = componentSize(out.componentType) * (std::size_t)out.components;
+    std::size_t step = out.stride ? out.stride : elementSize;
+    if (out.count > 0 && out.offset + step * (out.count - 1) + elementSize > out.viewLength)
+    {
+        error = "accessor out of range";
+        return false;
+    }
+    return true;
+}
+
+bool MeshLoader::loadGLTF(const MappedFile& file, const std::string& path, bool binary, Mesh& out, MeshLoadStats& stats)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const char* json = (const char*)file.data();
+    std::size_t jsonLength = file.size();
+    GltfBuffer glbBuffer = { NULL, 0 };
+    if (binary)
+    {
+        // 12 byte header, then chunks (length, type, data): JSON first, BIN optional
+        const unsigned char* data = file.data();
+        std::size_t size = file.size();
+        if (size < 20 || readU32(data) != GLB_MAGIC || readU32(data + 4) != 2 || readU32(data + 16) != GLB_CHUNK_JSON ||
+            20 + (std::size_t)readU32(data + 12) > size)
+        {
+            std::cout << "ERROR::MESH::INVALID_GLB " << path << std::endl;
+            return false;
+        }
+        json = (const char*)data + 20;
+        jsonLength = readU32(data + 12);
+        std::size_t binOffset = 20 + ((jsonLength + 3) & ~(std::size_t)3);
+        if (binOffset + 8 <= size && readU32(data + binOffset + 4) == GLB_CHUNK_BIN && binOffset + 8 + readU32(data + binOffset) <= size)
+        {
+            glbBuffer.data = data + binOffset + 8;
+            glbBuffer.size = readU32(data + binOffset);
+        }
+    }
+
+    JsonValue document;
+    std::string error;
+    if (!JsonValue::parse(json, jsonLength, document, error))
+    {
+        std::cout << "ERROR::MESH::GLTF_PARSE_FAILED " << path << ": " << error << std::endl;
+        return false;
+    }
+    stats.parsedBytes = jsonLength;
+    stats.parseMs = elapsedMs(start);
+
+    // map the buffers, relative to the .gltf file
+    start = std::chrono::steady_clock::now();
+    std::string directory = path.find_last_of("/\\") == std::string::npos ? "" : path.substr(0, path.find_last_of("/\\") + 1);
+    std::vector<std::unique_ptr<MappedFile>> mappedFiles;
+    std::vector<GltfBuffer> buffers;
+    const JsonValue* bufferList = document.find("buffers");
+    for (std::size_t i = 0; bufferList && i < bufferList->size(); i++)
+    {
+        const JsonValue& buffer = (*bufferList)[i];
+        std::size_t byteLength = (std::size_t)buffer.getNumber("byteLength", 0);
+        std::string uri = buffer.getString("uri", "");
+        GltfBuffer mapped = { NULL, 0 };
+        if (uri.empty() && binary && i == 0)
+            mapped = glbBuffer;
+        else if (uri.compare(0, 5, "data:") == 0)
+        {
+            std::cout << "ERROR::MESH::GLTF_EMBEDDED_BUFFERS_NOT_SUPPORTED " << path << std::endl;
+            return false;
+        }
+        else if (!uri.empty())
+        {
+            mappedFiles.push_back(std::unique_ptr<MappedFile>(new MappedFile()));
+            if (!mappedFiles.back()->open(directory + uri))
+            {
+                std::cout << "ERROR::MESH::FILE_NOT_SUCCESFULLY_READ " << directory + uri << std::endl;
+                return false;
+            }
+            mapped.data = mappedFiles.back()->data();
+            mapped.size = mappedFiles.back()->size();
+        }
+        if (mapped.size < byteLength)
+        {
+            std::cout << "ERROR::MESH::GLTF_BUFFER_TOO_SMALL " << path << " (buffer " << i << ")" << std::endl;
+            return false;
+        }
+        buffers.push_back(mapped);
+    }
+
+    const JsonValue* meshes = document.find("meshes");
+    const JsonValue* primitives = meshes && meshes->size() > 0 ? (*meshes)[0].find("primitives") : NULL;
+    if (!primitives || primitives->size() == 0)
+    {
+        std::cout << "ERROR::MESH::GLTF_NO_MESH " << path << std::endl;
+        return false;
+    }
+    if (primitives->size() > 1 || meshes->size() > 1)
+        std::cout << "Warning! " << path << ": only the first primitive of the first mesh is loaded" << std::endl;
+    const JsonValue& primitive = (*primitives)[0];
+    const JsonValue* attributes = primitive.find("attributes");
+    if ((int)primitive.getNumber("mode", 4) != 4 || !attributes || !attributes->find("POSITION"))
+    {
+        std::cout << "ERROR::MESH::GLTF_UNSUPPORTED_PRIMITIVE " << path << " (needs triangles with positions)" << std::endl;
+        return false;
+    }
+
+    glGenVertexArrays(1, &out.m_VAO);
+    glBindVertexArray(out.m_VAO);
+
+    // one vertex buffer per buffer view, uploaded from the mapping as is. Attributes sharing a view (interleaved) share the buffer
+    struct Attribute
+    {
+        const char* name;
+        MeshAttribute location;
+    };
+    const Attribute wanted[] = { { "POSITION", MESH_ATTRIB_POSITION }, { "NORMAL", MESH_ATTRIB_NORMAL },
+                                 { "TEXCOORD_0", MESH_ATTRIB_TEXCOORD }, { "COLOR_0", MESH_ATTRIB_COLOR } };
+    std::unordered_map<int, unsigned int> viewBuffers;
+    bool hasColor = false;
+    const unsigned char* positionData = NULL;  // float positions in the mapping for the overdraw sort, NULL if quantized
+    std::size_t positionStride = 0;
+    for (const Attribute& attribute : wanted)
+    {
+        const JsonValue* index = attributes->find(attribute.name);
+        if (!index)
+            continue;
+        int accessorIndex = (int)index->asNumber();
+        GltfAccessor accessor;
+        if (!readAccessor(document, buffers, accessorIndex, accessor, error))
+        {
+            std::cout << "ERROR::MESH::GLTF_INVALID_ACCESSOR " << path << " (" << attribute.name << "): " << error << std::endl;
+            glBindVertexArray(0);
+            return false;
+        }
+        // POSITION comes first and sets the vertex count the indices are checked against, every other attribute must cover it
+        if (attribute.location != MESH_ATTRIB_POSITION && accessor.count < out.m_VertexCount)
+        {
+            std::cout << "ERROR::MESH::GLTF_INVALID_ACCESSOR " << path << " (" << attribute.name << "): " << accessor.count
+                      << " elements, POSITION has " << out.m_VertexCount << std::endl;
+            glBindVertexArray(0);
+            return false;
+        }
+        std::unordered_map<int, unsigned int>::iterator found = viewBuffers.find(accessor.view);
+        unsigned int buffer;
+        if (found == viewBuffers.end())
+        {
+            glGenBuffers(1, &buffer);
+            out.m_Buffers.push_back(buffer);
+            viewBuffers[accessor.view] = buffer;
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)accessor.viewLength, accessor.viewData, GL_STATIC_DRAW);
+            stats.uploadedBytes += accessor.viewLength;
+        }
+        else
+        {
+            buffer = found->second;
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        }
+        // integer attributes are converted to float, normalized or not as the file says
+        glVertexAttribPointer(attribute.location, accessor.components, accessor.componentType, accessor.normalized ? GL_TRUE : GL_FALSE,
+                              (GLsizei)accessor.stride, (void*)accessor.offset);
+        glEnableVertexAttribArray(attribute.location);
+
+        if (attribute.location == MESH_ATTRIB_POSITION)
+        {
+            out.m_VertexCount = (unsigned int)accessor.count;
+            out.m_VertexStride = (unsigned int)(accessor.stride ? accessor.stride : accessor.components * componentSize(accessor.componentType));
+            if (accessor.componentType == GL_FLOAT && accessor.components == 3)
+            {
+                positionData = accessor.viewData + accessor.offset;
+                positionStride = out.m_VertexStride;
+            }
+            // bounds are required by the spec for positions
+            const JsonValue& positionAccessor = (*document.find("accessors"))[(std::size_t)accessorIndex];
+            const JsonValue* min = positionAccessor.find("min");
+            const JsonValue* max = positionAccessor.find("max");
+            if (min && max && min->size() >= 3 && max->size() >= 3)
+            {
+                out.m_Min = glm::vec3((float)(*min)[0].asNumber(), (float)(*min)[1].asNumber(), (float)(*min)[2].asNumber());
+                out.m_Max = glm::vec3((float)(*max)[0].asNumber(), (float)(*max)[1].asNumber(), (float)(*max)[2].asNumber());
+            }
+        }
+        if (attribute.location == MESH_ATTRIB_COLOR)
+            hasColor = true;
+    }
+    if (!hasColor)
+        glVertexAttrib4f(MESH_ATTRIB_COLOR, 1.0f, 1.0f, 1.0f, 1.0f);
+
+    // indices: the accessor's range is reordered and converted to the smallest type that fits
+    unsigned int indexBuffer;
+    glGenBuffers(1, &indexBuffer);
+    out.m_Buffers.push_back(indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    const JsonValue* indices = primitive.find("indices");
+    if (indices)
+    {
+        GltfAccessor accessor;
+        if (!readAccessor(document, buffers, (int)indices->asNumber(), accessor, error) || accessor.components != 1 ||
+            !(accessor.componentType == GL_UNSIGNED_BYTE || accessor.componentType == GL_UNSIGNED_SHORT || accessor.componentType == GL_UNSIGNED_INT))
+        {
+            std::cout << "ERROR::MESH::GLTF_INVALID_INDICES " << path << ": " << error << std::endl;
+            glBindVertexArray(0);
+            return false;
+        }
+        // indices are widened to 32 bits for the optimizer, the mapping may be unaligned so they are read bytewise
+        std::vector<unsigned int> wide(accessor.count);
+        const unsigned char* source = accessor.viewData + accessor.offset;
+        std::size_t size = componentSize(accessor.componentType);
+        for (std::size_t i = 0; i < accessor.count; i++)
+        {
+            if (size == 1)
+                wide[i] = source[i];
+            else if (size == 2)
+            {
+                unsigned short value;
+                memcpy(&value, source + 2 * i, sizeof(value));
+                wide[i] = value;
+            }
+            else
+                memcpy(&wide[i], source + 4 * i, sizeof(unsigned int));
+            if (wide[i] >= out.m_VertexCount)
+            {
+                std::cout << "ERROR::MESH::GLTF_INVALID_INDICES " << path << ": index out of range" << std::endl;
+                glBindVertexArray(0);
+                return false;
+            }
+        }
+        std::chrono::steady_clock::time_point optimizeStart = std::chrono::steady_clock::now();
+        if (!dropDegenerateTriangles(wide, positionData, positionStride, path))
+        {
+            glBindVertexArray(0);
+            return false;
+        }
+        // the vertex buffers are uploaded from the mapping as they are, so only the triangle order is optimized
+        optimizeTriangleOrder(wide, out.m_VertexCount, positionData, positionStride, stats);
+        stats.optimizeMs = elapsedMs(optimizeStart);
+        std::chrono::steady_clock::time_point lodStart = std::chrono::steady_clock::now();
+        out.m_Lods = buildLods(wide, positionData, positionStride, out.m_VertexCount);
+        stats.lodMs = elapsedMs(lodStart);
+
+        // exporters often write 32-bit indices for small meshes, those are halved. 8-bit ones are widened, they are slow on some GPUs
+        GLenum indexType = chooseIndexType(out.m_VertexCount);
+        std::vector<unsigned char> data(wide.size() * getIndexSize(indexType));
+        writeIndices(wide.data(), wide.size(), indexType, data.data());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)data.size(), data.data(), GL_STATIC_DRAW);
+        stats.uploadedBytes += data.size();
+        out.m_IndexCount = out.m_Lods[0].indexCount;
+        out.m_IndexType = indexType;
+    }
+    else
+    {
+        // not indexed: every three vertices are a triangle, there is no reuse to optimize
+        std::vector<unsigned int> sequence(out.m_VertexCount);
+        for (unsigned int i = 0; i < out.m_VertexCount; i++)
+            sequence[i] = i;
+        stats.cacheBefore = stats.cacheAfter = analyzeVertexCache(sequence.data(), sequence.size(), sequence.size());
+        out.m_Lods = buildLods(sequence, NULL, 0, sequence.size());
+        GLenum indexType = chooseIndexType(sequence.size());
+        std::vector<unsigned char> data(sequence.size() * getIndexSize(indexType));
+        writeIndices(sequence.data(), sequence.size(), indexType, data.data());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)data.size(), data.data(), GL_STATIC_DRAW);
+        stats.uploadedBytes += data.size();
+        out.m_IndexCount = out.m_VertexCount;
+        out.m_IndexType = indexType;
+    }
+    glBindVertexArray(0);
+    stats.uploadMs = elapsedMs(start) - stats.optimizeMs - stats.lodMs;
+    out.m_TopLeftTexCoords = true;
+    return true;
+}
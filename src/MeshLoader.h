@@ -0,0 +1,118 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+const std::size_t OBJ_CHUNK_BYTES = 1 << 20;   // OBJ text tokenized per job, cut at line ends
+const unsigned int MESH_MAX_LODS = 8;           // levels of detail per mesh, including the full one
+const float MESH_LOD_REDUCTION = 0.5f;          // each level aims for this fraction of the previous level's triangles
+const float MESH_LOD_MIN_REDUCTION = 0.9f;      // a level that keeps more than this fraction is not worth it, the chain ends
+const unsigned int MESH_LOD_MIN_TRIANGLES = 64; // no levels smaller than this
+const float MESH_HALF_POSITION_LIMIT = 16.0f;   // OBJ positions are stored as halves only if the mesh fits in this many units
+                                                // around its origin: half keeps 11 bits, so steps stay below 1/128 unit
+
+// vertex attribute locations shared by every mesh and shader.vs (3 is the per-instance object index, see InstancedRenderer)
+enum MeshAttribute
+{
+    MESH_ATTRIB_POSITION = 0,
+    MESH_ATTRIB_COLOR = 1,
+    MESH_ATTRIB_TEXCOORD = 2,
+    MESH_ATTRIB_NORMAL = 4
+};
+
+// one level of detail: a range of the mesh's index buffer, all levels share the vertices
+struct MeshLod
+{
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    float error;    // how far the surface may be from the full detail mesh, in model units
+};
+
+// Indexed triangle mesh in GPU memory: a VAO with its vertex and element buffers
+class Mesh
+{
+private:
+    friend class MeshLoader;
+    unsigned int m_VAO;
+    std::vector<unsigned int> m_Buffers;
+    unsigned int m_VertexCount;
+    unsigned int m_VertexStride;    // bytes per vertex of the first vertex buffer
+    unsigned int m_IndexCount;
+    GLenum m_IndexType;
+    std::vector<MeshLod> m_Lods;    // [0] is the full mesh
+    glm::vec3 m_Min;    // bounds in model space
+    glm::vec3 m_Max;
+    bool m_TopLeftTexCoords;
+
+public:
+    Mesh();
+    // Destructor deletes the VAO and buffers
+    ~Mesh();
+
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    void release();
+
+    bool isValid() const { return m_VAO != 0; }
+    unsigned int getVAO() const { return m_VAO; }
+    unsigned int getVertexCount() const { return m_VertexCount; }
+    unsigned int getVertexStride() const { return m_VertexStride; }
+    unsigned int getIndexCount() const { return m_IndexCount; }
+    GLenum getIndexType() const { return m_IndexType; }
+    // levels of detail from full to coarsest, see LodSelector
+    const std::vector<MeshLod>& getLods() const { return m_Lods; }
+    const glm::vec3& getMin() const { return m_Min; }
+    const glm::vec3& getMax() const { return m_Max; }
+    // texture coordinates have their origin at the top left (glTF), v has to be flipped for textures loaded the OpenGL way
+    bool hasTopLeftTexCoords() const { return m_TopLeftTexCoords; }
+    // radius of a sphere around the model origin that holds the mesh whatever its rotation
+    float getBoundingRadius() const;
+};
+
+// timings of MeshLoader::load()
+struct MeshLoadStats
+{
+    std::size_t parsedBytes;    // OBJ text or glTF JSON
+    std::size_t uploadedBytes;  // vertex and index data
+    double parseMs;             // tokenizing OBJ text or parsing glTF JSON
+    double buildMs;             // OBJ only: resolving indices and merging vertices
+    double optimizeMs;          // reordering triangles and vertices, see MeshOptimizer.h
+    double lodMs;               // simplifying the levels of detail, see MeshSimplifier.h
+    double uploadMs;
+    VertexCacheStats cacheBefore;   // index order as in the file
+    VertexCacheStats cacheAfter;
+};
+
+// Loads meshes from OBJ and glTF 2.0 (.gltf with external .bin buffers, or .glb) files.
+// glTF buffers are memory mapped and uploaded straight from the mapping: the vertex attributes are used in the
+// file's own layout, nothing is converted or copied. OBJ text is tokenized in parallel on the job system,
+// one OBJ_CHUNK_BYTES slice per job, and the interleaved vertices are written directly into the mapped VBO, in a compact
+// layout unless disabled: half positions and texture coordinates, octahedral normals. Meshes with at most 65536
+// vertices get 16-bit indices. Triangles are reordered for the vertex cache and overdraw at import, OBJ vertices
+// also for fetching. A chain of levels of detail is simplified from the mesh and stored after it in the index buffer.
+class MeshLoader
+{
+private:
+    JobSystem& m_JobSystem;
+    bool m_CompactVertices;
+
+    bool loadOBJ(const MappedFile& file, const std::string& path, Mesh& out, MeshLoadStats& stats);
+    bool loadGLTF(const MappedFile& file, const std::string& path, bool binary, Mesh& out, MeshLoadStats& stats);
+
+public:
+    // compactVertices false keeps OBJ attributes as 32-bit floats
+    MeshLoader(JobSystem& jobs, bool compactVertices = true);
+
+    // load path (.obj, .gltf or .glb) into out and print the parse throughput and vertex cache efficiency, needs a current context.
+    // For glTF the first primitive of the first mesh is loaded
+    bool load(const std::string& path, Mesh& out, MeshLoadStats* stats = NULL);
+};
@@ -0,0 +1,333 @@
+#include "MeshOptimizer.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+static const unsigned int FORSYTH_CACHE_SIZE = 32;      // LRU cache modelled by optimizeVertexCache(), larger than real hardware on purpose
+static const unsigned int FORSYTH_MAX_VALENCE = 32;     // live triangle counts with a precomputed score
+static const unsigned int NO_TRIANGLE = UINT_MAX;
+
+// Forsyth's vertex score: recently used vertices score high so their triangles get drawn while they are cached,
+// vertices with few triangles left score high so they get finished off instead of being left as stragglers
+class ForsythScores
+{
+private:
+    float m_Cache[FORSYTH_CACHE_SIZE];
+    float m_Valence[FORSYTH_MAX_VALENCE + 1];
+
+public:
+    ForsythScores()
+    {
+        for (unsigned int i = 0; i < FORSYTH_CACHE_SIZE; i++)
+            // the last triangle's vertices get a fixed score so that the next triangle does not just reuse the same edge
+            m_Cache[i] = i < 3 ? 0.75f : std::pow(1.0f - (float)(i - 3) / (float)(FORSYTH_CACHE_SIZE - 3), 1.5f);
+        m_Valence[0] = 0.0f;
+        for (unsigned int i = 1; i <= FORSYTH_MAX_VALENCE; i++)
+            m_Valence[i] = 2.0f / std::sqrt((float)i);
+    }
+
+    float get(int cachePosition, unsigned int liveTriangles) const
+    {
+        if (liveTriangles == 0)
+            return -1.0f;
+        float score = cachePosition >= 0 ? m_Cache[cachePosition] : 0.0f;
+        return score + (liveTriangles <= FORSYTH_MAX_VALENCE ? m_Valence[liveTriangles] : 2.0f / std::sqrt((float)liveTriangles));
+    }
+};
+
+// FIFO cache simulated with timestamps: a vertex is cached if fewer than cacheSize misses happened since it was loaded.
+// Resetting the cache is just a jump of the clock
+class FifoCache
+{
+private:
+    std::vector<unsigned int> m_Loaded;
+    unsigned int m_Size;
+    unsigned int m_Time;
+
+public:
+    FifoCache(std::size_t vertexCount, unsigned int size)
+        : m_Loaded(vertexCount, 0), m_Size(size), m_Time(size + 1)
+    {
+    }
+
+    void reset() { m_Time += m_Size + 1; }
+
+    // misses of one triangle
+    unsigned int draw(const unsigned int* triangle)
+    {
+        unsigned int misses = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            if (m_Time - m_Loaded[triangle[k]] > m_Size)
+            {
+                m_Loaded[triangle[k]] = m_Time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+};
+
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, std::size_t indexCount, std::size_t vertexCount, unsigned int cacheSize)
+// simulate a FIFO cache of cacheSize vertices over the triangle list
+{
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> referenced(vertexCount, false);
+    std::size_t misses = 0;
+    std::size_t uniqueVertices = 0;
+    for (std::size_t i = 0; i + 2 < indexCount; i += 3)
+        misses += cache.draw(&indices[i]);
+    for (std::size_t i = 0; i < indexCount; i++)
+    {
+        if (!referenced[indices[i]])
+        {
+            referenced[indices[i]] = true;
+            uniqueVertices++;
+        }
+    }
+
+    VertexCacheStats stats;
+    stats.acmr = indexCount >= 3 ? (float)misses / (float)(indexCount / 3) : 0.0f;
+    stats.atvr = uniqueVertices > 0 ? (float)misses / (float)uniqueVertices : 0.0f;
+    return stats;
+}
+
+void optimizeVertexCache(unsigned int* indices, std::size_t indexCount, std::size_t vertexCount)
+// greedily emit the best scoring triangle among those using cached vertices, scores are updated incrementally
+{
+    std::size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+        return;
+    static const ForsythScores scores;
+
+    // triangles of each vertex, live ones first: emitted triangles are swapped past the end of the live range
+    std::vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (std::size_t i = 0; i < triangleCount * 3; i++)
+        liveTriangles[indices[i]]++;
+    std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+    for (std::size_t v = 0; v < vertexCount; v++)
+        firstTriangle[v + 1] = firstTriangle[v] + liveTriangles[v];
+    std::vector<unsigned int> vertexTriangles(triangleCount * 3);
+    std::fill(liveTriangles.begin(), liveTriangles.end(), 0);
+    for (std::size_t i = 0; i < triangleCount * 3; i++)
+    {
+        unsigned int v = indices[i];
+        vertexTriangles[firstTriangle[v] + liveTriangles[v]++] = (unsigned int)(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (std::size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = scores.get(-1, liveTriangles[v]);
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    unsigned int best = 0;
+    for (std::size_t t = 0; t < triangleCount; t++)
+    {
+        triangleScore[t] = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+        if (triangleScore[t] > triangleScore[best])
+            best = (unsigned int)t;
+    }
+
+    std::vector<unsigned int> result(triangleCount * 3);
+    unsigned int cache[FORSYTH_CACHE_SIZE + 3];
+    unsigned int cacheCount = 0;
+    std::size_t cursor = 0;
+    for (std::size_t output = 0; output < triangleCount; output++)
+    {
+        if (best == NO_TRIANGLE)
+        {
+            // dead end, no cached vertex has triangles left: continue with the next triangle in input order
+            while (emitted[cursor])
+                cursor++;
+            best = (unsigned int)cursor;
+        }
+        const unsigned int* triangle = &indices[3 * best];
+        memcpy(&result[3 * output], triangle, 3 * sizeof(unsigned int));
+        emitted[best] = true;
+
+        unsigned int newCache[FORSYTH_CACHE_SIZE + 3];
+        unsigned int newCount = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            // one adjacency entry per corner: a vertex repeated in a degenerate triangle is listed once per corner
+            unsigned int v = triangle[k];
+            unsigned int* live = &vertexTriangles[firstTriangle[v]];
+            unsigned int* found = std::find(live, live + liveTriangles[v], best);
+            std::swap(*found, live[--liveTriangles[v]]);
+            if (std::find(newCache, newCache + newCount, v) == newCache + newCount)
+                newCache[newCount++] = v;
+        }
+        // the triangle's vertices move to the front, the rest of the cache shifts back
+        unsigned int triangleVertices = newCount;
+        for (unsigned int i = 0; i < cacheCount; i++)
+            if (std::find(newCache, newCache + triangleVertices, cache[i]) == newCache + triangleVertices)
+                newCache[newCount++] = cache[i];
+
+        // rescore the cached and the evicted vertices, then pick the best triangle among theirs
+        for (unsigned int i = 0; i < newCount; i++)
+        {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < FORSYTH_CACHE_SIZE ? (int)i : -1;
+            float score = scores.get(cachePosition[v], liveTriangles[v]);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+            const unsigned int* live = &vertexTriangles[firstTriangle[v]];
+            for (unsigned int j = 0; j < liveTriangles[v]; j++)
+                triangleScore[live[j]] += delta;
+        }
+        best = NO_TRIANGLE;
+        float bestScore = -1.0f;
+        for (unsigned int i = 0; i < newCount && i < FORSYTH_CACHE_SIZE; i++)
+        {
+            unsigned int v = newCache[i];
+            const unsigned int* live = &vertexTriangles[firstTriangle[v]];
+            for (unsigned int j = 0; j < liveTriangles[v]; j++)
+            {
+                if (!emitted[live[j]] && triangleScore[live[j]] > bestScore)
+                {
+                    bestScore = triangleScore[live[j]];
+                    best = live[j];
+                }
+            }
+        }
+        cacheCount = std::min(newCount, FORSYTH_CACHE_SIZE);
+        memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+    }
+    memcpy(indices, result.data(), result.size() * sizeof(unsigned int));
+}
+
+static glm::vec3 readPosition(const void* positions, std::size_t stride, unsigned int vertex)
+{
+    glm::vec3 position;
+    memcpy(&position, (const unsigned char*)positions + vertex * stride, sizeof(position));
+    return position;
+}
+
+std::size_t removeDegenerateTriangles(unsigned int* indices, std::size_t indexCount, const void* positions, std::size_t positionStride)
+// drop triangles with a repeated index, or with zero area if positions are given, and the incomplete triangle at the end
+{
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a == b || b == c || c == a)
+            continue;
+        if (positions)
+        {
+            glm::vec3 pa = readPosition(positions, positionStride, a);
+            glm::vec3 normal = glm::cross(readPosition(positions, positionStride, b) - pa, readPosition(positions, positionStride, c) - pa);
+            if (glm::dot(normal, normal) == 0.0f)
+                continue;
+        }
+        indices[kept++] = a;
+        indices[kept++] = b;
+        indices[kept++] = c;
+    }
+    return kept;
+}
+
+void optimizeOverdraw(unsigned int* indices, std::size_t indexCount, const void* positions, std::size_t positionStride,
+                      std::size_t vertexCount, float threshold)
+// split into clusters that can be reordered without hurting the cache more than threshold, sort them outward facing first
+{
+    std::size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+        return;
+
+    // hard boundaries: triangles that miss the cache with all three vertices, the vertex cache order starts over there anyway
+    FifoCache cache(vertexCount, MESH_FIFO_CACHE_SIZE);
+    std::vector<unsigned int> hardBoundaries;
+    for (std::size_t t = 0; t < triangleCount; t++)
+        if (cache.draw(&indices[3 * t]) == 3)
+            hardBoundaries.push_back((unsigned int)t);
+    hardBoundaries.push_back((unsigned int)triangleCount);
+
+    // soft boundaries: a hard cluster is split again wherever the piece so far is no worse than threshold times the
+    // whole cluster's miss ratio, starting each piece with a cold cache
+    std::vector<unsigned int> clusters;
+    for (std::size_t c = 0; c + 1 < hardBoundaries.size(); c++)
+    {
+        unsigned int start = hardBoundaries[c];
+        unsigned int end = hardBoundaries[c + 1];
+        cache.reset();
+        unsigned int misses = 0;
+        for (unsigned int t = start; t < end; t++)
+            misses += cache.draw(&indices[3 * t]);
+        float limit = threshold * (float)misses / (float)(end - start);
+
+        cache.reset();
+        clusters.push_back(start);
+        misses = 0;
+        unsigned int pieceStart = start;
+        for (unsigned int t = start; t < end; t++)
+        {
+            misses += cache.draw(&indices[3 * t]);
+            if (t + 1 < end && (float)misses <= limit * (float)(t + 1 - pieceStart))
+            {
+                clusters.push_back(t + 1);
+                pieceStart = t + 1;
+                misses = 0;
+                cache.reset();
+            }
+        }
+    }
+    clusters.push_back((unsigned int)triangleCount);
+
+    // sort key: how far the cluster's area weighted centroid lies out of the mesh centroid along its average normal
+    glm::vec3 meshCentroid(0.0f);
+    for (std::size_t i = 0; i < triangleCount * 3; i++)
+        meshCentroid += readPosition(positions, positionStride, indices[i]);
+    meshCentroid /= (float)(triangleCount * 3);
+
+    std::size_t clusterCount = clusters.size() - 1;
+    std::vector<float> keys(clusterCount);
+    std::vector<unsigned int> order(clusterCount);
+    for (std::size_t c = 0; c < clusterCount; c++)
+    {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (unsigned int t = clusters[c]; t < clusters[c + 1]; t++)
+        {
+            glm::vec3 p0 = readPosition(positions, positionStride, indices[3 * t]);
+            glm::vec3 p1 = readPosition(positions, positionStride, indices[3 * t + 1]);
+            glm::vec3 p2 = readPosition(positions, positionStride, indices[3 * t + 2]);
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);  // twice the area long
+            float triangleArea = glm::length(n);
+            centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal += n;
+            area += triangleArea;
+        }
+        float normalLength = glm::length(normal);
+        keys[c] = area > 0.0f && normalLength > 0.0f ? glm::dot(centroid / area - meshCentroid, normal / normalLength) : 0.0f;
+        order[c] = (unsigned int)c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&keys](unsigned int a, unsigned int b) { return keys[a] > keys[b]; });
+
+    std::vector<unsigned int> result;
+    result.reserve(triangleCount * 3);
+    for (unsigned int c : order)
+        result.insert(result.end(), indices + 3 * clusters[c], indices + 3 * clusters[c + 1]);
+    memcpy(indices, result.data(), result.size() * sizeof(unsigned int));
+}
+
+void optimizeVertexFetch(unsigned int* indices, std::size_t indexCount, std::size_t vertexCount, std::vector<unsigned int>& remap)
+// renumber vertices in first use order, remap[old] = new. Unreferenced vertices are moved to the end
+{
+    remap.assign(vertexCount, UINT_MAX);
+    unsigned int next = 0;
+    for (std::size_t i = 0; i < indexCount; i++)
+    {
+        if (remap[indices[i]] == UINT_MAX)
+            remap[indices[i]] = next++;
+        indices[i] = remap[indices[i]];
+    }
+    for (std::size_t v = 0; v < vertexCount; v++)
+        if (remap[v] == UINT_MAX)
+            remap[v] = next++;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+const unsigned int MESH_FIFO_CACHE_SIZE = 16;       // post-transform cache simulated by analyzeVertexCache()
+const float MESH_OVERDRAW_THRESHOLD = 1.05f;        // optimizeOverdraw() may make the vertex cache this much worse
+
+// efficiency of an index order on a FIFO post-transform vertex cache
+struct VertexCacheStats
+{
+    float acmr;     // average cache miss ratio: vertices transformed per triangle, 0.5 is ideal for a regular grid, 3 the worst
+    float atvr;     // average transform to vertex ratio: vertices transformed per referenced vertex, 1 is ideal
+};
+
+// Index buffer optimizations applied at import, in this order:
+//   1. optimizeVertexCache() reorders triangles so that they reuse recently transformed vertices
+//      (Tom Forsyth's linear-speed vertex cache optimisation)
+//   2. optimizeOverdraw() cuts the result into clusters at cache boundaries and draws the outward facing
+//      ones first so that early depth testing rejects more of the rest, without losing much cache efficiency
+//   3. optimizeVertexFetch() renumbers the vertices in the order they are first used, so that vertex
+//      fetches walk the vertex buffer linearly. The caller reorders its vertex data with the remap table
+// All of them work in place on 32-bit indices.
+
+// compact the triangle list in place, dropping the triangles that draw nothing: a repeated index, or zero area when
+// positions (xyz floats, positionStride bytes apart) are given. Returns the new index count. Run it before the rest
+std::size_t removeDegenerateTriangles(unsigned int* indices, std::size_t indexCount, const void* positions = NULL, std::size_t positionStride = 0);
+
+// simulate a FIFO cache of cacheSize vertices over the triangle list
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, std::size_t indexCount, std::size_t vertexCount,
+                                    unsigned int cacheSize = MESH_FIFO_CACHE_SIZE);
+
+void optimizeVertexCache(unsigned int* indices, std::size_t indexCount, std::size_t vertexCount);
+
+// positions: xyz floats of each vertex, positionStride bytes apart. Expects indices already optimized for the vertex cache
+void optimizeOverdraw(unsigned int* indices, std::size_t indexCount, const void* positions, std::size_t positionStride,
+                      std::size_t vertexCount, float threshold = MESH_OVERDRAW_THRESHOLD);
+
+// renumber vertices in first use order, remap[old] = new. Unreferenced vertices are moved to the end
+void optimizeVertexFetch(unsigned int* indices, std::size_t indexCount, std::size_t vertexCount, std::vector<unsigned int>& remap);
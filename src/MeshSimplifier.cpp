@@ -0,0 +1,230 @@
+#include "MeshSimplifier.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// symmetric 4x4 matrix of the summed plane equations, error(p) = p^T Q p divided by the summed triangle areas
+struct Quadric
+{
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+    double weight;
+
+    Quadric& operator+=(const Quadric& other)
+    {
+        a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+        b2 += other.b2; bc += other.bc; bd += other.bd;
+        c2 += other.c2; cd += other.cd; d2 += other.d2;
+        weight += other.weight;
+        return *this;
+    }
+
+    // plane ax + by + cz + d = 0 with a unit normal, weighted by the area of its triangle
+    void addPlane(const glm::dvec3& normal, double d, double area)
+    {
+        a2 += area * normal.x * normal.x; ab += area * normal.x * normal.y; ac += area * normal.x * normal.z; ad += area * normal.x * d;
+        b2 += area * normal.y * normal.y; bc += area * normal.y * normal.z; bd += area * normal.y * d;
+        c2 += area * normal.z * normal.z; cd += area * normal.z * d;
+        d2 += area * d * d;
+        weight += area;
+    }
+
+    // area weighted mean squared distance of p to the planes
+    double evaluate(const glm::vec3& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double error = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+                     + b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+                     + c2 * z * z + 2.0 * cd * z + d2;
+        return weight > 0.0 ? std::fabs(error) / weight : 0.0;
+    }
+};
+
+// triangles around each vertex, rebuilt after every pass of collapses
+class TriangleAdjacency
+{
+private:
+    std::vector<unsigned int> m_First;
+    std::vector<unsigned int> m_Triangles;
+
+public:
+    void build(const std::vector<unsigned int>& indices, std::size_t vertexCount)
+    {
+        m_First.assign(vertexCount + 1, 0);
+        for (unsigned int index : indices)
+            m_First[index + 1]++;
+        for (std::size_t v = 0; v < vertexCount; v++)
+            m_First[v + 1] += m_First[v];
+        m_Triangles.resize(indices.size());
+        std::vector<unsigned int> filled(m_First.begin(), m_First.end() - 1);
+        for (std::size_t i = 0; i < indices.size(); i++)
+            m_Triangles[filled[indices[i]]++] = (unsigned int)(i / 3);
+    }
+
+    const unsigned int* begin(unsigned int vertex) const { return m_Triangles.data() + m_First[vertex]; }
+    const unsigned int* end(unsigned int vertex) const { return m_Triangles.data() + m_First[vertex + 1]; }
+};
+
+struct Collapse
+{
+    unsigned int source;    // moves onto target
+    unsigned int target;
+    double cost;
+};
+
+static bool hasHalfEdge(const TriangleAdjacency& adjacency, const std::vector<unsigned int>& indices, unsigned int from, unsigned int to)
+// is there a triangle with the edge from -> to in its winding order
+{
+    for (const unsigned int* t = adjacency.begin(from); t != adjacency.end(from); t++)
+        for (int k = 0; k < 3; k++)
+            if (indices[3 * *t + k] == from && indices[3 * *t + (k + 1) % 3] == to)
+                return true;
+    return false;
+}
+
+static bool collapseFlips(const TriangleAdjacency& adjacency, const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions,
+                          unsigned int source, unsigned int target)
+// would moving source onto target turn one of its remaining triangles over (or collapse it to a line)
+{
+    for (const unsigned int* t = adjacency.begin(source); t != adjacency.end(source); t++)
+    {
+        const unsigned int* triangle = &indices[3 * *t];
+        if (triangle[0] == target || triangle[1] == target || triangle[2] == target)
+            continue;   // the collapsed edge's triangles disappear
+        glm::vec3 before[3], after[3];
+        for (int k = 0; k < 3; k++)
+        {
+            before[k] = positions[triangle[k]];
+            after[k] = triangle[k] == source ? positions[target] : before[k];
+        }
+        glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+        if (glm::dot(normalBefore, normalAfter) <= 1e-2f * glm::length(normalBefore) * glm::length(normalAfter))
+            return true;
+    }
+    return false;
+}
+
+std::size_t simplifyMesh(unsigned int* destination, const unsigned int* indices, std::size_t indexCount, const void* positions,
+                         std::size_t positionStride, std::size_t vertexCount, std::size_t targetIndexCount, float maxError, float* error)
+// passes of independent collapses: each pass sorts all edges by cost and collapses the cheapest ones that do not share
+// triangles, until enough triangles are gone
+{
+    std::vector<unsigned int> current(indices, indices + indexCount / 3 * 3);
+    std::vector<glm::vec3> vertices(vertexCount);
+    for (std::size_t v = 0; v < vertexCount; v++)
+        memcpy(&vertices[v], (const unsigned char*)positions + v * positionStride, sizeof(glm::vec3));
+
+    std::vector<Quadric> quadrics(vertexCount, Quadric());
+    for (std::size_t i = 0; i < current.size(); i += 3)
+    {
+        glm::dvec3 p0(vertices[current[i]]), p1(vertices[current[i + 1]]), p2(vertices[current[i + 2]]);
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length == 0.0)
+            continue;
+        normal /= length;
+        for (int k = 0; k < 3; k++)
+            quadrics[current[i + k]].addPlane(normal, -glm::dot(normal, p0), 0.5 * length);
+    }
+
+    // a half-edge without its twin is an open border, or a seam where the vertices were split by their attributes
+    TriangleAdjacency adjacency;
+    adjacency.build(current, vertexCount);
+    std::vector<bool> locked(vertexCount, false);
+    for (std::size_t i = 0; i < current.size(); i++)
+    {
+        unsigned int from = current[i];
+        unsigned int to = current[i - i % 3 + (i + 1) % 3];
+        if (!hasHalfEdge(adjacency, current, to, from))
+            locked[from] = locked[to] = true;
+    }
+
+    const double maxCost = (double)maxError * (double)maxError;
+    double resultCost = 0.0;
+    std::vector<Collapse> collapses;
+    std::vector<unsigned int> collapseTo(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    while (current.size() > targetIndexCount)
+    {
+        // every interior edge shows up as a -> b in one triangle and b -> a in the other, take it once
+        collapses.clear();
+        for (std::size_t i = 0; i < current.size(); i++)
+        {
+            unsigned int a = current[i];
+            unsigned int b = current[i - i % 3 + (i + 1) % 3];
+            if (a > b || (locked[a] && locked[b]))
+                continue;
+            Quadric combined = quadrics[a];
+            combined += quadrics[b];
+            double aToB = locked[a] ? std::numeric_limits<double>::max() : combined.evaluate(vertices[b]);
+            double bToA = locked[b] ? std::numeric_limits<double>::max() : combined.evaluate(vertices[a]);
+            Collapse collapse = { aToB <= bToA ? a : b, aToB <= bToA ? b : a, std::min(aToB, bToA) };
+            collapses.push_back(collapse);
+        }
+        if (collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        std::size_t trianglesToRemove = (current.size() - targetIndexCount) / 3;
+        std::size_t removed = 0;
+        std::size_t performed = 0;
+        bool limitReached = false;
+        for (std::size_t v = 0; v < vertexCount; v++)
+            collapseTo[v] = (unsigned int)v;
+        std::fill(touched.begin(), touched.end(), false);
+        for (const Collapse& collapse : collapses)
+        {
+            if (collapse.cost > maxCost)
+            {
+                limitReached = true;
+                break;
+            }
+            if (touched[collapse.source] || touched[collapse.target] ||
+                collapseFlips(adjacency, current, vertices, collapse.source, collapse.target))
+                continue;
+
+            collapseTo[collapse.source] = collapse.target;
+            quadrics[collapse.target] += quadrics[collapse.source];
+            resultCost = std::max(resultCost, collapse.cost);
+            performed++;
+            // the one-ring is frozen for the rest of the pass, the adjacency no longer describes it
+            for (const unsigned int* t = adjacency.begin(collapse.source); t != adjacency.end(collapse.source); t++)
+            {
+                const unsigned int* triangle = &current[3 * *t];
+                for (int k = 0; k < 3; k++)
+                    touched[triangle[k]] = true;
+                if (triangle[0] == collapse.target || triangle[1] == collapse.target || triangle[2] == collapse.target)
+                    removed++;
+            }
+            if (removed >= trianglesToRemove)
+                break;
+        }
+        if (performed == 0)
+            break;
+
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < current.size(); i += 3)
+        {
+            unsigned int a = collapseTo[current[i]], b = collapseTo[current[i + 1]], c = collapseTo[current[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            current[kept++] = a;
+            current[kept++] = b;
+            current[kept++] = c;
+        }
+        current.resize(kept);
+        if (limitReached)
+            break;
+        adjacency.build(current, vertexCount);
+    }
+
+    memcpy(destination, current.data(), current.size() * sizeof(unsigned int));
+    if (error)
+        *error = (float)std::sqrt(resultCost);
+    return current.size();
+}
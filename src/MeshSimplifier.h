@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+// Simplify a triangle list by collapsing edges onto one of their vertices, cheapest first by quadric error
+// (Garland & Heckbert): every vertex accumulates the planes of its triangles, and moving it costs the squared
+// distance to those planes. Since vertices only collapse onto existing ones, all levels of detail share the
+// vertex buffer and just need their own index range.
+// Vertices on open borders and attribute seams (texture coordinate or normal splits) never move, so the outline
+// and the texture mapping survive; collapses that would flip a triangle are rejected.
+//
+// indices: triangle list, destination may be the same array. positions: xyz floats of each vertex, positionStride
+// bytes apart. Stops at targetIndexCount or when the next collapse would move the surface further than maxError.
+// Returns the new index count; error gets the distance the surface moved (in model units).
+std::size_t simplifyMesh(unsigned int* destination, const unsigned int* indices, std::size_t indexCount, const void* positions,
+                         std::size_t positionStride, std::size_t vertexCount, std::size_t targetIndexCount, float maxError, float* error);
@@ -0,0 +1,247 @@
+#include "PerfHud.h"
+#include "GLStateCache.h"
+#include "StreamBuffer.h"
+
+#include "imgui.h"
+#include "imgui_impl_opengl3.h"
+#ifndef LEARNOPENGL_NO_GLFW
+#include "imgui_impl_glfw.h"
+#endif
+
+#include <chrono>
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
+
+static double getResidentMB()
+// memory of the process currently in RAM (working set), 0 where unknown
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.WorkingSetSize / (1024.0 * 1024.0);
+#elif defined(__linux__)
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file)
+    {
+        unsigned long size = 0, resident = 0;
+        int read = fscanf(file, "%lu %lu", &size, &resident);
+        fclose(file);
+        if (read == 2)
+            return (double)resident * sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+    }
+#endif
+    return 0.0;
+}
+
+PerfHud::PerfHud(GLFWwindow* window, unsigned int width, unsigned int height)
+// window NULL renders offscreen at width x height without input, needs a current context
+    : m_Glfw(false), m_Width((float)width), m_Height((float)height), m_Visible(false), m_RefreshInterval(1),
+      m_FramesSinceRefresh(0), m_CostMs(0.0f), m_ResidentMB(0.0)
+{
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = NULL;                              // nothing to remember, the HUD is not interactive
+    io.ConfigFlags |= ImGuiConfigFlags_NoMouseCursorChange;
+    ImGui::StyleColorsDark();
+#ifndef LEARNOPENGL_NO_GLFW
+    if (window)
+        m_Glfw = ImGui_ImplGlfw_InitForOpenGL(window, true);   // chains the callbacks installed before
+#else
+    (void)window;
+#endif
+    ImGui_ImplOpenGL3_Init("#version 330");
+
+    Profiler& profiler = Profiler::Get();
+    m_CostCounter = profiler.registerCounter("hud_ms");
+    m_DrawCallsCounter = profiler.registerCounter("draw_calls");
+    m_TrianglesCounter = profiler.registerCounter("triangles_drawn");
+    Percentiles none = { -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, 0 };
+    m_CpuPercentiles = none;
+    m_GpuPercentiles = none;
+}
+
+PerfHud::~PerfHud()
+{
+    ImGui_ImplOpenGL3_Shutdown();
+#ifndef LEARNOPENGL_NO_GLFW
+    if (m_Glfw)
+        ImGui_ImplGlfw_Shutdown();
+#endif
+    ImGui::DestroyContext();
+}
+
+void PerfHud::refresh()
+// statistics of the last HUD_GRAPH_FRAMES frames of the profiler history
+{
+    const Profiler& profiler = Profiler::Get();
+    const RingBuffer<FrameStats, PROFILER_HISTORY>& history = profiler.getHistory();
+    unsigned int zoneCount = profiler.getZoneCount();
+    unsigned int counterCount = profiler.getCounterCount();
+    m_CpuGraph.clear();
+    m_GpuGraph.clear();
+    m_CpuZoneMs.assign(zoneCount, 0.0f);
+    m_GpuZoneMs.assign(zoneCount, 0.0f);
+    m_Counters.assign(counterCount, 0.0);
+    std::vector<unsigned int> gpuZoneFrames(zoneCount, 0);
+
+    // read just the frames shown instead of snapshotting the whole history
+    uint64_t head = history.totalPushed();
+    uint64_t first = head > HUD_GRAPH_FRAMES ? head - HUD_GRAPH_FRAMES : 0;
+    FrameStats stats;
+    for (uint64_t i = first; i < head; i++)
+    {
+        if (!history.read(i, stats))
+            continue;
+        m_CpuGraph.push_back(stats.cpuFrameMs);
+        m_GpuGraph.push_back(stats.gpuFrameMs > 0.0f ? stats.gpuFrameMs : 0.0f);
+        for (unsigned int zone = 0; zone < zoneCount; zone++)
+        {
+            m_CpuZoneMs[zone] += stats.cpuZoneMs[zone];
+            if (stats.gpuZoneMs[zone] >= 0.0f)
+            {
+                m_GpuZoneMs[zone] += stats.gpuZoneMs[zone];
+                gpuZoneFrames[zone]++;
+            }
+        }
+        for (unsigned int counter = 0; counter < counterCount; counter++)
+            m_Counters[counter] += stats.counters[counter];
+    }
+
+    float frames = m_CpuGraph.empty() ? 1.0f : (float)m_CpuGraph.size();
+    for (unsigned int zone = 0; zone < zoneCount; zone++)
+    {
+        m_CpuZoneMs[zone] /= frames;
+        m_GpuZoneMs[zone] = gpuZoneFrames[zone] ? m_GpuZoneMs[zone] / gpuZoneFrames[zone] : -1.0f;
+    }
+    for (unsigned int counter = 0; counter < counterCount; counter++)
+        m_Counters[counter] /= frames;
+
+    m_Scratch = m_CpuGraph;
+    m_CpuPercentiles = Profiler::computePercentiles(m_Scratch);
+    m_Scratch = m_GpuGraph;
+    for (float& ms : m_Scratch)
+        if (ms == 0.0f)
+            ms = -1.0f;     // unavailable, skipped
+    m_GpuPercentiles = Profiler::computePercentiles(m_Scratch);
+    m_ResidentMB = getResidentMB();
+}
+
+void PerfHud::build()
+// the ImGui window, from the statistics of the last refresh
+{
+    const Profiler& profiler = Profiler::Get();
+    ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_Always);
+    ImGui::SetNextWindowBgAlpha(0.75f);
+    const ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings |
+                                   ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoInputs;
+    if (!ImGui::Begin("Performance", NULL, flags))
+    {
+        ImGui::End();
+        return;
+    }
+
+    auto counter = [this](int id) { return id >= 0 && id < (int)m_Counters.size() ? m_Counters[id] : 0.0; };
+    ImGui::Text("CPU %.2f ms (p95 %.2f, p99 %.2f)  %.0f fps", m_CpuPercentiles.mean, m_CpuPercentiles.p95, m_CpuPercentiles.p99,
+                m_CpuPercentiles.mean > 0.0f ? 1000.0f / m_CpuPercentiles.mean : 0.0f);
+    if (m_GpuPercentiles.count > 0)
+        ImGui::Text("GPU %.2f ms (p95 %.2f, p99 %.2f)", m_GpuPercentiles.mean, m_GpuPercentiles.p95, m_GpuPercentiles.p99);
+    else
+        ImGui::Text("GPU n/a");
+    ImGui::Text("%.0f draw calls, %.0f triangles", counter(m_DrawCallsCounter), counter(m_TrianglesCounter));
+
+    // both graphs on the same scale, so CPU and GPU bound frames are told apart at a glance
+    float scale = m_CpuPercentiles.max > m_GpuPercentiles.max ? m_CpuPercentiles.max : m_GpuPercentiles.max;
+    scale = scale > 1.0f ? scale * 1.1f : 1.0f;
+    if (!m_CpuGraph.empty())
+    {
+        ImGui::PlotLines("CPU ms", m_CpuGraph.data(), (int)m_CpuGraph.size(), 0, NULL, 0.0f, scale, ImVec2(HUD_GRAPH_FRAMES, 40.0f));
+        ImGui::PlotLines("GPU ms", m_GpuGraph.data(), (int)m_GpuGraph.size(), 0, NULL, 0.0f, scale, ImVec2(HUD_GRAPH_FRAMES, 40.0f));
+    }
+
+    if (ImGui::BeginTable("zones", 3, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg))
+    {
+        ImGui::TableSetupColumn("zone");
+        ImGui::TableSetupColumn("CPU ms");
+        ImGui::TableSetupColumn("GPU ms");
+        ImGui::TableHeadersRow();
+        for (unsigned int zone = 0; zone < m_CpuZoneMs.size(); zone++)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(profiler.getZoneName(zone).c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", m_CpuZoneMs[zone]);
+            ImGui::TableNextColumn();
+            if (m_GpuZoneMs[zone] >= 0.0f)
+                ImGui::Text("%.3f", m_GpuZoneMs[zone]);
+        }
+        ImGui::EndTable();
+    }
+
+    if (ImGui::BeginTable("counters", 2, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg))
+    {
+        for (unsigned int id = 0; id < m_Counters.size(); id++)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(profiler.getCounterName(id).c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", m_Counters[id]);
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::Text("memory %.1f MB, stream buffer %.1f MB", m_ResidentMB, StreamBuffer::Get().getSize() / (1024.0 * 1024.0));
+    ImGui::Text("HUD %.3f ms of %.2f, refreshed every %u frames", m_CostMs, HUD_BUDGET_MS, m_RefreshInterval);
+    ImGui::End();
+}
+
+void PerfHud::render(float deltaTime)
+// draw the overlay on top of the frame, outside of any GPU zone. Changes GL state behind GLStateCache's back
+{
+    if (!m_Visible)
+        return;
+    PROFILE_GPU_ZONE("HUD");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (m_FramesSinceRefresh == 0)
+        refresh();
+    m_FramesSinceRefresh = (m_FramesSinceRefresh + 1) % m_RefreshInterval;
+
+    ImGuiIO& io = ImGui::GetIO();
+    ImGui_ImplOpenGL3_NewFrame();
+#ifndef LEARNOPENGL_NO_GLFW
+    if (m_Glfw)
+        ImGui_ImplGlfw_NewFrame();
+#endif
+    if (!m_Glfw)
+    {
+        io.DisplaySize = ImVec2(m_Width, m_Height);
+        io.DeltaTime = deltaTime > 0.0f ? deltaTime : 1.0f / 60.0f;
+    }
+    ImGui::NewFrame();
+    build();
+    ImGui::Render();
+    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    GLStateCache::Get().invalidate();
+
+    // stay under budget: refresh the statistics less often while over it, more often again once well under it
+    float costMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    m_CostMs = m_CostMs * 0.9f + costMs * 0.1f;
+    Profiler::Get().setCounter(m_CostCounter, costMs);
+    if (m_FramesSinceRefresh != 0)
+        return;     // decided once per interval
+    if (m_CostMs > HUD_BUDGET_MS && m_RefreshInterval < HUD_MAX_REFRESH_INTERVAL)
+        m_RefreshInterval *= 2;
+    else if (m_CostMs < 0.5f * HUD_BUDGET_MS && m_RefreshInterval > 1)
+        m_RefreshInterval /= 2;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Profiler.h"
+
+#include <vector>
+
+struct GLFWwindow;
+
+const float HUD_BUDGET_MS = 0.5f;                   // CPU time the HUD may spend per frame, building and drawing
+const unsigned int HUD_GRAPH_FRAMES = 240;          // frames shown in the frame time graph and averaged in the tables
+const unsigned int HUD_MAX_REFRESH_INTERVAL = 32;   // frames between statistics refreshes when over budget
+
+// In-app performance overlay drawn with Dear ImGui: frame time graph with percentiles, CPU/GPU time per profiler zone,
+// every profiler counter (draw calls, triangles, state changes, streaming...) and the process' memory usage.
+// Hidden it costs nothing. Its own CPU time is measured every frame (the "HUD" zone and the hud_ms counter); when
+// it goes over HUD_BUDGET_MS the statistics are recomputed from the profiler history less often, the cached ones
+// are drawn in between.
+class PerfHud
+{
+private:
+    bool m_Glfw;                    // platform backend installed, otherwise the display size is fixed (headless)
+    float m_Width, m_Height;
+    bool m_Visible;
+    unsigned int m_RefreshInterval;
+    unsigned int m_FramesSinceRefresh;
+    float m_CostMs;                 // smoothed CPU time of render()
+    int m_CostCounter;
+    int m_DrawCallsCounter;         // profiler ids of counters shown in the header line
+    int m_TrianglesCounter;
+
+    // statistics of the last refresh
+    std::vector<float> m_CpuGraph;
+    std::vector<float> m_GpuGraph;
+    Percentiles m_CpuPercentiles;
+    Percentiles m_GpuPercentiles;
+    std::vector<float> m_CpuZoneMs;
+    std::vector<float> m_GpuZoneMs;
+    std::vector<double> m_Counters;
+    double m_ResidentMB;
+    std::vector<float> m_Scratch;
+
+    void refresh();
+    void build();
+
+public:
+    // window NULL renders offscreen at width x height without input, needs a current context
+    PerfHud(GLFWwindow* window, unsigned int width, unsigned int height);
+    // Destructor
+    ~PerfHud();
+
+    PerfHud(const PerfHud&) = delete;
+    PerfHud& operator=(const PerfHud&) = delete;
+
+    void toggle() { m_Visible = !m_Visible; }
+    void setVisible(bool visible) { m_Visible = visible; }
+    bool isVisible() const { return m_Visible; }
+
+    // draw the overlay on top of the frame, outside of any GPU zone. Changes GL state behind GLStateCache's back
+    void render(float deltaTime);
+};
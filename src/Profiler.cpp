@@ -0,0 +1,384 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+Profiler::Profiler()
+    : m_Initialized(false), m_FrameIndex(0), m_ActiveGpuZone(-1), m_ZoneCount(0), m_CounterCount(0)
+{
+    memset(m_Pending, 0, sizeof(m_Pending));
+    for (unsigned int i = 0; i < PROFILER_MAX_ZONES; i++)
+        m_CpuZoneNs[i].store(0, std::memory_order_relaxed);
+    for (unsigned int i = 0; i < PROFILER_MAX_COUNTERS; i++)
+        m_Counters[i] = 0.0;
+}
+
+Profiler& Profiler::Get()
+{
+    static Profiler instance;
+    return instance;
+}
+
+void Profiler::init()
+// create the GPU query pools, needs a current OpenGL context
+{
+    for (unsigned int i = 0; i < PROFILER_GPU_FRAMES; i++)
+    {
+        glGenQueries(2, m_Pending[i].frameQueries);
+        glGenQueries(PROFILER_MAX_ZONES, m_Pending[i].zoneQueries);
+        m_Pending[i].inUse = false;
+    }
+    m_FrameStart = std::chrono::steady_clock::now();
+    m_Initialized = true;
+}
+
+void Profiler::shutdown()
+// read back the remaining frames and delete the queries
+{
+    if (!m_Initialized)
+        return;
+
+    // oldest first, waiting is fine here since we are exiting
+    for (unsigned int i = 1; i <= PROFILER_GPU_FRAMES; i++)
+    {
+        PendingFrame& frame = m_Pending[(m_FrameIndex + i) % PROFILER_GPU_FRAMES];
+        if (frame.inUse)
+            resolve(frame, true);
+    }
+    for (unsigned int i = 0; i < PROFILER_GPU_FRAMES; i++)
+    {
+        glDeleteQueries(2, m_Pending[i].frameQueries);
+        glDeleteQueries(PROFILER_MAX_ZONES, m_Pending[i].zoneQueries);
+    }
+    m_Initialized = false;
+}
+
+void Profiler::beginFrame(std::chrono::steady_clock::time_point cpuStart)
+// call at the start of the frame, the CPU frame time runs from cpuStart
+{
+    if (!m_Initialized)
+        return;
+
+    // endFrame() already resolved this slot, its queries are free to reuse
+    PendingFrame& frame = m_Pending[m_FrameIndex % PROFILER_GPU_FRAMES];
+    memset(frame.zoneUsed, 0, sizeof(frame.zoneUsed));
+
+    m_FrameStart = cpuStart;
+    glQueryCounter(frame.frameQueries[0], GL_TIMESTAMP);
+}
+
+void Profiler::endFrame()
+// call after swapping buffers
+{
+    if (!m_Initialized)
+        return;
+
+    PendingFrame& frame = m_Pending[m_FrameIndex % PROFILER_GPU_FRAMES];
+    glQueryCounter(frame.frameQueries[1], GL_TIMESTAMP);
+
+    FrameStats& stats = frame.stats;
+    stats.frameIndex = m_FrameIndex;
+    stats.cpuFrameMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_FrameStart).count();
+    stats.gpuFrameMs = -1.0f;
+    for (unsigned int i = 0; i < PROFILER_MAX_ZONES; i++)
+    {
+        stats.cpuZoneMs[i] = m_CpuZoneNs[i].exchange(0, std::memory_order_relaxed) / 1.0e6f;
+        stats.gpuZoneMs[i] = -1.0f;
+    }
+    for (unsigned int i = 0; i < PROFILER_MAX_COUNTERS; i++)
+    {
+        stats.counters[i] = m_Counters[i];
+        m_Counters[i] = 0.0;
+    }
+    frame.inUse = true;
+
+    m_FrameIndex++;
+
+    // the oldest frame in flight gets its slot reused next frame, read it back if the GPU is done with it
+    PendingFrame& oldest = m_Pending[m_FrameIndex % PROFILER_GPU_FRAMES];
+    if (oldest.inUse && !resolve(oldest, false))
+    {
+        // GPU is more than PROFILER_GPU_FRAMES behind: keep the CPU times, never wait for the GPU ones
+        m_History.push(oldest.stats);
+        oldest.inUse = false;
+    }
+}
+
+bool Profiler::resolve(PendingFrame& frame, bool wait)
+// read back the GPU queries of a pending frame and push it to the history, false if results are not ready
+{
+    if (wait)
+        glFinish();
+
+    // the end timestamp is the last query issued, if it is available all others are too
+    GLint available = 0;
+    glGetQueryObjectiv(frame.frameQueries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return false;
+
+    GLuint64 begin = 0, end = 0;
+    glGetQueryObjectui64v(frame.frameQueries[0], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(frame.frameQueries[1], GL_QUERY_RESULT, &end);
+    frame.stats.gpuFrameMs = (end - begin) / 1.0e6f;
+
+    for (unsigned int i = 0; i < PROFILER_MAX_ZONES; i++)
+    {
+        if (!frame.zoneUsed[i])
+            continue;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(frame.zoneQueries[i], GL_QUERY_RESULT, &elapsed);
+        // some drivers (llvmpipe) report garbage for the very first query, a zone can't be longer than its frame
+        if (elapsed <= end - begin)
+            frame.stats.gpuZoneMs[i] = elapsed / 1.0e6f;
+    }
+
+    m_History.push(frame.stats);
+    frame.inUse = false;
+    return true;
+}
+
+int Profiler::registerZone(const char* name)
+// returns the id of zone name, registering it on first use
+{
+    std::lock_guard<std::mutex> lock(m_ZoneMutex);
+    unsigned int count = m_ZoneCount.load(std::memory_order_relaxed);
+    for (unsigned int i = 0; i < count; i++)
+        if (m_ZoneNames[i] == name)
+            return (int)i;
+
+    if (count == PROFILER_MAX_ZONES)
+    {
+        std::cout << "Warning! profiler zone " << name << " dropped, PROFILER_MAX_ZONES reached." << std::endl;
+        return -1;
+    }
+    m_ZoneNames[count] = name;
+    m_ZoneCount.store(count + 1, std::memory_order_release);
+    return (int)count;
+}
+
+void Profiler::addCpuTime(int zone, uint64_t nanoseconds)
+{
+    if (zone >= 0)
+        m_CpuZoneNs[zone].fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void Profiler::beginGpuZone(int zone)
+// GL_TIME_ELAPSED queries cannot nest, only one GPU zone may be active at a time
+{
+    if (!m_Initialized || zone < 0 || m_ActiveGpuZone >= 0)
+        return;
+
+    PendingFrame& frame = m_Pending[m_FrameIndex % PROFILER_GPU_FRAMES];
+    if (frame.zoneUsed[zone]) // one query per zone per frame
+        return;
+    frame.zoneUsed[zone] = true;
+    glBeginQuery(GL_TIME_ELAPSED, frame.zoneQueries[zone]);
+    m_ActiveGpuZone = zone;
+}
+
+void Profiler::endGpuZone(int zone)
+{
+    if (m_ActiveGpuZone != zone || zone < 0)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    m_ActiveGpuZone = -1;
+}
+
+int Profiler::registerCounter(const char* name)
+// returns the id of counter name, registering it on first use
+{
+    for (unsigned int i = 0; i < m_CounterCount; i++)
+        if (m_CounterNames[i] == name)
+            return (int)i;
+
+    if (m_CounterCount == PROFILER_MAX_COUNTERS)
+    {
+        std::cout << "Warning! profiler counter " << name << " dropped, PROFILER_MAX_COUNTERS reached." << std::endl;
+        return -1;
+    }
+    m_CounterNames[m_CounterCount] = name;
+    return (int)m_CounterCount++;
+}
+
+void Profiler::setCounter(int counter, double value)
+{
+    if (counter >= 0)
+        m_Counters[counter] = value;
+}
+
+void Profiler::addCounter(int counter, double value)
+{
+    if (counter >= 0)
+        m_Counters[counter] += value;
+}
+
+unsigned int Profiler::getZoneCount() const
+{
+    return m_ZoneCount.load(std::memory_order_acquire);
+}
+
+const std::string& Profiler::getZoneName(int zone) const
+{
+    return m_ZoneNames[zone];
+}
+
+unsigned int Profiler::getCounterCount() const
+{
+    return m_CounterCount;
+}
+
+const std::string& Profiler::getCounterName(int counter) const
+{
+    return m_CounterNames[counter];
+}
+
+const RingBuffer<FrameStats, PROFILER_HISTORY>& Profiler::getHistory() const
+{
+    return m_History;
+}
+
+Percentiles Profiler::computePercentiles(std::vector<float>& values)
+// percentiles of a series of times, negative values (unavailable) are skipped, values gets sorted
+{
+    values.erase(std::remove_if(values.begin(), values.end(), [](float v) { return v < 0.0f; }), values.end());
+
+    Percentiles result = { -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, (unsigned int)values.size() };
+    if (values.empty())
+        return result;
+
+    std::sort(values.begin(), values.end());
+    // nearest-rank method
+    auto rank = [&values](float p) {
+        size_t index = (size_t)(p * values.size() + 0.5f);
+        return values[std::min(index == 0 ? 0 : index - 1, values.size() - 1)];
+    };
+    double sum = 0.0;
+    for (float v : values)
+        sum += v;
+
+    result.p50 = rank(0.50f);
+    result.p95 = rank(0.95f);
+    result.p99 = rank(0.99f);
+    result.mean = (float)(sum / values.size());
+    result.max = values.back();
+    return result;
+}
+
+bool Profiler::exportCSV(const std::string& path) const
+// one line per frame in the history
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cout << "ERROR::PROFILER::CANNOT_WRITE " << path << std::endl;
+        return false;
+    }
+
+    std::vector<FrameStats> frames;
+    m_History.snapshot(frames);
+    unsigned int zoneCount = getZoneCount();
+
+    file << "frame,cpu_ms,gpu_ms";
+    for (unsigned int z = 0; z < zoneCount; z++)
+        file << "," << m_ZoneNames[z] << "_cpu_ms," << m_ZoneNames[z] << "_gpu_ms";
+    for (unsigned int c = 0; c < m_CounterCount; c++)
+        file << "," << m_CounterNames[c];
+    file << "\n";
+
+    file << std::fixed << std::setprecision(4);
+    for (const FrameStats& f : frames)
+    {
+        file << f.frameIndex << "," << f.cpuFrameMs << "," << f.gpuFrameMs;
+        for (unsigned int z = 0; z < zoneCount; z++)
+            file << "," << f.cpuZoneMs[z] << "," << f.gpuZoneMs[z];
+        for (unsigned int c = 0; c < m_CounterCount; c++)
+            file << "," << f.counters[c];
+        file << "\n";
+    }
+    return true;
+}
+
+static void writePercentilesJSON(std::ofstream& file, const Percentiles& p)
+{
+    file << "{ \"count\": " << p.count << ", \"mean\": " << p.mean << ", \"p50\": " << p.p50
+        << ", \"p95\": " << p.p95 << ", \"p99\": " << p.p99 << ", \"max\": " << p.max << " }";
+}
+
+bool Profiler::exportJSON(const std::string& path) const
+// percentiles of the frame and zone times in the history
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cout << "ERROR::PROFILER::CANNOT_WRITE " << path << std::endl;
+        return false;
+    }
+
+    std::vector<FrameStats> frames;
+    m_History.snapshot(frames);
+    unsigned int zoneCount = getZoneCount();
+
+    std::vector<float> values;
+    auto collect = [&](auto selector) {
+        values.clear();
+        for (const FrameStats& f : frames)
+            values.push_back(selector(f));
+        return computePercentiles(values);
+    };
+
+    file << std::fixed << std::setprecision(4);
+    file << "{\n  \"frames\": " << frames.size() << ",\n";
+    file << "  \"cpu_frame_ms\": ";
+    writePercentilesJSON(file, collect([](const FrameStats& f) { return f.cpuFrameMs; }));
+    file << ",\n  \"gpu_frame_ms\": ";
+    writePercentilesJSON(file, collect([](const FrameStats& f) { return f.gpuFrameMs; }));
+    file << ",\n  \"zones\": {";
+    for (unsigned int z = 0; z < zoneCount; z++)
+    {
+        file << (z ? "," : "") << "\n    \"" << m_ZoneNames[z] << "\": {\n      \"cpu_ms\": ";
+        writePercentilesJSON(file, collect([z](const FrameStats& f) { return f.cpuZoneMs[z]; }));
+        file << ",\n      \"gpu_ms\": ";
+        writePercentilesJSON(file, collect([z](const FrameStats& f) { return f.gpuZoneMs[z]; }));
+        file << "\n    }";
+    }
+    file << "\n  },\n  \"counters\": {";
+    for (unsigned int c = 0; c < m_CounterCount; c++)
+    {
+        file << (c ? "," : "") << "\n    \"" << m_CounterNames[c] << "\": ";
+        writePercentilesJSON(file, collect([c](const FrameStats& f) { return (float)f.counters[c]; }));
+    }
+    file << "\n  }\n}\n";
+    return true;
+}
+
+void Profiler::printSummary() const
+{
+    std::vector<FrameStats> frames;
+    m_History.snapshot(frames);
+
+    std::vector<float> cpu, gpu;
+    for (const FrameStats& f : frames)
+    {
+        cpu.push_back(f.cpuFrameMs);
+        gpu.push_back(f.gpuFrameMs);
+    }
+    Percentiles cpuP = computePercentiles(cpu);
+    Percentiles gpuP = computePercentiles(gpu);
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Frame times over " << frames.size() << " frames (ms)" << std::endl;
+    std::cout << "  CPU  p50 " << cpuP.p50 << "  p95 " << cpuP.p95 << "  p99 " << cpuP.p99 << "  max " << cpuP.max << std::endl;
+    std::cout << "  GPU  p50 " << gpuP.p50 << "  p95 " << gpuP.p95 << "  p99 " << gpuP.p99 << "  max " << gpuP.max << std::endl;
+    for (unsigned int c = 0; c < m_CounterCount; c++)
+    {
+        double sum = 0.0;
+        for (const FrameStats& f : frames)
+            sum += f.counters[c];
+        std::cout << "  " << m_CounterNames[c] << ": " << (frames.empty() ? 0.0 : sum / frames.size()) << " per frame" << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Profiler settings
+const unsigned int PROFILER_MAX_ZONES = 32;    // named CPU/GPU zones
+const unsigned int PROFILER_MAX_COUNTERS = 32; // named per-frame counters (draw calls, state changes, worker load, ...)
+const unsigned int PROFILER_HISTORY = 4096;    // frames kept in the stats ring buffer
+const unsigned int PROFILER_GPU_FRAMES = 3;    // query sets in flight, results are read PROFILER_GPU_FRAMES - 1 frames later
+
+// Everything measured for one frame, times are in milliseconds (-1 when unavailable)
+struct FrameStats
+{
+    uint64_t frameIndex;
+    float cpuFrameMs;
+    float gpuFrameMs;
+    float cpuZoneMs[PROFILER_MAX_ZONES];
+    float gpuZoneMs[PROFILER_MAX_ZONES];
+    double counters[PROFILER_MAX_COUNTERS];
+};
+
+// Ring buffer of the last Capacity items with a single writer.
+// Readers on any thread copy items out without locking; every slot carries a sequence number (seqlock)
+// so a reader can tell when the writer overwrote the slot while it was being copied.
+template <typename T, unsigned int Capacity>
+class RingBuffer
+{
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence; // 2 * index + 2 when item index is complete, odd while being written
+        T value;
+    };
+    Slot m_Slots[Capacity];
+    std::atomic<uint64_t> m_Head; // number of items ever pushed
+
+public:
+    RingBuffer() : m_Head(0)
+    {
+        for (unsigned int i = 0; i < Capacity; i++)
+            m_Slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+
+    // writer only
+    void push(const T& value)
+    {
+        uint64_t index = m_Head.load(std::memory_order_relaxed);
+        Slot& slot = m_Slots[index % Capacity];
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.value = value;
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+        m_Head.store(index + 1, std::memory_order_release);
+    }
+
+    // copy item number index, false if it is not (or no longer) in the buffer
+    bool read(uint64_t index, T& out) const
+    {
+        const Slot& slot = m_Slots[index % Capacity];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * index + 2)
+            return false;
+        out = slot.value;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == sequence;
+    }
+
+    // copy all items still in the buffer, oldest first
+    void snapshot(std::vector<T>& out) const
+    {
+        out.clear();
+        uint64_t head = m_Head.load(std::memory_order_acquire);
+        uint64_t first = head > Capacity ? head - Capacity : 0;
+        out.reserve((size_t)(head - first));
+        T value;
+        for (uint64_t i = first; i < head; i++)
+            if (read(i, value))
+                out.push_back(value);
+    }
+
+    uint64_t size() const
+    {
+        uint64_t head = m_Head.load(std::memory_order_acquire);
+        return head > Capacity ? Capacity : head;
+    }
+
+    uint64_t totalPushed() const
+    {
+        return m_Head.load(std::memory_order_acquire);
+    }
+};
+
+// p50/p95/p99 of a series of frame times
+struct Percentiles
+{
+    float p50;
+    float p95;
+    float p99;
+    float mean;
+    float max;
+    unsigned int count;
+};
+
+// Frame-time profiler: scoped CPU zones, GL_TIME_ELAPSED GPU zones and a ring buffer of the last PROFILER_HISTORY frames.
+// GPU queries are multi-buffered over PROFILER_GPU_FRAMES frames and only read once available, so they never stall the pipeline.
+class Profiler
+{
+private:
+    // queries and CPU times of a frame whose GPU results are not read back yet
+    struct PendingFrame
+    {
+        bool inUse;
+        FrameStats stats;
+        unsigned int frameQueries[2];                   // GL_TIMESTAMP at begin and end of the frame
+        unsigned int zoneQueries[PROFILER_MAX_ZONES];   // GL_TIME_ELAPSED per zone
+        bool zoneUsed[PROFILER_MAX_ZONES];
+    };
+
+    bool m_Initialized;
+    uint64_t m_FrameIndex;
+    std::chrono::steady_clock::time_point m_FrameStart;
+    PendingFrame m_Pending[PROFILER_GPU_FRAMES];
+    int m_ActiveGpuZone;
+
+    // zones are registered once per call site, CPU times may be added from any thread
+    std::mutex m_ZoneMutex;
+    std::atomic<unsigned int> m_ZoneCount;
+    std::string m_ZoneNames[PROFILER_MAX_ZONES];
+    std::atomic<uint64_t> m_CpuZoneNs[PROFILER_MAX_ZONES];
+
+    // counters are registered and set from the render thread only
+    unsigned int m_CounterCount;
+    std::string m_CounterNames[PROFILER_MAX_COUNTERS];
+    double m_Counters[PROFILER_MAX_COUNTERS];
+
+    RingBuffer<FrameStats, PROFILER_HISTORY> m_History;
+
+    Profiler();
+    // read back the GPU queries of a pending frame and push it to the history, false if results are not ready
+    bool resolve(PendingFrame& frame, bool wait);
+
+public:
+    static Profiler& Get();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // create the GPU query pools, needs a current OpenGL context
+    void init();
+    // read back the remaining frames and delete the queries
+    void shutdown();
+
+    // call at the start of the frame, and endFrame() after swapping buffers. The CPU frame time runs from cpuStart,
+    // which a frame recorded on another thread passes from where its recording started
+    void beginFrame(std::chrono::steady_clock::time_point cpuStart = std::chrono::steady_clock::now());
+    void endFrame();
+
+    // returns the id of zone name, registering it on first use
+    int registerZone(const char* name);
+    void addCpuTime(int zone, uint64_t nanoseconds);
+    void beginGpuZone(int zone);
+    void endGpuZone(int zone);
+
+    // returns the id of counter name, registering it on first use
+    int registerCounter(const char* name);
+    // counters start at 0 every frame, render thread only
+    void setCounter(int counter, double value);
+    void addCounter(int counter, double value);
+
+    unsigned int getZoneCount() const;
+    const std::string& getZoneName(int zone) const;
+    unsigned int getCounterCount() const;
+    const std::string& getCounterName(int counter) const;
+    const RingBuffer<FrameStats, PROFILER_HISTORY>& getHistory() const;
+
+    // percentiles of a series of times, negative values (unavailable) are skipped, values gets sorted
+    static Percentiles computePercentiles(std::vector<float>& values);
+
+    // write the history to disk
+    bool exportCSV(const std::string& path) const;
+    bool exportJSON(const std::string& path) const;
+    void printSummary() const;
+};
+
+// RAII helpers, use through the PROFILE_* macros
+class CpuZone
+{
+private:
+    int m_Zone;
+    std::chrono::steady_clock::time_point m_Start;
+public:
+    CpuZone(int zone) : m_Zone(zone), m_Start(std::chrono::steady_clock::now()) {}
+    ~CpuZone()
+    {
+        uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Start).count();
+        Profiler::Get().addCpuTime(m_Zone, ns);
+    }
+};
+
+class GpuZone
+{
+private:
+    int m_Zone;
+public:
+    GpuZone(int zone) : m_Zone(zone) { Profiler::Get().beginGpuZone(m_Zone); }
+    ~GpuZone() { Profiler::Get().endGpuZone(m_Zone); }
+};
+
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+
+#ifndef LEARNOPENGL_DISABLE_PROFILER
+// time the rest of the enclosing scope on the CPU (zones may nest and may be used from any thread)
+#define PROFILE_CPU_ZONE(name) \
+    static const int PROFILER_CONCAT(profilerZone, __LINE__) = Profiler::Get().registerZone(name); \
+    CpuZone PROFILER_CONCAT(profilerCpuZone, __LINE__)(PROFILER_CONCAT(profilerZone, __LINE__))
+// time the rest of the enclosing scope on the GPU and CPU (render thread only, GPU zones may NOT nest)
+#define PROFILE_GPU_ZONE(name) \
+    static const int PROFILER_CONCAT(profilerZone, __LINE__) = Profiler::Get().registerZone(name); \
+    CpuZone PROFILER_CONCAT(profilerCpuZone, __LINE__)(PROFILER_CONCAT(profilerZone, __LINE__)); \
+    GpuZone PROFILER_CONCAT(profilerGpuZone, __LINE__)(PROFILER_CONCAT(profilerZone, __LINE__))
+#else
+#define PROFILE_CPU_ZONE(name)
+#define PROFILE_GPU_ZONE(name)
+#endif
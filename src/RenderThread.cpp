@@ -0,0 +1,129 @@
+#include "RenderThread.h"
+#include "Profiler.h"
+
+#include <chrono>
+
+RenderThread::RenderThread()
+    : m_SubmittedCount(0), m_ExecutedCount(0), m_Stopping(false), m_WaitMs(0.0), m_BytesCounter(-1), m_CommandsCounter(-1)
+{
+    for (unsigned int i = 0; i < RENDER_FRAME_PACKETS; i++)
+        m_Packets[i].frame = 0;
+}
+
+RenderThread::~RenderThread()
+{
+    stop();
+}
+
+void RenderThread::start(std::function<void(bool)> makeCurrent)
+// hand the context over to a new render thread, makeCurrent(false) releases it here first
+{
+    if (m_Thread.joinable())
+        return;
+    m_MakeCurrent = makeCurrent;
+    m_MakeCurrent(false);
+    m_Stopping = false;
+    m_Thread = std::thread(&RenderThread::run, this);
+}
+
+void RenderThread::stop()
+// execute what is submitted, stop the thread and make the context current here again
+{
+    if (!m_Thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_Submitted.notify_one();
+    m_Thread.join();
+    m_MakeCurrent(true);
+}
+
+void RenderThread::execute(FramePacket& packet)
+// run the packet's commands, on whichever thread owns the context
+{
+    Profiler& profiler = Profiler::Get();
+    if (m_BytesCounter < 0)
+    {
+        m_BytesCounter = profiler.registerCounter("command_bytes");
+        m_CommandsCounter = profiler.registerCounter("commands");
+    }
+    // counters are reset by the endFrame() recorded at the end of the packet, so these count for this frame
+    profiler.setCounter(m_BytesCounter, (double)packet.commands.getBytes());
+    profiler.setCounter(m_CommandsCounter, packet.commands.getCount());
+    packet.commands.execute();
+}
+
+void RenderThread::run()
+// render thread: executes the submitted packets in order until stopped
+{
+    m_MakeCurrent(true);
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    for (;;)
+    {
+        m_Submitted.wait(lock, [this] { return m_Stopping || m_ExecutedCount < m_SubmittedCount; });
+        if (m_ExecutedCount == m_SubmittedCount)
+            break;      // stopping, and nothing left to execute
+        FramePacket& packet = m_Packets[m_ExecutedCount % RENDER_FRAME_PACKETS];
+        lock.unlock();
+        execute(packet);
+        lock.lock();
+        m_ExecutedCount++;
+        m_Executed.notify_one();
+    }
+    lock.unlock();
+    m_MakeCurrent(false);
+}
+
+FramePacket& RenderThread::begin()
+// packet to record the next frame into, waits while it is still in use
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    // packet n shares its slot with packet n - RENDER_FRAME_PACKETS, which must have been executed
+    uint64_t frame = m_SubmittedCount;
+    if (m_ExecutedCount + RENDER_FRAME_PACKETS <= frame)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        m_Executed.wait(lock, [this, frame] { return m_ExecutedCount + RENDER_FRAME_PACKETS > frame; });
+        m_WaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    FramePacket& packet = m_Packets[frame % RENDER_FRAME_PACKETS];
+    packet.frame = frame;
+    return packet;
+}
+
+void RenderThread::submit()
+// hand the packet from begin() over for execution
+{
+    if (!m_Thread.joinable())
+    {
+        // no render thread: execute it right away
+        FramePacket& packet = m_Packets[m_SubmittedCount % RENDER_FRAME_PACKETS];
+        execute(packet);
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_SubmittedCount++;
+        m_ExecutedCount++;
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_SubmittedCount++;
+    }
+    m_Submitted.notify_one();
+}
+
+void RenderThread::finish()
+// wait until every submitted packet has been executed
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Executed.wait(lock, [this] { return m_ExecutedCount == m_SubmittedCount; });
+}
+
+double RenderThread::getWaitMs()
+// main thread milliseconds spent waiting for the render thread in begin() since the last call
+{
+    double waitMs = m_WaitMs;
+    m_WaitMs = 0.0;
+    return waitMs;
+}
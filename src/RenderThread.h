@@ -0,0 +1,66 @@
+#pragma once
+
+#include "CommandBuffer.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+const unsigned int RENDER_FRAME_PACKETS = 2;    // one recorded by the main thread while the other is executed
+
+// Everything the render thread needs for one frame: the commands, and the data they point to in the same allocator
+struct FramePacket
+{
+    CommandBuffer commands;
+    uint64_t frame;
+};
+
+// Executes the frames recorded by the main thread. Once start()ed, a render thread owns the OpenGL context and
+// runs each submitted packet while the main thread (input, simulation, culling) records the next one, at most one
+// frame ahead: begin() waits for the packet executed two frames ago to be free again. Without start() every packet
+// runs on the main thread as soon as it is submitted, so both modes go through the same recorded commands.
+class RenderThread
+{
+private:
+    FramePacket m_Packets[RENDER_FRAME_PACKETS];
+    std::function<void(bool)> m_MakeCurrent;    // makes the context current (true) or not (false) on the calling thread
+    std::thread m_Thread;
+    std::mutex m_Mutex;
+    std::condition_variable m_Submitted;
+    std::condition_variable m_Executed;
+    uint64_t m_SubmittedCount;                  // packets submitted, guarded by m_Mutex
+    uint64_t m_ExecutedCount;                   // packets executed, guarded by m_Mutex
+    bool m_Stopping;                            // guarded by m_Mutex
+    double m_WaitMs;                            // main thread time spent in begin() since the last getWaitMs()
+    int m_BytesCounter;
+    int m_CommandsCounter;
+
+    void execute(FramePacket& packet);
+    void run();
+
+public:
+    RenderThread();
+    // Destructor, stops the thread
+    ~RenderThread();
+
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    // hand the context over to a new render thread, makeCurrent(false) releases it here first
+    void start(std::function<void(bool)> makeCurrent);
+    // execute what is submitted, stop the thread and make the context current here again
+    void stop();
+    bool isThreaded() const { return m_Thread.joinable(); }
+
+    // packet to record the next frame into, waits while it is still in use
+    FramePacket& begin();
+    // hand the packet from begin() over for execution
+    void submit();
+    // wait until every submitted packet has been executed
+    void finish();
+
+    // main thread milliseconds spent waiting for the render thread in begin() since the last call
+    double getWaitMs();
+};
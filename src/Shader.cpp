@@ -1,16 +1,64 @@
 #include "Shader.h"
+#include "FrameUniforms.h"
+#include "GLStateCache.h"
+#include "ShaderCache.h"
 
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// KHR_parallel_shader_compile / ARB_parallel_shader_compile, not in the core profile GLAD was generated for
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+static bool hasParallelShaderCompile()
+// true if the driver can report whether a link finished without blocking on it
+{
+    static int supported = -1;
+    if (supported == -1)
+    {
+        supported = 0;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (extension && (strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 || strcmp(extension, "GL_ARB_parallel_shader_compile") == 0))
+                supported = 1;
+        }
+    }
+    return supported == 1;
+}
+
 Shader::Shader(const char* vertexPath, const char* fragmentPath)
 // constructor reads and builds the shader
+    : m_VertexPath(vertexPath), m_FragmentPath(fragmentPath), m_PendingProgram(0), m_PendingKey(0), m_PendingFrames(0)
 {
     // 1. retrieve the vertex/fragment source code from filePath ------------------------------------------
     std::string vertexCode;
     std::string fragmentCode;
+    readSources(vertexCode, fragmentCode);
+
+    // 2. load the linked program from the binary cache, or build it from source and cache it ----------------
+    ShaderCache& shaderCache = ShaderCache::Get();
+    uint64_t key = shaderCache.computeKey(vertexCode, fragmentCode);
+    m_RendererID = shaderCache.load(key);
+    if (m_RendererID == 0)
+    {
+        m_RendererID = buildProgram(vertexCode.c_str(), fragmentCode.c_str());
+        if (checkProgram(m_RendererID))
+            shaderCache.store(key, m_RendererID);
+    }
+
+    setupProgram();
+}
+
+bool Shader::readSources(std::string& vertexCode, std::string& fragmentCode) const
+// read both source files, false if one of them can't be read
+{
     std::ifstream vShaderFile;
     std::ifstream fShaderFile;
     // ensure ifstream objects can throw exceptions:
@@ -19,8 +67,8 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     try
     {
         // open files
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
+        vShaderFile.open(m_VertexPath);
+        fShaderFile.open(m_FragmentPath);
         std::stringstream vShaderStream, fShaderStream;
         // read file's buffer contents into streams
         vShaderStream << vShaderFile.rdbuf();
@@ -35,57 +83,162 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     catch (std::ifstream::failure e)
     {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        return false;
     }
-    const char* vShaderCode = vertexCode.c_str();
-    const char* fShaderCode = fragmentCode.c_str();
+    return true;
+}
+
+void Shader::setupProgram()
+// per-program setup after a successful link (or binary load)
+{
+    // the per-frame uniforms are shared by all programs through one uniform buffer at a fixed binding point
+    unsigned int frameBlock = glGetUniformBlockIndex(m_RendererID, "FrameUniforms");
+    if (frameBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(m_RendererID, frameBlock, FRAME_UNIFORMS_BINDING);
+
+    reflectUniforms();
+}
 
-    // 2. compile shaders --------------------------------------------------------------------------------
+unsigned int Shader::buildProgram(const char* vShaderCode, const char* fShaderCode)
+// compile both stages and start linking them, without waiting for the result (see checkProgram())
+{
     unsigned int vertex, fragment;    // m_RendererID for vertex shader, and fragment shader
-    int success;
-    char infoLog[512];
 
     // vertex Shader
     vertex = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertex, 1, &vShaderCode, NULL); // attach the shader source code to the shader object
     glCompileShader(vertex); // compile the shader
-    // check if compilation was successful after the call to glCompileShader()
-    checkCompileErrors(vertex, "VERTEX");
 
     // fragment Shader
     fragment = glCreateShader(GL_FRAGMENT_SHADER);
     glShaderSource(fragment, 1, &fShaderCode, NULL); // attach the shader source code to the shader object
     glCompileShader(fragment); // compile the shader
-    // check if compilation was successful after the call to glCompileShader()
-    checkCompileErrors(fragment, "FRAGMENT");
 
     // shader Program
-    m_RendererID = glCreateProgram(); // shader Program ID
-    glAttachShader(m_RendererID, vertex);
-    glAttachShader(m_RendererID, fragment);
-    glLinkProgram(m_RendererID);
-    // print linking errors if any
-    checkCompileErrors(m_RendererID, "PROGRAM");
+    unsigned int program = glCreateProgram(); // shader Program ID
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    // ask the driver to keep the binary around for the ShaderCache (OpenGL 4.1, the entry point is NULL before)
+    if (ShaderCache::Get().isSupported())
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
 
-    // delete the shaders as they're linked into our program now and no longer necessary
+    // flag the shaders for deletion, they stay alive (and their logs readable) until checkProgram() detaches them
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+    return program;
+}
+
+bool Shader::checkProgram(unsigned int program)
+// wait for the link started by buildProgram(), print compile/link errors, true if it linked
+{
+    unsigned int shaders[2];
+    GLsizei count = 0;
+    glGetAttachedShaders(program, 2, &count, shaders);
+    for (GLsizei i = 0; i < count; i++)
+    {
+        // check if compilation was successful
+        int type = 0;
+        glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+        checkCompileErrors(shaders[i], type == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT");
+    }
+    // print linking errors if any
+    checkCompileErrors(program, "PROGRAM");
+    int success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+    // the shaders are linked into our program now and no longer necessary, detaching deletes them
+    for (GLsizei i = 0; i < count; i++)
+        glDetachShader(program, shaders[i]);
+    return success != 0;
 }
 
 Shader::~Shader()
 {
+    if (m_PendingProgram)
+        glDeleteProgram(m_PendingProgram);
+    GLStateCache::Get().forgetProgram(m_RendererID);
     glDeleteProgram(m_RendererID);
 }
 
+bool Shader::reload()
+// re-read the source files and start building a new program in the background, the current one stays in use
+{
+    std::string vertexCode;
+    std::string fragmentCode;
+    if (!readSources(vertexCode, fragmentCode))
+        return false;
+
+    // a newer edit supersedes a build that is still running
+    if (m_PendingProgram)
+        glDeleteProgram(m_PendingProgram);
+    m_PendingKey = ShaderCache::Get().computeKey(vertexCode, fragmentCode);
+    m_PendingProgram = buildProgram(vertexCode.c_str(), fragmentCode.c_str());
+    m_PendingFrames = 0;
+    return true;
+}
+
+bool Shader::updateReload()
+// once per frame: if the program started by reload() has linked, swap it in. True when it was swapped in this call,
+// the caller then has to set its uniforms again and re-resolve its UniformHandles (locations may have changed)
+{
+    if (m_PendingProgram == 0)
+        return false;
+
+    m_PendingFrames++;
+    if (hasParallelShaderCompile())
+    {
+        // the driver compiles on its own threads, only look at the result once it is done
+        int completed = 0;
+        glGetProgramiv(m_PendingProgram, GL_COMPLETION_STATUS_KHR, &completed);
+        if (!completed)
+            return false;
+    }
+    else if (m_PendingFrames < 2)
+    {
+        // no way to ask without blocking: give the driver a frame before checking
+        return false;
+    }
+
+    unsigned int program = m_PendingProgram;
+    m_PendingProgram = 0;
+    if (!checkProgram(program))
+    {
+        std::cout << "Shader reload of " << m_VertexPath << " / " << m_FragmentPath << " failed, keeping the previous program" << std::endl;
+        glDeleteProgram(program);
+        return false;
+    }
+
+    GLStateCache::Get().forgetProgram(m_RendererID);
+    glDeleteProgram(m_RendererID);
+    m_RendererID = program;
+    setupProgram();
+    ShaderCache::Get().store(m_PendingKey, m_RendererID);
+    std::cout << "Reloaded shader " << m_VertexPath << " / " << m_FragmentPath << std::endl;
+    return true;
+}
+
+bool Shader::isReloading() const
+{
+    return m_PendingProgram != 0;
+}
+
+bool Shader::dependsOn(const std::string& path) const
+// true if path is one of the source files
+{
+    return path == m_VertexPath || path == m_FragmentPath;
+}
+
 void Shader::use() const
 // use/activate the shader
 {
-    glUseProgram(m_RendererID);
+    GLStateCache::Get().useProgram(m_RendererID);
 }
 
 void Shader::unuse() const
 // unuse/deactivate the shader
 {
-    glUseProgram(0);
+    GLStateCache::Get().useProgram(0);
 }
 
 void Shader::checkCompileErrors(unsigned int shader, std::string type)
@@ -142,13 +295,89 @@ void Shader::setMat4f(const std::string& name, glm::mat4 value)
 int Shader::GetUniformLocation(const std::string& name)
 // check if uniform exists in the shader
 {
-    if (m_UniformLocationCache.find(name) != m_UniformLocationCache.end()) // For performance boost
-        return m_UniformLocationCache[name];
+    std::unordered_map<std::string, UniformInfo>::const_iterator it = m_Uniforms.find(name); // single lookup
+    if (it != m_Uniforms.end())
+        return it->second.location;
+
+    // not an active uniform: warn once and remember it
+    std::cout << "Warning! uniform " << name << " does not exist." << std::endl;
+    UniformInfo missing = { -1, GL_NONE };
+    m_Uniforms[name] = missing;
+    return -1;
+}
+
+void Shader::reflectUniforms()
+// query all active uniforms of the linked program with glGetActiveUniform
+{
+    m_Uniforms.clear();
+
+    int count = 0, maxLength = 0;
+    glGetProgramiv(m_RendererID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_RendererID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(maxLength > 0 ? maxLength : 1, '\0');
+
+    for (int i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = GL_NONE;
+        glGetActiveUniform(m_RendererID, (GLuint)i, maxLength, &length, &size, &type, &name[0]);
+        std::string uniformName(name.c_str(), length);
+
+        // members of uniform blocks have no location, they are set through their buffer
+        int location = glGetUniformLocation(m_RendererID, uniformName.c_str());
+        if (location == -1)
+            continue;
 
-    int location = glGetUniformLocation(m_RendererID, name.c_str());
-    if (location == -1)
+        UniformInfo info = { location, type };
+        m_Uniforms[uniformName] = info;
+        // arrays are reported as "name[0]", allow plain "name" as well
+        if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+            m_Uniforms[uniformName.substr(0, uniformName.size() - 3)] = info;
+    }
+}
+
+const Shader::UniformInfo* Shader::findUniform(const std::string& name) const
+// look up a reflected uniform, prints a warning and returns NULL if it does not exist
+{
+    std::unordered_map<std::string, UniformInfo>::const_iterator it = m_Uniforms.find(name);
+    if (it == m_Uniforms.end() || it->second.location == -1)
+    {
         std::cout << "Warning! uniform " << name << " does not exist." << std::endl;
+        return NULL;
+    }
+    return &it->second;
+}
 
-    m_UniformLocationCache[name] = location;
-    return location;
+void Shader::warnTypeMismatch(const std::string& name) const
+{
+    std::cout << "Warning! uniform " << name << " is set with a type that does not match its GLSL type." << std::endl;
 }
+
+// GLSL types accepted by UniformHandle<T>
+static bool isSamplerType(GLenum glType)
+// samplers and images are set with their texture unit as int
+{
+    switch (glType)
+    {
+    case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+    case GL_SAMPLER_1D_SHADOW: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+    case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_2D_ARRAY_SHADOW:
+    case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_BUFFER: case GL_SAMPLER_2D_RECT:
+    case GL_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D:
+    case GL_INT_SAMPLER_BUFFER: case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+    case GL_IMAGE_2D: case GL_IMAGE_3D: case GL_IMAGE_BUFFER:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool uniformTypeMatches(GLenum glType, const bool*) { return glType == GL_BOOL; }
+bool uniformTypeMatches(GLenum glType, const int*) { return glType == GL_INT || glType == GL_BOOL || isSamplerType(glType); }
+bool uniformTypeMatches(GLenum glType, const float*) { return glType == GL_FLOAT; }
+bool uniformTypeMatches(GLenum glType, const glm::vec2*) { return glType == GL_FLOAT_VEC2; }
+bool uniformTypeMatches(GLenum glType, const glm::vec3*) { return glType == GL_FLOAT_VEC3; }
+bool uniformTypeMatches(GLenum glType, const glm::vec4*) { return glType == GL_FLOAT_VEC4; }
+bool uniformTypeMatches(GLenum glType, const glm::mat3*) { return glType == GL_FLOAT_MAT3; }
+bool uniformTypeMatches(GLenum glType, const glm::mat4*) { return glType == GL_FLOAT_MAT4; }
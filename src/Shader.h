@@ -5,20 +5,81 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cstdint>
+#include <string>
 #include <unordered_map> // a hash map
 
+// upload a value to a uniform location of the program in use, one overload per supported type
+inline void setUniformValue(int location, bool value) { glUniform1i(location, (int)value); }
+inline void setUniformValue(int location, int value) { glUniform1i(location, value); }
+inline void setUniformValue(int location, float value) { glUniform1f(location, value); }
+inline void setUniformValue(int location, const glm::vec2& value) { glUniform2fv(location, 1, &value[0]); }
+inline void setUniformValue(int location, const glm::vec3& value) { glUniform3fv(location, 1, &value[0]); }
+inline void setUniformValue(int location, const glm::vec4& value) { glUniform4fv(location, 1, &value[0]); }
+inline void setUniformValue(int location, const glm::mat3& value) { glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void setUniformValue(int location, const glm::mat4& value) { glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
 
+// true if a uniform of GLSL type glType can be set from a T, one overload per supported type
+bool uniformTypeMatches(GLenum glType, const bool*);
+bool uniformTypeMatches(GLenum glType, const int*);
+bool uniformTypeMatches(GLenum glType, const float*);
+bool uniformTypeMatches(GLenum glType, const glm::vec2*);
+bool uniformTypeMatches(GLenum glType, const glm::vec3*);
+bool uniformTypeMatches(GLenum glType, const glm::vec4*);
+bool uniformTypeMatches(GLenum glType, const glm::mat3*);
+bool uniformTypeMatches(GLenum glType, const glm::mat4*);
+
+// Resolved uniform location of type T, get one with Shader::uniform<T>("name") after the program is built.
+// Setting it is a single glUniform* call: no string, no hashing. An invalid handle (-1) is silently ignored by OpenGL.
+template <typename T>
+class UniformHandle
+{
+private:
+    int m_Location;
+public:
+    UniformHandle(int location = -1) : m_Location(location) {}
+    // set the value, the program must be in use
+    void set(const T& value) const { setUniformValue(m_Location, value); }
+    bool isValid() const { return m_Location != -1; }
+    int getLocation() const { return m_Location; }
+};
 
 class Shader
 {
 private:
+    // active uniform of the program, from reflection
+    struct UniformInfo
+    {
+        int location;
+        GLenum type;
+    };
+
     // the program ID
     unsigned int m_RendererID;
-    // caching for uniforms
-    std::unordered_map<std::string, int> m_UniformLocationCache;
+    std::string m_VertexPath;
+    std::string m_FragmentPath;
+    // program being rebuilt by reload(), swapped in by updateReload() once it has linked
+    unsigned int m_PendingProgram;
+    uint64_t m_PendingKey;
+    unsigned int m_PendingFrames;
+    // all active uniforms, filled once after linking (names that were not found are cached with location -1)
+    std::unordered_map<std::string, UniformInfo> m_Uniforms;
 
+    // read both source files, false if one of them can't be read
+    bool readSources(std::string& vertexCode, std::string& fragmentCode) const;
+    // compile both stages and start linking them, without waiting for the result (see checkProgram())
+    unsigned int buildProgram(const char* vShaderCode, const char* fShaderCode);
+    // wait for the link started by buildProgram(), print compile/link errors, true if it linked
+    bool checkProgram(unsigned int program);
+    // per-program setup after a successful link (or binary load)
+    void setupProgram();
     // utility function for checking shader compilation/linking errors.
     void checkCompileErrors(unsigned int shader, std::string type);
+    // query all active uniforms of the linked program with glGetActiveUniform
+    void reflectUniforms();
+    // look up a reflected uniform, prints a warning and returns NULL if it does not exist
+    const UniformInfo* findUniform(const std::string& name) const;
+    void warnTypeMismatch(const std::string& name) const;
     // check if uniform exist in the shader
     int GetUniformLocation(const std::string& name);
 public:
@@ -30,11 +91,35 @@ public:
     void use() const;
     // unuse / deactivate the shader
     void unuse() const;
+
+    // hot-reload: re-read the source files and start building a new program in the background, the current one stays in use
+    bool reload();
+    // once per frame: if the program started by reload() has linked, swap it in. True when it was swapped in this call,
+    // the caller then has to set its uniforms again and re-resolve its UniformHandles (locations may have changed)
+    bool updateReload();
+    bool isReloading() const;
+    // true if path is one of the source files
+    bool dependsOn(const std::string& path) const;
     // utility uniform functions
     void setBool(const std::string& name, bool value);
     void setInt(const std::string& name, int value);
     void setFloat(const std::string& name, float value);
     void setMat4f(const std::string& name, glm::mat4 value);
+
+    // typed handle to a uniform, resolve once after construction and keep it for per-frame updates
+    template <typename T>
+    UniformHandle<T> uniform(const std::string& name) const
+    {
+        const UniformInfo* info = findUniform(name);
+        if (info == NULL)
+            return UniformHandle<T>();
+        if (!uniformTypeMatches(info->type, (const T*)NULL))
+        {
+            warnTypeMismatch(name);
+            return UniformHandle<T>();
+        }
+        return UniformHandle<T>(info->location);
+    }
 };
 
 
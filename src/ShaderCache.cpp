@@ -0,0 +1,141 @@
+#include "ShaderCache.h"
+#include "FileUtils.h"
+#include "MappedFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+ShaderCache::ShaderCache()
+    : m_Directory("cache/shaders"), m_Supported(false), m_DriverHash(0), m_Hits(0), m_Misses(0)
+{
+}
+
+ShaderCache& ShaderCache::Get()
+{
+    static ShaderCache instance;
+    return instance;
+}
+
+void ShaderCache::init()
+// query the driver once, on first use with a current context
+{
+    if (m_DriverHash != 0)
+        return;
+
+    // program binaries are OpenGL 4.1: on older contexts glProgramBinary/glGetProgramBinary are not loaded
+    GLint formats = 0;
+    if (GLAD_GL_VERSION_4_1)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    m_Supported = GLAD_GL_VERSION_4_1 && formats > 0;
+
+    const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+    uint64_t hash = hashBytes(&SHADER_CACHE_VERSION, sizeof(SHADER_CACHE_VERSION));
+    for (GLenum name : strings)
+    {
+        const char* value = (const char*)glGetString(name);
+        if (value)
+            hash = hashBytes(value, strlen(value) + 1, hash);
+    }
+    m_DriverHash = hash;
+}
+
+bool ShaderCache::isSupported()
+{
+    init();
+    return m_Supported;
+}
+
+uint64_t ShaderCache::computeKey(const std::string& vertexCode, const std::string& fragmentCode)
+// key of a program built from these sources with the current driver, needs a current context
+{
+    init();
+    uint64_t key = hashString(vertexCode, m_DriverHash);
+    // separator, so that moving text from one stage to the other changes the key
+    key = hashBytes("", 1, key);
+    return hashString(fragmentCode, key);
+}
+
+std::string ShaderCache::getCachePath(uint64_t key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return m_Directory + "/" + name;
+}
+
+unsigned int ShaderCache::load(uint64_t key)
+// create a program from the cached binary, 0 if there is none or the driver rejects it
+{
+    if (!isSupported())
+        return 0;
+
+    MappedFile file;
+    if (!file.open(getCachePath(key)) || file.size() < sizeof(ShaderCacheHeader))
+    {
+        m_Misses++;
+        return 0;
+    }
+    const ShaderCacheHeader* header = (const ShaderCacheHeader*)file.data();
+    if (memcmp(header->magic, "LSHD", 4) != 0 || header->version != SHADER_CACHE_VERSION || header->key != key ||
+        header->binarySize != file.size() - sizeof(ShaderCacheHeader))
+    {
+        m_Misses++;
+        return 0;
+    }
+
+    unsigned int program = glCreateProgram();
+    glProgramBinary(program, header->binaryFormat, file.data() + sizeof(ShaderCacheHeader), (GLsizei)header->binarySize);
+    int success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        // stale binary (e.g. the driver changed without changing its strings): rebuild from source and overwrite it
+        glDeleteProgram(program);
+        m_Misses++;
+        return 0;
+    }
+    m_Hits++;
+    return program;
+}
+
+void ShaderCache::store(uint64_t key, unsigned int program)
+// store the binary of a linked program, it must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+{
+    if (!isSupported())
+        return;
+
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<unsigned char> data(sizeof(ShaderCacheHeader) + length);
+    GLenum binaryFormat = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &binaryFormat, data.data() + sizeof(ShaderCacheHeader));
+    if (written <= 0)
+        return;
+
+    ShaderCacheHeader header;
+    memcpy(header.magic, "LSHD", 4);
+    header.version = SHADER_CACHE_VERSION;
+    header.key = key;
+    header.binaryFormat = binaryFormat;
+    header.binarySize = (uint32_t)written;
+    memcpy(data.data(), &header, sizeof(header));
+
+    std::string path = getCachePath(key);
+    if (!createDirectories(m_Directory) || !writeFileAtomic(path, data.data(), sizeof(ShaderCacheHeader) + written))
+        std::cout << "Failed to write shader cache file " << path << std::endl;
+}
+
+unsigned int ShaderCache::getHits() const
+{
+    return m_Hits;
+}
+
+unsigned int ShaderCache::getMisses() const
+{
+    return m_Misses;
+}
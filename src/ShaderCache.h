@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+
+const unsigned int SHADER_CACHE_VERSION = 1; // bump when the file layout changes
+
+// Header at the start of a program binary file, followed by the binary
+struct ShaderCacheHeader
+{
+    char magic[4];          // "LSHD"
+    uint32_t version;
+    uint64_t key;           // hash of the sources and the driver strings
+    uint32_t binaryFormat;  // from glGetProgramBinary
+    uint32_t binarySize;
+};
+
+// On-disk cache of linked programs (glGetProgramBinary / glProgramBinary), so that startup skips compiling and linking.
+// Binaries are only valid for the driver that produced them, so the vendor, renderer and version strings are part of the key;
+// a binary the driver rejects anyway (e.g. after a driver update with the same strings) is simply rebuilt from source.
+class ShaderCache
+{
+private:
+    std::string m_Directory;
+    bool m_Supported;       // the driver offers at least one binary format
+    uint64_t m_DriverHash;
+    unsigned int m_Hits;
+    unsigned int m_Misses;
+
+    ShaderCache();
+    void init();
+    std::string getCachePath(uint64_t key) const;
+
+public:
+    static ShaderCache& Get();
+
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    // key of a program built from these sources with the current driver, needs a current context
+    uint64_t computeKey(const std::string& vertexCode, const std::string& fragmentCode);
+    // create a program from the cached binary, 0 if there is none or the driver rejects it
+    unsigned int load(uint64_t key);
+    // store the binary of a linked program, it must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+    void store(uint64_t key, unsigned int program);
+
+    // program binaries need OpenGL 4.1 and a driver with at least one binary format
+    bool isSupported();
+    unsigned int getHits() const;
+    unsigned int getMisses() const;
+};
@@ -0,0 +1,244 @@
+#include "StreamBuffer.h"
+#include "GLStateCache.h"
+#include "Profiler.h"
+
+#include <iostream>
+#include <utility>
+
+StreamBuffer::StreamBuffer()
+    : m_Buffer(0), m_Persistent(false), m_Mapped(NULL), m_Size(0), m_RegionSize(0), m_Region(0), m_Head(0), m_Flushed(0),
+      m_FrameBytes(0), m_Waits(0), m_BytesCounter(-1), m_WaitsCounter(-1), m_FrameWaits(0), m_OverflowFlushed(0), m_OverflowBytes(0)
+{
+    for (unsigned int i = 0; i < STREAM_FRAMES_IN_FLIGHT; i++)
+        m_Fences[i] = 0;
+}
+
+StreamBuffer& StreamBuffer::Get()
+{
+    static StreamBuffer instance;
+    return instance;
+}
+
+void StreamBuffer::init(std::size_t size)
+// create the buffer, needs a current context
+{
+    create(size);
+    std::cout << "stream buffer: " << (m_Size >> 10) << " KB, " << (m_Persistent ? "persistently mapped" : "glBufferSubData") << std::endl;
+}
+
+void StreamBuffer::shutdown()
+// delete the buffer, before the context goes away
+{
+    destroy();
+}
+
+void StreamBuffer::create(std::size_t size)
+// a new buffer of at least size bytes, starting at the first region
+{
+    m_RegionSize = (size + STREAM_FRAMES_IN_FLIGHT - 1) / STREAM_FRAMES_IN_FLIGHT;
+    m_Size = m_RegionSize * STREAM_FRAMES_IN_FLIGHT;
+    m_Persistent = GLAD_GL_VERSION_4_4 != 0;
+
+    glGenBuffers(1, &m_Buffer);
+    GLStateCache::Get().bindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+    if (m_Persistent)
+    {
+        // immutable storage may stay mapped while the GPU reads it; coherent, so writes need no explicit flush
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, m_Size, NULL, flags);
+        m_Mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, m_Size, flags);
+        if (!m_Mapped)
+        {
+            std::cout << "Warning! could not map the stream buffer persistently, uploading with glBufferSubData" << std::endl;
+            GLStateCache::Get().forgetBuffer(m_Buffer);
+            glDeleteBuffers(1, &m_Buffer);
+            glGenBuffers(1, &m_Buffer);
+            GLStateCache::Get().bindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+            m_Persistent = false;
+        }
+    }
+    if (!m_Persistent)
+    {
+        glBufferData(GL_COPY_WRITE_BUFFER, m_Size, NULL, GL_STREAM_DRAW);
+        m_Staging.resize(m_Size);
+        m_Mapped = m_Staging.data();
+    }
+    m_Region = 0;
+    m_Head = 0;
+    m_Flushed = 0;
+}
+
+static void deleteBuffer(unsigned int buffer)
+{
+    GLStateCache::Get().forgetBuffer(buffer);
+    glDeleteBuffers(1, &buffer);    // also unmaps it
+}
+
+void StreamBuffer::destroy()
+// delete every buffer and fence, the GPU keeps the storage alive as long as queued draws use it
+{
+    for (unsigned int i = 0; i < STREAM_FRAMES_IN_FLIGHT; i++)
+    {
+        if (m_Fences[i])
+            glDeleteSync(m_Fences[i]);
+        m_Fences[i] = 0;
+    }
+    if (m_Buffer)
+        deleteBuffer(m_Buffer);
+    m_Buffer = 0;
+    m_Mapped = NULL;
+    std::vector<unsigned char>().swap(m_Staging);
+
+    for (const OverflowBuffer& overflow : m_Overflow)
+        deleteBuffer(overflow.buffer);
+    m_Overflow.clear();
+    m_OverflowFlushed = 0;
+    m_OverflowBytes = 0;
+    for (const RetiredBuffers& retired : m_Retired)
+    {
+        glDeleteSync(retired.fence);
+        for (unsigned int buffer : retired.buffers)
+            deleteBuffer(buffer);
+    }
+    m_Retired.clear();
+}
+
+void StreamBuffer::deleteRetired()
+// delete the retired buffers the GPU is done with
+{
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < m_Retired.size(); i++)
+    {
+        RetiredBuffers& retired = m_Retired[i];
+        if (glClientWaitSync(retired.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            if (kept != i)
+                m_Retired[kept] = std::move(retired);
+            kept++;
+            continue;
+        }
+        glDeleteSync(retired.fence);
+        for (unsigned int buffer : retired.buffers)
+            deleteBuffer(buffer);
+    }
+    m_Retired.resize(kept);
+}
+
+void StreamBuffer::beginRegion()
+// start writing the current region, once the GPU is done with what was written there STREAM_FRAMES_IN_FLIGHT frames ago
+{
+    m_Head = m_Region * m_RegionSize;
+    m_Flushed = m_Head;
+    GLsync fence = m_Fences[m_Region];
+    if (!fence)
+        return;
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+        // the GPU is more than STREAM_FRAMES_IN_FLIGHT - 1 frames behind
+        m_Waits++;
+        m_FrameWaits++;
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+            ;
+    }
+    glDeleteSync(fence);
+    m_Fences[m_Region] = 0;
+}
+
+StreamAllocation StreamBuffer::allocate(std::size_t size, std::size_t alignment)
+// size bytes at a multiple of alignment (any value, e.g. sizeof(ImDrawVert)) in this frame's region
+{
+    StreamAllocation allocation;
+    m_FrameBytes += size;
+    std::size_t offset = (m_Head + alignment - 1) / alignment * alignment;
+    if (offset + size > (m_Region + 1) * m_RegionSize)
+    {
+        // this frame needs more than a region: this allocation gets a buffer of its own and the ring grows at endFrame().
+        // Replacing the ring now would unbind it from whatever was bound to it earlier in the frame
+        OverflowBuffer overflow;
+        glGenBuffers(1, &overflow.buffer);
+        GLStateCache::Get().bindBuffer(GL_COPY_WRITE_BUFFER, overflow.buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+        overflow.data.resize(size);
+        m_Overflow.push_back(std::move(overflow));
+        m_OverflowBytes += size + alignment;
+        allocation.data = m_Overflow.back().data.data();
+        allocation.buffer = m_Overflow.back().buffer;
+        allocation.offset = 0;
+        return allocation;
+    }
+    m_Head = offset + size;
+    allocation.data = m_Mapped + offset;
+    allocation.buffer = m_Buffer;
+    allocation.offset = (GLintptr)offset;
+    return allocation;
+}
+
+void StreamBuffer::flush()
+// make everything allocated so far visible to the GPU
+{
+    GLStateCache& stateCache = GLStateCache::Get();
+    for (; m_OverflowFlushed < m_Overflow.size(); m_OverflowFlushed++)
+    {
+        const OverflowBuffer& overflow = m_Overflow[m_OverflowFlushed];
+        stateCache.bindBuffer(GL_COPY_WRITE_BUFFER, overflow.buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, 0, overflow.data.size(), overflow.data.data());
+    }
+    if (m_Persistent || m_Head <= m_Flushed)
+        return;
+    stateCache.bindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, m_Flushed, m_Head - m_Flushed, m_Mapped + m_Flushed);
+    m_Flushed = m_Head;
+}
+
+void StreamBuffer::endFrame()
+// fence this frame's region and move on to the next one, waiting if the GPU still reads it. The ring grows here
+// if the frame overflowed it
+{
+    if (!m_Buffer)
+        return;
+    flush();
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (m_Overflow.empty())
+    {
+        m_Fences[m_Region] = fence;
+        m_Region = (m_Region + 1) % STREAM_FRAMES_IN_FLIGHT;
+        beginRegion();
+    }
+    else
+    {
+        // the frame overflowed its region: the ring and the one-off buffers are retired under this frame's fence, which
+        // signals after every earlier frame, and the next frame starts in a ring big enough for it
+        std::size_t needed = (m_Head - m_Region * m_RegionSize + m_OverflowBytes) * STREAM_FRAMES_IN_FLIGHT;
+        RetiredBuffers retired;
+        retired.fence = fence;
+        retired.buffers.push_back(m_Buffer);
+        for (const OverflowBuffer& overflow : m_Overflow)
+            retired.buffers.push_back(overflow.buffer);
+        m_Retired.push_back(std::move(retired));
+        for (unsigned int i = 0; i < STREAM_FRAMES_IN_FLIGHT; i++)
+        {
+            if (m_Fences[i])
+                glDeleteSync(m_Fences[i]);
+            m_Fences[i] = 0;
+        }
+        m_Overflow.clear();
+        m_OverflowFlushed = 0;
+        m_OverflowBytes = 0;
+
+        std::size_t grown = 2 * m_Size > needed ? 2 * m_Size : needed;
+        std::cout << "Warning! stream buffer grown to " << (grown >> 10) << " KB" << std::endl;
+        create(grown);
+    }
+    deleteRetired();
+
+    Profiler& profiler = Profiler::Get();
+    if (m_BytesCounter < 0)
+    {
+        m_BytesCounter = profiler.registerCounter("stream_bytes");
+        m_WaitsCounter = profiler.registerCounter("stream_waits");
+    }
+    profiler.setCounter(m_BytesCounter, (double)m_FrameBytes);
+    profiler.setCounter(m_WaitsCounter, (double)m_FrameWaits);
+    m_FrameBytes = 0;
+    m_FrameWaits = 0;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+const std::size_t STREAM_BUFFER_SIZE = 4 << 20;    // initial size in bytes, grows when a frame needs more
+const unsigned int STREAM_FRAMES_IN_FLIGHT = 3;     // regions of the ring, one per frame the GPU may still be reading
+
+// A piece of this frame's region: write size bytes to data, then call StreamBuffer::flush() before drawing from
+// (buffer, offset). The buffer differs for allocations that overflow the region and after the ring grows, and names of
+// retired buffers are reused, so bind it every time instead of keeping it
+struct StreamAllocation
+{
+    void* data;
+    unsigned int buffer;
+    GLintptr offset;
+};
+
+// Ring buffer for data that is written every frame (instance indices, per-frame uniforms, ImGui's vertices...).
+// One buffer is split into STREAM_FRAMES_IN_FLIGHT regions; each frame suballocates from its own region and fences
+// it in endFrame(), and a region is only reused once its fence signalled, so nothing is ever re-specified or
+// orphaned. With OpenGL 4.4 the buffer is created with glBufferStorage and mapped once, persistently and coherently,
+// so allocations are written in place and flush() does nothing. On 3.3 the allocations go to a copy in memory and
+// flush() uploads what was written since the last flush with one glBufferSubData.
+// A frame that needs more than a region gets a one-off buffer for each allocation that does not fit, and the ring is
+// replaced by a bigger one at endFrame(), so buffers bound earlier in the frame stay valid. Replaced and one-off
+// buffers are only deleted once a fence says the GPU is done with them.
+class StreamBuffer
+{
+private:
+    // buffer used for a single allocation this frame, its data is uploaded by the next flush()
+    struct OverflowBuffer
+    {
+        unsigned int buffer;
+        std::vector<unsigned char> data;
+    };
+    // buffers the GPU may still read, deleted once fence signalled
+    struct RetiredBuffers
+    {
+        std::vector<unsigned int> buffers;
+        GLsync fence;
+    };
+
+    unsigned int m_Buffer;
+    bool m_Persistent;              // glBufferStorage path
+    unsigned char* m_Mapped;        // persistent mapping, or the copy in memory
+    std::vector<unsigned char> m_Staging;
+    std::size_t m_Size;
+    std::size_t m_RegionSize;
+    unsigned int m_Region;          // written by this frame
+    std::size_t m_Head;             // next free byte of this frame's region, from the start of the buffer
+    std::size_t m_Flushed;          // staging path: written up to here
+    GLsync m_Fences[STREAM_FRAMES_IN_FLIGHT];
+    std::size_t m_FrameBytes;       // allocated this frame, for the profiler
+    unsigned int m_Waits;           // frames that had to wait for the GPU to release their region
+    int m_BytesCounter;
+    int m_WaitsCounter;
+    unsigned int m_FrameWaits;
+    std::vector<OverflowBuffer> m_Overflow;     // this frame's one-off buffers
+    std::size_t m_OverflowFlushed;              // of them, uploaded already
+    std::size_t m_OverflowBytes;
+    std::vector<RetiredBuffers> m_Retired;
+
+    StreamBuffer();
+    // a new buffer of at least size bytes, starting at the first region
+    void create(std::size_t size);
+    // delete every buffer and fence, the GPU keeps the storage alive as long as queued draws use it
+    void destroy();
+    // delete the retired buffers the GPU is done with
+    void deleteRetired();
+    // start writing the current region, once the GPU is done with what was written there STREAM_FRAMES_IN_FLIGHT frames ago
+    void beginRegion();
+
+public:
+    static StreamBuffer& Get();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // create the buffer, needs a current context
+    void init(std::size_t size = STREAM_BUFFER_SIZE);
+    // delete the buffer, before the context goes away
+    void shutdown();
+    bool isValid() const { return m_Buffer != 0; }
+    bool isPersistent() const { return m_Persistent; }
+
+    // size bytes at a multiple of alignment (any value, e.g. sizeof(ImDrawVert)) in this frame's region
+    StreamAllocation allocate(std::size_t size, std::size_t alignment = 4);
+    // make everything allocated so far visible to the GPU
+    void flush();
+    // fence this frame's region and move on to the next one, waiting if the GPU still reads it. The ring grows here
+    // if the frame overflowed it
+    void endFrame();
+
+    std::size_t getSize() const { return m_Size; }
+    unsigned int getWaits() const { return m_Waits; }
+};
@@ -0,0 +1,460 @@
+#include "TextureCache.h"
+#include "FileUtils.h"
+#include "stb_image/stb_image.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+static_assert(sizeof(TextureCacheHeader) == 408, "TextureCacheHeader is written to disk as is, its layout must not change");
+
+static const std::size_t LEVEL_ALIGNMENT = 16;
+
+// ------------------------------------------------------------------------
+// CookedTexture
+// ------------------------------------------------------------------------
+
+CookedTexture::CookedTexture()
+    : m_Data(NULL), m_Header(NULL)
+{
+}
+
+bool CookedTexture::isValid() const
+{
+    return m_Header != NULL;
+}
+
+bool CookedTexture::isCompressed() const
+{
+    return m_Header->format != TEXTURE_CACHE_RGBA8;
+}
+
+GLenum CookedTexture::getInternalFormat() const
+// internal format for glTexImage2D / glCompressedTexImage2D
+{
+    switch (m_Header->format)
+    {
+    case TEXTURE_CACHE_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TEXTURE_CACHE_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    default: return GL_RGBA8;
+    }
+}
+
+unsigned int CookedTexture::getBlockHeight() const
+// 4 for block-compressed formats, 1 otherwise: uploads must cover whole rows of blocks
+{
+    return isCompressed() ? 4 : 1;
+}
+
+std::size_t CookedTexture::getRowBytes(unsigned int level) const
+// bytes of one row of blocks (or pixels) of level
+{
+    std::size_t width = m_Header->levels[level].width;
+    switch (m_Header->format)
+    {
+    case TEXTURE_CACHE_BC1: return (width + 3) / 4 * 8;
+    case TEXTURE_CACHE_BC3: return (width + 3) / 4 * 16;
+    default: return width * 4;
+    }
+}
+
+unsigned int CookedTexture::getLevelCount() const
+{
+    return m_Header->levelCount;
+}
+
+unsigned int CookedTexture::getWidth(unsigned int level) const
+{
+    return m_Header->levels[level].width;
+}
+
+unsigned int CookedTexture::getHeight(unsigned int level) const
+{
+    return m_Header->levels[level].height;
+}
+
+const unsigned char* CookedTexture::getLevelData(unsigned int level) const
+{
+    return m_Data + m_Header->levels[level].offset;
+}
+
+std::size_t CookedTexture::getLevelSize(unsigned int level) const
+{
+    return (std::size_t)m_Header->levels[level].size;
+}
+
+// ------------------------------------------------------------------------
+// CPU mipmapping and block compression
+// ------------------------------------------------------------------------
+
+static void downsample(const unsigned char* src, unsigned int srcWidth, unsigned int srcHeight,
+                       unsigned char* dst, unsigned int dstWidth, unsigned int dstHeight)
+// 2x2 box filter (the same average glGenerateMipmap computes), odd edges repeat the last texel
+{
+    for (unsigned int y = 0; y < dstHeight; y++)
+    {
+        unsigned int y0 = 2 * y;
+        unsigned int y1 = y0 + 1 < srcHeight ? y0 + 1 : y0;
+        for (unsigned int x = 0; x < dstWidth; x++)
+        {
+            unsigned int x0 = 2 * x;
+            unsigned int x1 = x0 + 1 < srcWidth ? x0 + 1 : x0;
+            const unsigned char* a = src + (y0 * srcWidth + x0) * 4;
+            const unsigned char* b = src + (y0 * srcWidth + x1) * 4;
+            const unsigned char* c = src + (y1 * srcWidth + x0) * 4;
+            const unsigned char* d = src + (y1 * srcWidth + x1) * 4;
+            unsigned char* out = dst + (y * dstWidth + x) * 4;
+            for (int i = 0; i < 4; i++)
+                out[i] = (unsigned char)((a[i] + b[i] + c[i] + d[i] + 2) / 4);
+        }
+    }
+}
+
+static unsigned short packColor565(const float* color)
+{
+    int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+    int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+    int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+    r = r < 0 ? 0 : (r > 31 ? 31 : r);
+    g = g < 0 ? 0 : (g > 63 ? 63 : g);
+    b = b < 0 ? 0 : (b > 31 ? 31 : b);
+    return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void unpackColor565(unsigned short color, int* out)
+{
+    int r = (color >> 11) & 31;
+    int g = (color >> 5) & 63;
+    int b = color & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+static void encodeColorBlock(const unsigned char* block, unsigned char* out)
+// BC1 color block (8 bytes) of 16 RGBA pixels: endpoints at the extremes of the principal axis, always in 4-color mode
+{
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += block[i * 4 + c];
+    for (int c = 0; c < 3; c++)
+        mean[c] /= 16.0f;
+
+    float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }; // rr rg rb gg gb bb
+    for (int i = 0; i < 16; i++)
+    {
+        float r = block[i * 4 + 0] - mean[0];
+        float g = block[i * 4 + 1] - mean[1];
+        float b = block[i * 4 + 2] - mean[2];
+        covariance[0] += r * r; covariance[1] += r * g; covariance[2] += r * b;
+        covariance[3] += g * g; covariance[4] += g * b; covariance[5] += b * b;
+    }
+
+    // a few power iterations find the direction the colors spread along
+    float axis[3] = { 0.299f, 0.587f, 0.114f };
+    for (int iteration = 0; iteration < 4; iteration++)
+    {
+        float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+        float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+        float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+        float length = x * x + y * y + z * z;
+        if (length < 1e-6f)
+            break;
+        float scale = 1.0f / sqrtf(length);
+        axis[0] = x * scale; axis[1] = y * scale; axis[2] = z * scale;
+    }
+
+    float minProjection = 1e30f, maxProjection = -1e30f;
+    for (int i = 0; i < 16; i++)
+    {
+        float projection = (block[i * 4 + 0] - mean[0]) * axis[0] + (block[i * 4 + 1] - mean[1]) * axis[1] + (block[i * 4 + 2] - mean[2]) * axis[2];
+        if (projection < minProjection) minProjection = projection;
+        if (projection > maxProjection) maxProjection = projection;
+    }
+    float maxColor[3], minColor[3];
+    for (int c = 0; c < 3; c++)
+    {
+        maxColor[c] = mean[c] + axis[c] * maxProjection;
+        minColor[c] = mean[c] + axis[c] * minProjection;
+    }
+
+    unsigned short color0 = packColor565(maxColor);
+    unsigned short color1 = packColor565(minColor);
+    // color0 > color1 selects the 4-color mode, color0 <= color1 would mean 3 colors plus transparent black
+    if (color0 < color1)
+    {
+        unsigned short swap = color0;
+        color0 = color1;
+        color1 = swap;
+    }
+
+    unsigned int indices = 0;
+    if (color0 != color1)
+    {
+        int palette[4][3];
+        unpackColor565(color0, palette[0]);
+        unpackColor565(color1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            int bestDistance = 0x7FFFFFFF;
+            for (int p = 0; p < 4; p++)
+            {
+                int dr = block[i * 4 + 0] - palette[p][0];
+                int dg = block[i * 4 + 1] - palette[p][1];
+                int db = block[i * 4 + 2] - palette[p][2];
+                int distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (unsigned int)best << (2 * i);
+        }
+    }
+
+    out[0] = (unsigned char)(color0 & 0xFF);
+    out[1] = (unsigned char)(color0 >> 8);
+    out[2] = (unsigned char)(color1 & 0xFF);
+    out[3] = (unsigned char)(color1 >> 8);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+static void encodeAlphaBlock(const unsigned char* block, unsigned char* out)
+// BC3 alpha block (8 bytes): alpha0 = max, alpha1 = min, 6 interpolated values in between
+{
+    int maxAlpha = 0, minAlpha = 255;
+    for (int i = 0; i < 16; i++)
+    {
+        int alpha = block[i * 4 + 3];
+        if (alpha > maxAlpha) maxAlpha = alpha;
+        if (alpha < minAlpha) minAlpha = alpha;
+    }
+    out[0] = (unsigned char)maxAlpha;
+    out[1] = (unsigned char)minAlpha;
+
+    uint64_t indices = 0;
+    if (maxAlpha != minAlpha)
+    {
+        int palette[8];
+        palette[0] = maxAlpha;
+        palette[1] = minAlpha;
+        for (int p = 1; p < 7; p++)
+            palette[p + 1] = ((7 - p) * maxAlpha + p * minAlpha) / 7;
+        for (int i = 0; i < 16; i++)
+        {
+            int alpha = block[i * 4 + 3];
+            int best = 0;
+            int bestDistance = 256;
+            for (int p = 0; p < 8; p++)
+            {
+                int distance = alpha > palette[p] ? alpha - palette[p] : palette[p] - alpha;
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+static void compressLevel(const unsigned char* pixels, unsigned int width, unsigned int height, TextureCacheFormat format, unsigned char* out)
+// encode a whole RGBA8 level, blocks past the right/bottom edge repeat the last texel
+{
+    unsigned char block[16 * 4];
+    for (unsigned int by = 0; by < height; by += 4)
+    {
+        for (unsigned int bx = 0; bx < width; bx += 4)
+        {
+            for (unsigned int y = 0; y < 4; y++)
+            {
+                unsigned int sy = by + y < height ? by + y : height - 1;
+                for (unsigned int x = 0; x < 4; x++)
+                {
+                    unsigned int sx = bx + x < width ? bx + x : width - 1;
+                    memcpy(block + (y * 4 + x) * 4, pixels + (sy * width + sx) * 4, 4);
+                }
+            }
+            if (format == TEXTURE_CACHE_BC3)
+            {
+                encodeAlphaBlock(block, out);
+                out += 8;
+            }
+            encodeColorBlock(block, out);
+            out += 8;
+        }
+    }
+}
+
+static std::size_t levelSize(TextureCacheFormat format, unsigned int width, unsigned int height)
+{
+    std::size_t blocks = (std::size_t)((width + 3) / 4) * ((height + 3) / 4);
+    switch (format)
+    {
+    case TEXTURE_CACHE_BC1: return blocks * 8;
+    case TEXTURE_CACHE_BC3: return blocks * 16;
+    default: return (std::size_t)width * height * 4;
+    }
+}
+
+// ------------------------------------------------------------------------
+// TextureCache
+// ------------------------------------------------------------------------
+
+TextureCache::TextureCache(const std::string& directory, bool compress)
+// compress: use BC1/BC3, only if the driver supports S3TC (see isCompressionSupported())
+    : m_Directory(directory), m_Compress(compress)
+{
+}
+
+bool TextureCache::isCompressionSupported()
+// true if the current context supports S3TC textures
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, "GL_EXT_texture_compression_s3tc") == 0)
+            return true;
+    }
+    return false;
+}
+
+std::string TextureCache::getCachePath(uint64_t key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.ltex", (unsigned long long)key);
+    return m_Directory + "/" + name;
+}
+
+bool TextureCache::load(const std::string& sourcePath, bool flipVertically, CookedTexture& out) const
+// load sourcePath from the cache, cooking and storing it first if needed. Thread safe, called on the decode workers.
+{
+    MappedFile source;
+    if (!source.open(sourcePath))
+    {
+        std::cout << "Failed to load texture " << sourcePath << ": can't open file" << std::endl;
+        return false;
+    }
+
+    // any change to the image or to the way it is cooked gives a new file name
+    unsigned char options[3] = { (unsigned char)TEXTURE_CACHE_VERSION, (unsigned char)flipVertically, (unsigned char)m_Compress };
+    uint64_t key = hashBytes(source.data(), source.size());
+    key = hashBytes(options, sizeof(options), key);
+
+    if (out.m_File.open(getCachePath(key)) && out.m_File.size() >= sizeof(TextureCacheHeader))
+    {
+        const TextureCacheHeader* header = (const TextureCacheHeader*)out.m_File.data();
+        bool valid = memcmp(header->magic, "LTEX", 4) == 0 && header->version == TEXTURE_CACHE_VERSION && header->key == key &&
+                     header->levelCount > 0 && header->levelCount <= TEXTURE_CACHE_MAX_LEVELS;
+        for (unsigned int level = 0; valid && level < header->levelCount; level++)
+            valid = header->levels[level].offset + header->levels[level].size <= out.m_File.size();
+        if (valid)
+        {
+            out.m_Data = out.m_File.data();
+            out.m_Header = header;
+            return true;
+        }
+    }
+    out.m_File.close();
+
+    return cook(source, sourcePath, flipVertically, key, out);
+}
+
+bool TextureCache::cook(const MappedFile& source, const std::string& sourcePath, bool flipVertically, uint64_t key, CookedTexture& out) const
+// decode, flip, build the mip chain and compress, then write the result to the cache
+{
+    int width, height, channels;
+    // the flip flag is per thread, the global one would race between workers
+    stbi_set_flip_vertically_on_load_thread(flipVertically);
+    unsigned char* pixels = stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &channels, 4);
+    if (!pixels)
+    {
+        std::cout << "Failed to load texture " << sourcePath << ": " << stbi_failure_reason() << std::endl;
+        return false;
+    }
+
+    TextureCacheFormat format = TEXTURE_CACHE_RGBA8;
+    if (m_Compress)
+    {
+        format = TEXTURE_CACHE_BC1;
+        for (int i = 0; i < width * height; i++)
+        {
+            if (pixels[i * 4 + 3] != 255)
+            {
+                format = TEXTURE_CACHE_BC3;
+                break;
+            }
+        }
+    }
+
+    // lay out the file: header, then every level 16 byte aligned
+    TextureCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "LTEX", 4);
+    header.version = TEXTURE_CACHE_VERSION;
+    header.key = key;
+    header.format = format;
+    std::size_t fileSize = sizeof(TextureCacheHeader);
+    unsigned int levelWidth = (unsigned int)width, levelHeight = (unsigned int)height;
+    for (;;)
+    {
+        TextureCacheLevel& level = header.levels[header.levelCount++];
+        fileSize = (fileSize + LEVEL_ALIGNMENT - 1) / LEVEL_ALIGNMENT * LEVEL_ALIGNMENT;
+        level.width = levelWidth;
+        level.height = levelHeight;
+        level.offset = fileSize;
+        level.size = levelSize(format, levelWidth, levelHeight);
+        fileSize += (std::size_t)level.size;
+        if ((levelWidth == 1 && levelHeight == 1) || header.levelCount == TEXTURE_CACHE_MAX_LEVELS)
+            break;
+        levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+        levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+    }
+
+    out.m_Memory.assign(fileSize, 0);
+    memcpy(out.m_Memory.data(), &header, sizeof(header));
+
+    std::vector<unsigned char> current(pixels, pixels + (std::size_t)width * height * 4);
+    std::vector<unsigned char> next;
+    stbi_image_free(pixels);
+    for (unsigned int i = 0; i < header.levelCount; i++)
+    {
+        const TextureCacheLevel& level = header.levels[i];
+        unsigned char* destination = out.m_Memory.data() + level.offset;
+        if (format == TEXTURE_CACHE_RGBA8)
+            memcpy(destination, current.data(), (std::size_t)level.size);
+        else
+            compressLevel(current.data(), level.width, level.height, format, destination);
+
+        if (i + 1 < header.levelCount)
+        {
+            const TextureCacheLevel& smaller = header.levels[i + 1];
+            next.resize((std::size_t)smaller.width * smaller.height * 4);
+            downsample(current.data(), level.width, level.height, next.data(), smaller.width, smaller.height);
+            current.swap(next);
+        }
+    }
+    out.m_Data = out.m_Memory.data();
+    out.m_Header = (const TextureCacheHeader*)out.m_Data;
+
+    // written through a temporary file, so a crash or another instance never sees a half written cache file
+    std::string path = getCachePath(key);
+    if (!createDirectories(m_Directory) || !writeFileAtomic(path, out.m_Memory.data(), fileSize))
+        std::cout << "Failed to write texture cache file " << path << std::endl;
+    return true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// S3TC formats (GL_EXT_texture_compression_s3tc), not part of the core profile GLAD was generated for
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+const unsigned int TEXTURE_CACHE_VERSION = 1;      // bump when the file layout or the cooking changes
+const unsigned int TEXTURE_CACHE_MAX_LEVELS = 16;
+
+enum TextureCacheFormat
+{
+    TEXTURE_CACHE_RGBA8 = 0,    // uncompressed, 4 bytes per pixel
+    TEXTURE_CACHE_BC1 = 1,      // DXT1, opaque images, 8 bytes per 4x4 block
+    TEXTURE_CACHE_BC3 = 2       // DXT5, images with alpha, 16 bytes per 4x4 block
+};
+
+struct TextureCacheLevel
+{
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;    // from the start of the file
+    uint64_t size;      // bytes
+};
+
+// Header at the start of a cache file, followed by the mip levels (largest first, 16 byte aligned)
+struct TextureCacheHeader
+{
+    char magic[4];      // "LTEX"
+    uint32_t version;
+    uint64_t key;       // hash of the source file contents and the cooking options
+    uint32_t format;    // TextureCacheFormat
+    uint32_t levelCount;
+    TextureCacheLevel levels[TEXTURE_CACHE_MAX_LEVELS];
+};
+
+// Pre-flipped, pre-mipmapped, possibly block-compressed texture, either mapped straight from a cache file or cooked in memory
+class CookedTexture
+{
+private:
+    friend class TextureCache;
+    MappedFile m_File;
+    std::vector<unsigned char> m_Memory;
+    const unsigned char* m_Data;    // start of the file (m_File or m_Memory)
+    const TextureCacheHeader* m_Header;
+
+public:
+    CookedTexture();
+
+    bool isValid() const;
+    bool isCompressed() const;
+    // internal format for glTexImage2D / glCompressedTexImage2D
+    GLenum getInternalFormat() const;
+    // 4 for block-compressed formats, 1 otherwise: uploads must cover whole rows of blocks
+    unsigned int getBlockHeight() const;
+    // bytes of one row of blocks (or pixels) of level
+    std::size_t getRowBytes(unsigned int level) const;
+
+    unsigned int getLevelCount() const;
+    unsigned int getWidth(unsigned int level = 0) const;
+    unsigned int getHeight(unsigned int level = 0) const;
+    const unsigned char* getLevelData(unsigned int level) const;
+    std::size_t getLevelSize(unsigned int level) const;
+};
+
+// On-disk cache of cooked textures, so that startup skips PNG decoding and mipmap generation.
+// Files are named after a hash of the source file contents and options, and are memory mapped when loaded.
+class TextureCache
+{
+private:
+    std::string m_Directory;
+    bool m_Compress;
+
+    std::string getCachePath(uint64_t key) const;
+    // decode, flip, build the mip chain and compress, then write the result to the cache
+    bool cook(const MappedFile& source, const std::string& sourcePath, bool flipVertically, uint64_t key, CookedTexture& out) const;
+
+public:
+    // compress: use BC1/BC3, only if the driver supports S3TC (see isCompressionSupported())
+    TextureCache(const std::string& directory, bool compress);
+
+    // load sourcePath from the cache, cooking and storing it first if needed. Thread safe, called on the decode workers.
+    bool load(const std::string& sourcePath, bool flipVertically, CookedTexture& out) const;
+
+    // true if the current context supports S3TC textures
+    static bool isCompressionSupported();
+};
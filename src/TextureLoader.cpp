@@ -0,0 +1,232 @@
+#include "TextureLoader.h"
+#include "GLStateCache.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+TextureLoader::TextureLoader(JobSystem& jobs, std::size_t uploadBudget, const std::string& cacheDirectory)
+// constructor creates the placeholder texture, needs a current context. Images are decoded by background jobs of jobs
+    : m_Cache(cacheDirectory, TextureCache::isCompressionSupported()), m_JobSystem(jobs), m_Stopping(false), m_Placeholder(0), m_PBO(0),
+      m_UploadBudget(uploadBudget), m_Uploading(false), m_CurrentTexture(0), m_NextLevel(0), m_NextRow(0), m_Pending(0)
+{
+    m_Current.texture = NULL;
+
+    // 2x2 checkerboard shown until the real image is ready
+    const unsigned char checker[] = {
+        255, 0, 255, 255,   64, 64, 64, 255,
+        64, 64, 64, 255,    255, 0, 255, 255
+    };
+    glGenTextures(1, &m_Placeholder);
+    GLStateCache::Get().bindTexture(0, GL_TEXTURE_2D, m_Placeholder);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, checker);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenBuffers(1, &m_PBO);
+}
+
+TextureLoader::~TextureLoader()
+// Destructor waits for the decode jobs and deletes all textures
+{
+    // the jobs point at this loader, the ones that did not start yet return right away
+    m_Stopping = true;
+    for (const JobHandle& job : m_DecodeJobs)
+        m_JobSystem.wait(job);
+
+    if (m_Uploading)
+        glDeleteTextures(1, &m_CurrentTexture);
+
+    GLStateCache& stateCache = GLStateCache::Get();
+    for (std::unique_ptr<StreamedTexture>& texture : m_Textures)
+    {
+        if (texture->m_Ready)
+        {
+            stateCache.forgetTexture(texture->m_ID);
+            glDeleteTextures(1, &texture->m_ID);
+        }
+    }
+    stateCache.forgetTexture(m_Placeholder);
+    glDeleteTextures(1, &m_Placeholder);
+    stateCache.forgetBuffer(m_PBO);
+    glDeleteBuffers(1, &m_PBO);
+}
+
+const StreamedTexture* TextureLoader::load(const std::string& path, bool flipVertically)
+// queue an image for loading, the returned texture shows the placeholder until it is ready
+{
+    m_Textures.push_back(std::unique_ptr<StreamedTexture>(new StreamedTexture(path, m_Placeholder)));
+    StreamedTexture* texture = m_Textures.back().get();
+    m_Pending++;
+
+    JobHandle job = m_JobSystem.create([this, texture, flipVertically] { decode(texture, flipVertically); }, JOB_BACKGROUND);
+    m_JobSystem.submit(job);
+    m_DecodeJobs.push_back(job);
+    return texture;
+}
+
+void TextureLoader::decode(StreamedTexture* texture, bool flipVertically)
+// background job: map (or cook) the image through the cache, hand the result to the render thread
+{
+    if (m_Stopping)
+        return;
+
+    DecodedImage image;
+    image.texture = texture;
+    {
+        PROFILE_CPU_ZONE("TextureDecode");
+        image.cooked.reset(new CookedTexture());
+        if (!m_Cache.load(texture->getPath(), flipVertically, *image.cooked))
+            image.cooked.reset();
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Decoded.push_back(std::move(image));
+}
+
+void TextureLoader::update()
+// render thread, once per frame: upload decoded images within the budget
+{
+    PROFILE_CPU_ZONE("TextureUpload");
+    m_DecodeJobs.erase(std::remove_if(m_DecodeJobs.begin(), m_DecodeJobs.end(), [](const JobHandle& job) { return job->isFinished(); }),
+        m_DecodeJobs.end());
+
+    std::size_t budget = m_UploadBudget;
+    while (budget > 0)
+    {
+        if (!m_Uploading)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                if (m_Decoded.empty())
+                    return;
+                m_Current = std::move(m_Decoded.front());
+                m_Decoded.pop_front();
+            }
+            if (!m_Current.cooked)
+            {
+                // failed to decode: keep showing the placeholder
+                m_Pending--;
+                continue;
+            }
+
+            // upload into a new texture, the placeholder stays visible until every row has arrived
+            glGenTextures(1, &m_CurrentTexture);
+            allocateLevels();
+            // set the texture wrapping/filtering options (on the currently bound texture object)
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            m_NextLevel = 0;
+            m_NextRow = 0;
+            m_Uploading = true;
+        }
+
+        budget -= uploadRows(budget);
+
+        const CookedTexture& cooked = *m_Current.cooked;
+        unsigned int blockHeight = cooked.getBlockHeight();
+        if (m_NextRow == (cooked.getHeight(m_NextLevel) + blockHeight - 1) / blockHeight)
+        {
+            m_NextLevel++;
+            m_NextRow = 0;
+        }
+        if (m_NextLevel == cooked.getLevelCount())
+        {
+            // the mip chain comes precomputed from the cache, no glGenerateMipmap
+            m_Current.cooked.reset();
+            m_Current.texture->m_ID = m_CurrentTexture;
+            m_Current.texture->m_Ready = true;
+            m_Uploading = false;
+            m_Pending--;
+        }
+    }
+}
+
+void TextureLoader::allocateLevels()
+// allocate every mip level of m_CurrentTexture
+{
+    const CookedTexture& cooked = *m_Current.cooked;
+    GLStateCache::Get().bindTexture(0, GL_TEXTURE_2D, m_CurrentTexture);
+    for (unsigned int level = 0; level < cooked.getLevelCount(); level++)
+    {
+        if (cooked.isCompressed())
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, cooked.getInternalFormat(), cooked.getWidth(level), cooked.getHeight(level), 0,
+                                   (GLsizei)cooked.getLevelSize(level), NULL);
+        else
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, cooked.getWidth(level), cooked.getHeight(level), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, cooked.getLevelCount() - 1);
+}
+
+std::size_t TextureLoader::uploadRows(std::size_t budget)
+// upload up to budget bytes of the current mip level, returns the bytes used
+{
+    const CookedTexture& cooked = *m_Current.cooked;
+    unsigned int level = m_NextLevel;
+    unsigned int width = cooked.getWidth(level);
+    unsigned int height = cooked.getHeight(level);
+    unsigned int blockHeight = cooked.getBlockHeight();
+    unsigned int rowCount = (height + blockHeight - 1) / blockHeight;
+
+    // rows of pixels, or rows of 4x4 blocks for compressed formats
+    std::size_t rowBytes = cooked.getRowBytes(level);
+    unsigned int rows = (unsigned int)(budget / rowBytes);
+    if (rows == 0)
+        rows = 1; // always make progress, even with a tiny budget
+    if (rows > rowCount - m_NextRow)
+        rows = rowCount - m_NextRow;
+    std::size_t bytes = rows * rowBytes;
+    const unsigned char* source = cooked.getLevelData(level) + m_NextRow * rowBytes;
+
+    // the last row of blocks may stick out of the level
+    int y = (int)(m_NextRow * blockHeight);
+    int rowsHeight = (int)(rows * blockHeight);
+    if (y + rowsHeight > (int)height)
+        rowsHeight = (int)height - y;
+
+    GLStateCache& stateCache = GLStateCache::Get();
+    stateCache.bindBuffer(GL_PIXEL_UNPACK_BUFFER, m_PBO);
+    // orphan the previous chunk, then copy the rows straight into driver memory
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped)
+    {
+        memcpy(mapped, source, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        // with a PBO bound the data pointer is an offset into it, the copy to the texture happens asynchronously
+        source = NULL;
+    }
+    else
+        stateCache.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    stateCache.bindTexture(0, GL_TEXTURE_2D, m_CurrentTexture);
+    if (cooked.isCompressed())
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, rowsHeight, cooked.getInternalFormat(), (GLsizei)bytes, source);
+    else
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, rowsHeight, GL_RGBA, GL_UNSIGNED_BYTE, source);
+    // an unpack buffer left bound would turn every later glTexImage pointer into an offset
+    stateCache.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    m_NextRow += rows;
+    return bytes > budget ? budget : bytes;
+}
+
+void TextureLoader::finish()
+// block until every requested texture is ready (e.g. before a benchmark)
+{
+    while (m_Pending > 0)
+    {
+        update();
+        if (m_Pending > 0)
+            std::this_thread::yield();
+    }
+}
+
+unsigned int TextureLoader::getPendingCount() const
+{
+    return m_Pending;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "JobSystem.h"
+#include "TextureCache.h"
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Texture that is filled in asynchronously by TextureLoader.
+// getID() returns the placeholder texture until the image is decoded and fully uploaded, so it can be bound right away.
+class StreamedTexture
+{
+private:
+    friend class TextureLoader;
+    unsigned int m_ID;
+    bool m_Ready;
+    std::string m_Path;
+
+public:
+    StreamedTexture(const std::string& path, unsigned int placeholder) : m_ID(placeholder), m_Ready(false), m_Path(path) {}
+
+    unsigned int getID() const { return m_ID; }
+    bool isReady() const { return m_Ready; }
+    const std::string& getPath() const { return m_Path; }
+};
+
+// Loads textures without blocking the render thread: background jobs map the cooked image from the TextureCache
+// (decoding and cooking the source image only on the first run), then the render thread uploads every mip level
+// through a pixel buffer object a few rows at a time, at most uploadBudget bytes per frame.
+class TextureLoader
+{
+private:
+    struct DecodedImage
+    {
+        StreamedTexture* texture;
+        std::unique_ptr<CookedTexture> cooked; // NULL if the image could not be loaded
+    };
+
+    TextureCache m_Cache;
+    JobSystem& m_JobSystem;
+
+    // decode jobs, m_Decoded is guarded by m_Mutex
+    std::vector<JobHandle> m_DecodeJobs;    // not finished yet as of the last update()
+    std::mutex m_Mutex;
+    std::deque<DecodedImage> m_Decoded;
+    std::atomic<bool> m_Stopping;           // jobs that did not start yet skip their image
+
+    // render thread side
+    std::vector<std::unique_ptr<StreamedTexture>> m_Textures;
+    unsigned int m_Placeholder;
+    unsigned int m_PBO;
+    std::size_t m_UploadBudget;
+    bool m_Uploading;
+    DecodedImage m_Current;         // image being uploaded
+    unsigned int m_CurrentTexture;  // texture it is uploaded into, replaces the placeholder once complete
+    unsigned int m_NextLevel;
+    unsigned int m_NextRow;         // in rows of blocks for compressed formats
+    unsigned int m_Pending;         // requested but not ready yet
+
+    // background job: map (or cook) the image through the cache, hand the result to the render thread
+    void decode(StreamedTexture* texture, bool flipVertically);
+    // allocate every mip level of m_CurrentTexture
+    void allocateLevels();
+    // upload up to budget bytes of the current mip level, returns the bytes used
+    std::size_t uploadRows(std::size_t budget);
+
+public:
+    // constructor creates the placeholder texture, needs a current context. Images are decoded by background jobs of jobs.
+    // Cooked textures are cached in cacheDirectory, block-compressed if the driver supports S3TC.
+    TextureLoader(JobSystem& jobs, std::size_t uploadBudget = 4 * 1024 * 1024, const std::string& cacheDirectory = "cache/textures");
+    // Destructor waits for the decode jobs and deletes all textures
+    ~TextureLoader();
+
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    // queue an image for loading, the returned texture shows the placeholder until it is ready
+    const StreamedTexture* load(const std::string& path, bool flipVertically = true);
+    // render thread, once per frame: upload decoded images within the budget
+    void update();
+    // block until every requested texture is ready (e.g. before a benchmark)
+    void finish();
+
+    unsigned int getPendingCount() const;
+};
@@ -0,0 +1,155 @@
+#include "TransformStore.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static unsigned int lowestBit(uint64_t bits)
+// index of the lowest set bit, bits must not be 0
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return (unsigned int)index;
+#else
+    return (unsigned int)__builtin_ctzll(bits);
+#endif
+}
+
+TransformStore::TransformStore()
+    : m_DirtyCount(0), m_AllChanged(false)
+{
+}
+
+void TransformStore::reserve(unsigned int count)
+{
+    m_Positions.reserve(count);
+    m_Rotations.reserve(count);
+    m_Scales.reserve(count);
+    m_World.reserve(count);
+    m_Dirty.reserve((count + 63) / 64);
+}
+
+unsigned int TransformStore::add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+// add an object, returns its index. New objects are dirty
+{
+    unsigned int object = size();
+    m_Positions.push_back(position);
+    m_Rotations.push_back(rotation);
+    m_Scales.push_back(scale);
+    m_World.push_back(glm::mat4(1.0f));
+    if (object / 64 >= m_Dirty.size())
+        m_Dirty.push_back(0);
+    markDirty(object);
+    // the GPU copy has to grow anyway, so it is refreshed as a whole
+    m_AllChanged = true;
+    return object;
+}
+
+void TransformStore::markDirty(unsigned int object)
+{
+    uint64_t bit = 1ull << (object % 64);
+    uint64_t& word = m_Dirty[object / 64];
+    if (!(word & bit))
+    {
+        word |= bit;
+        m_DirtyCount++;
+    }
+}
+
+void TransformStore::setPosition(unsigned int object, const glm::vec3& position)
+{
+    if (m_Positions[object] == position)
+        return;
+    m_Positions[object] = position;
+    markDirty(object);
+}
+
+void TransformStore::setRotation(unsigned int object, const glm::quat& rotation)
+{
+    if (m_Rotations[object] == rotation)
+        return;
+    m_Rotations[object] = rotation;
+    markDirty(object);
+}
+
+void TransformStore::setScale(unsigned int object, const glm::vec3& scale)
+{
+    if (m_Scales[object] == scale)
+        return;
+    m_Scales[object] = scale;
+    markDirty(object);
+}
+
+unsigned int TransformStore::rebuild(size_t firstWord, size_t endWord, std::vector<unsigned int>* changed)
+// rebuild the dirty objects in words [firstWord, endWord) of m_Dirty and clear their bits, appending them to changed if not NULL
+{
+    unsigned int rebuilt = 0;
+    for (size_t w = firstWord; w < endWord; w++)
+    {
+        uint64_t bits = m_Dirty[w];
+        while (bits)
+        {
+            unsigned int object = (unsigned int)(w * 64) + lowestBit(bits);
+            bits &= bits - 1;
+
+            // translate * rotate * scale, written out: the rotation columns scaled, then the translation
+            glm::mat3 rotation = glm::mat3_cast(m_Rotations[object]);
+            const glm::vec3& scale = m_Scales[object];
+            glm::mat4& world = m_World[object];
+            world[0] = glm::vec4(rotation[0] * scale.x, 0.0f);
+            world[1] = glm::vec4(rotation[1] * scale.y, 0.0f);
+            world[2] = glm::vec4(rotation[2] * scale.z, 0.0f);
+            world[3] = glm::vec4(m_Positions[object], 1.0f);
+
+            if (changed)
+                changed->push_back(object);
+            rebuilt++;
+        }
+        m_Dirty[w] = 0;
+    }
+    return rebuilt;
+}
+
+unsigned int TransformStore::update()
+// rebuild the world matrices of dirty objects, returns how many were rebuilt
+{
+    if (m_DirtyCount == 0)
+        return 0;
+
+    unsigned int rebuilt = rebuild(0, m_Dirty.size(), m_AllChanged ? NULL : &m_Changed);
+    m_DirtyCount = 0;
+    return rebuilt;
+}
+
+unsigned int TransformStore::update(JobSystem& jobs)
+// same, spread over the job system in blocks of TRANSFORM_JOB_OBJECTS (the setters must not run meanwhile)
+{
+    const unsigned int wordsPerJob = TRANSFORM_JOB_OBJECTS / 64;
+    if (m_DirtyCount < TRANSFORM_JOB_OBJECTS || m_Dirty.size() <= wordsPerJob)
+        return update();
+
+    // every job owns whole words of dirty bits and its own list of changed objects, concatenated in order afterwards
+    unsigned int jobCount = (unsigned int)((m_Dirty.size() + wordsPerJob - 1) / wordsPerJob);
+    m_JobChanged.resize(jobCount);
+    std::atomic<unsigned int> rebuilt(0);
+    bool listChanged = !m_AllChanged;
+    jobs.parallelFor(0, (unsigned int)m_Dirty.size(), wordsPerJob, [&](unsigned int first, unsigned int end)
+    {
+        std::vector<unsigned int>& changed = m_JobChanged[first / wordsPerJob];
+        changed.clear();
+        rebuilt.fetch_add(rebuild(first, end, listChanged ? &changed : NULL), std::memory_order_relaxed);
+    });
+    if (listChanged)
+        for (unsigned int j = 0; j < jobCount; j++)
+            m_Changed.insert(m_Changed.end(), m_JobChanged[j].begin(), m_JobChanged[j].end());
+
+    m_DirtyCount = 0;
+    return rebuilt.load();
+}
+
+void TransformStore::clearChanged()
+{
+    m_Changed.clear();
+    m_AllChanged = false;
+}
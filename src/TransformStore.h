@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "JobSystem.h"
+
+#include <cstdint>
+#include <vector>
+
+const unsigned int TRANSFORM_JOB_OBJECTS = 4096;  // objects per job of the parallel update()
+
+// Transforms of many objects in structure-of-arrays layout: positions, rotations (quaternions), scales and the cached
+// world matrices each live in their own array. Setters mark an object dirty (only when the value really changes),
+// update() rebuilds the world matrix of dirty objects only, and records them as changed until the GPU copy is
+// refreshed (see InstancedRenderer::updateTransforms()). An unchanged scene costs one counter check per frame.
+class TransformStore
+{
+private:
+    std::vector<glm::vec3> m_Positions;
+    std::vector<glm::quat> m_Rotations;
+    std::vector<glm::vec3> m_Scales;
+    std::vector<glm::mat4> m_World;
+
+    std::vector<uint64_t> m_Dirty;      // one bit per object: world matrix is out of date
+    unsigned int m_DirtyCount;
+    std::vector<unsigned int> m_Changed; // objects whose world matrix was rebuilt since the last clearChanged(), ascending per update()
+    bool m_AllChanged;                  // every object changed (e.g. after add()), cheaper than listing them
+
+    std::vector<std::vector<unsigned int>> m_JobChanged; // changed objects per job of the parallel update()
+
+    void markDirty(unsigned int object);
+    // rebuild the dirty objects in words [firstWord, endWord) of m_Dirty and clear their bits, appending them to changed if not NULL
+    unsigned int rebuild(size_t firstWord, size_t endWord, std::vector<unsigned int>* changed);
+
+public:
+    TransformStore();
+
+    // add an object, returns its index. New objects are dirty
+    unsigned int add(const glm::vec3& position, const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+    void reserve(unsigned int count);
+
+    void setPosition(unsigned int object, const glm::vec3& position);
+    void setRotation(unsigned int object, const glm::quat& rotation);
+    void setScale(unsigned int object, const glm::vec3& scale);
+
+    // rebuild the world matrices of dirty objects, returns how many were rebuilt
+    unsigned int update();
+    // same, spread over the job system in blocks of TRANSFORM_JOB_OBJECTS (the setters must not run meanwhile)
+    unsigned int update(JobSystem& jobs);
+
+    // objects rebuilt by update() since the last clearChanged(), meaningless if allChanged()
+    const std::vector<unsigned int>& getChanged() const { return m_Changed; }
+    bool allChanged() const { return m_AllChanged; }
+    void clearChanged();
+
+    unsigned int size() const { return (unsigned int)m_Positions.size(); }
+    const glm::vec3& getPosition(unsigned int object) const { return m_Positions[object]; }
+    const glm::quat& getRotation(unsigned int object) const { return m_Rotations[object]; }
+    const glm::vec3& getScale(unsigned int object) const { return m_Scales[object]; }
+    // world matrix as of the last update()
+    const glm::mat4& getWorld(unsigned int object) const { return m_World[object]; }
+    const glm::mat4* getWorldMatrices() const { return m_World.data(); }
+};
@@ -0,0 +1,151 @@
+#include "VertexLayout.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+VertexLayout::VertexLayout()
+    : m_Stride(0)
+{
+}
+
+VertexLayout& VertexLayout::add(unsigned int location, VertexFormat format)
+// append an attribute after the previous ones
+{
+    VertexAttributeDesc attribute = { location, format, m_Stride };
+    m_Attributes.push_back(attribute);
+    m_Stride += getFormatSize(format);
+    return *this;
+}
+
+int VertexLayout::find(unsigned int location) const
+// index of the attribute at location, -1 if the layout has none
+{
+    for (unsigned int i = 0; i < m_Attributes.size(); i++)
+        if (m_Attributes[i].location == location)
+            return (int)i;
+    return -1;
+}
+
+void VertexLayout::apply(std::size_t baseOffset) const
+// set up and enable every attribute of the bound VAO, sourcing the bound GL_ARRAY_BUFFER from baseOffset
+{
+    for (const VertexAttributeDesc& attribute : m_Attributes)
+    {
+        GLint size = 0;
+        GLenum type = GL_FLOAT;
+        GLboolean normalized = GL_FALSE;
+        switch (attribute.format)
+        {
+        case VERTEX_FLOAT2: size = 2; break;
+        case VERTEX_FLOAT3: size = 3; break;
+        case VERTEX_FLOAT4: size = 4; break;
+        case VERTEX_HALF2: size = 2; type = GL_HALF_FLOAT; break;
+        case VERTEX_HALF4: size = 4; type = GL_HALF_FLOAT; break;
+        case VERTEX_UNORM8X4: size = 4; type = GL_UNSIGNED_BYTE; normalized = GL_TRUE; break;
+        case VERTEX_OCTAHEDRAL: size = 2; type = GL_SHORT; normalized = GL_TRUE; break;
+        }
+        glVertexAttribPointer(attribute.location, size, type, normalized, (GLsizei)m_Stride, (void*)(baseOffset + attribute.offset));
+        glEnableVertexAttribArray(attribute.location);
+    }
+}
+
+static glm::vec2 encodeOctahedral(glm::vec3 normal)
+// project the unit normal onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the upper one
+{
+    normal /= std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z) + 1e-20f;
+    glm::vec2 folded(normal.x, normal.y);
+    if (normal.z < 0.0f)
+    {
+        folded.x = (1.0f - std::fabs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f);
+        folded.y = (1.0f - std::fabs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return folded;
+}
+
+void VertexLayout::write(void* vertex, unsigned int attribute, const float* values, unsigned int count) const
+// convert count floats (missing components become 0, or 1 for w) into attribute of the vertex at vertex
+{
+    const VertexAttributeDesc& desc = m_Attributes[attribute];
+    unsigned char* destination = (unsigned char*)vertex + desc.offset;
+    float v[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    for (unsigned int i = 0; i < count && i < 4; i++)
+        v[i] = values[i];
+
+    switch (desc.format)
+    {
+    case VERTEX_FLOAT2:
+    case VERTEX_FLOAT3:
+    case VERTEX_FLOAT4:
+        memcpy(destination, v, getFormatSize(desc.format));
+        break;
+    case VERTEX_HALF2:
+    case VERTEX_HALF4:
+    {
+        uint16_t halves[4];
+        for (int i = 0; i < 4; i++)
+            halves[i] = glm::packHalf1x16(v[i]);
+        memcpy(destination, halves, getFormatSize(desc.format));
+        break;
+    }
+    case VERTEX_UNORM8X4:
+    {
+        uint32_t packed = glm::packUnorm4x8(glm::vec4(v[0], v[1], v[2], v[3]));
+        memcpy(destination, &packed, sizeof(packed));
+        break;
+    }
+    case VERTEX_OCTAHEDRAL:
+    {
+        uint32_t packed = glm::packSnorm2x16(encodeOctahedral(glm::vec3(v[0], v[1], v[2])));
+        memcpy(destination, &packed, sizeof(packed));
+        break;
+    }
+    }
+}
+
+unsigned int VertexLayout::getFormatSize(VertexFormat format)
+{
+    switch (format)
+    {
+    case VERTEX_FLOAT2: return 8;
+    case VERTEX_FLOAT3: return 12;
+    case VERTEX_FLOAT4: return 16;
+    case VERTEX_HALF2: return 4;
+    case VERTEX_HALF4: return 8;
+    case VERTEX_UNORM8X4: return 4;
+    case VERTEX_OCTAHEDRAL: return 4;
+    }
+    return 0;
+}
+
+GLenum chooseIndexType(std::size_t vertexCount)
+// GL_UNSIGNED_SHORT if every index of a mesh with vertexCount vertices fits, GL_UNSIGNED_INT otherwise
+{
+    return vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+std::size_t getIndexSize(GLenum type)
+{
+    switch (type)
+    {
+    case GL_UNSIGNED_BYTE: return 1;
+    case GL_UNSIGNED_SHORT: return 2;
+    default: return 4;
+    }
+}
+
+void writeIndices(const unsigned int* indices, std::size_t count, GLenum type, void* destination)
+// convert 32-bit indices to type (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT) into destination
+{
+    if (type == GL_UNSIGNED_SHORT)
+    {
+        uint16_t* shorts = (uint16_t*)destination;
+        for (std::size_t i = 0; i < count; i++)
+            shorts[i] = (uint16_t)indices[i];
+    }
+    else
+        memcpy(destination, indices, count * sizeof(unsigned int));
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// Storage format of one vertex attribute. The compact ones are expanded to floats by the vertex fetch hardware for free
+enum VertexFormat
+{
+    VERTEX_FLOAT2,      // 8 bytes
+    VERTEX_FLOAT3,      // 12 bytes
+    VERTEX_FLOAT4,      // 16 bytes
+    VERTEX_HALF2,       // 4 bytes, e.g. texture coordinates
+    VERTEX_HALF4,       // 8 bytes, e.g. positions (w = 1). There is no half3: attributes stay 4-byte aligned
+    VERTEX_UNORM8X4,    // 4 bytes, colors in [0, 1]
+    VERTEX_OCTAHEDRAL   // 4 bytes, unit normals folded onto an octahedron, two snorm16. The shader decodes them with
+                        //   vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+                        //   if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+                        //   n = normalize(n);
+};
+
+struct VertexAttributeDesc
+{
+    unsigned int location;
+    VertexFormat format;
+    unsigned int offset;    // bytes from the start of the vertex
+};
+
+// Describes an interleaved vertex: which attribute location gets which format at which offset.
+// Built with add() in vertex order, then apply() sets up the attribute pointers of the bound VAO/VBO,
+// and write() converts float data into the vertex format on the CPU.
+class VertexLayout
+{
+private:
+    std::vector<VertexAttributeDesc> m_Attributes;
+    unsigned int m_Stride;
+
+public:
+    VertexLayout();
+
+    // append an attribute after the previous ones
+    VertexLayout& add(unsigned int location, VertexFormat format);
+
+    unsigned int getStride() const { return m_Stride; }
+    unsigned int getAttributeCount() const { return (unsigned int)m_Attributes.size(); }
+    const VertexAttributeDesc& getAttribute(unsigned int index) const { return m_Attributes[index]; }
+    // index of the attribute at location, -1 if the layout has none
+    int find(unsigned int location) const;
+
+    // set up and enable every attribute of the bound VAO, sourcing the bound GL_ARRAY_BUFFER from baseOffset
+    void apply(std::size_t baseOffset = 0) const;
+    // convert count floats (missing components become 0, or 1 for w) into attribute of the vertex at vertex
+    void write(void* vertex, unsigned int attribute, const float* values, unsigned int count) const;
+
+    static unsigned int getFormatSize(VertexFormat format);
+};
+
+// GL_UNSIGNED_SHORT if every index of a mesh with vertexCount vertices fits, GL_UNSIGNED_INT otherwise
+GLenum chooseIndexType(std::size_t vertexCount);
+std::size_t getIndexSize(GLenum type);
+// convert 32-bit indices to type (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT) into destination
+void writeIndices(const unsigned int* indices, std::size_t count, GLenum type, void* destination);